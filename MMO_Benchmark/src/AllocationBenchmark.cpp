@@ -0,0 +1,127 @@
+#include <iostream>
+#include <cstdlib>
+#include <new>
+
+#include "MMO_Common.h"
+
+// Count heap allocations made by the server while it relays a fixed client load.
+// Only the threads that belong to the server (asio context and the Update loop) are counted. After a warm up phase
+// the message path should be served entirely from the block pool, so the program fails if the server allocates
+// anything other than growing the pool for a deeper burst than the warm up produced.
+
+static thread_local bool tl_bCountAllocations = false;
+static std::atomic<uint64_t> g_nAllocations{0};
+
+void *operator new(size_t nBytes) {
+    if (tl_bCountAllocations) g_nAllocations++;
+    if (void *p = std::malloc(nBytes ? nBytes : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t nBytes) {
+    return operator new(nBytes);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+// Relays every player update to all other clients, the same path GameServer uses
+class RelayServer : public bsl::net::server_interface<GameMsg> {
+public:
+    RelayServer(uint16_t nPort) : bsl::net::server_interface<GameMsg>(nPort) {}
+
+    // Mark the asio thread so its allocations are counted from now on
+    void CountContextThread() {
+        asio::post(m_asioContext, []() { tl_bCountAllocations = true; });
+    }
+
+    uint64_t nRelayed = 0;
+
+protected:
+    void OnMessage(std::shared_ptr<bsl::net::connection<GameMsg>> client, bsl::net::message<GameMsg> &msg) override {
+        MessageAllClients(std::move(msg), client);
+        nRelayed++;
+    }
+};
+
+class BotClient : public bsl::net::client_interface<GameMsg> {
+public:
+    void SendUpdate(uint32_t nFrame) {
+        sPlayerDescription desc;
+        desc.nUniqueID = nFrame;
+        bsl::net::message<GameMsg> msg;
+        msg.header.id = GameMsg::Game_UpdatePlayer;
+        msg << desc;
+        Send(std::move(msg));
+    }
+
+    void DrainIncoming() {
+        while (!Incoming().empty()) Incoming().pop_front();
+    }
+};
+
+// Push nFrames updates from every client through the server
+void RunLoad(RelayServer &server, std::vector<std::unique_ptr<BotClient>> &vClients, uint32_t nFrames) {
+    for (uint32_t nFrame = 0; nFrame < nFrames; nFrame++) {
+        for (auto &client : vClients) client->SendUpdate(nFrame);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        server.Update(-1, false);
+        for (auto &client : vClients) client->DrainIncoming();
+    }
+
+    // Let the tail of the load settle
+    auto tpEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < tpEnd) {
+        server.Update(-1, false);
+        for (auto &client : vClients) client->DrainIncoming();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    size_t nClients = argc > 1 ? std::stoul(argv[1]) : 8;
+    uint32_t nFrames = argc > 2 ? uint32_t(std::stoul(argv[2])) : 2000;
+    uint16_t nPort = 2697;
+
+    RelayServer server(nPort);
+    server.Start();
+
+    std::vector<std::unique_ptr<BotClient>> vClients;
+    for (size_t i = 0; i < nClients; i++) {
+        vClients.push_back(std::make_unique<BotClient>());
+        vClients.back()->Connect("127.0.0.1", nPort);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    // Warm up fills the block pool and the per connection containers
+    RunLoad(server, vClients, nFrames);
+
+    // Measure
+    uint64_t nRelayedBefore = server.nRelayed;
+    server.CountContextThread();
+    tl_bCountAllocations = true;
+    g_nAllocations = 0;
+    uint64_t nPoolGrowthBefore = bsl::net::block_pool::instance().heap_allocations();
+    RunLoad(server, vClients, nFrames);
+    tl_bCountAllocations = false;
+    uint64_t nAllocations = g_nAllocations.load();
+    uint64_t nPoolGrowth = bsl::net::block_pool::instance().heap_allocations() - nPoolGrowthBefore;
+    uint64_t nRelayed = server.nRelayed - nRelayedBefore;
+
+    std::cout << "clients: " << nClients << "\n"
+              << "messages relayed: " << nRelayed << " (" << nRelayed * (nClients - 1) << " sends)\n"
+              << "server heap allocations: " << nAllocations << "\n"
+              << "block pool growth (all threads): " << nPoolGrowth << "\n"
+              << "allocations per message: " << (nRelayed ? double(nAllocations) / nRelayed : 0.0) << "\n";
+
+    for (auto &client : vClients) client->Disconnect();
+    server.Stop();
+
+    // A burst deeper than any seen during warm up may still grow the pool, anything else is a leak in the message path
+    return nAllocations <= nPoolGrowth ? 0 : 1;
+}
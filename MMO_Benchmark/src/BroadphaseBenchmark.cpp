@@ -0,0 +1,186 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+#include "MMO_Common.h"
+#include "MMO_SpatialHash.h"
+
+// Cost of the player and bullet collision passes of MMOGame::OnUserUpdate, testing every pair against querying the
+// spatial hash for candidates. Players and bullets are scattered at a constant density, so the world grows with the
+// entity count the way a busier server would. Before timing, both paths must find exactly the same overlapping pairs.
+
+struct sWorld {
+    std::unordered_map<uint32_t, sPlayerDescription> mapObjects;
+    std::list<sBulletDescription> listBullets;
+};
+
+sWorld MakeWorld(uint32_t nPlayers, uint32_t nBullets, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    // About one player per 6 square tiles
+    float fSize = std::sqrt(float(nPlayers) * 6.0f);
+    std::uniform_real_distribution<float> pos(0.0f, fSize);
+    std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
+
+    sWorld world;
+    for (uint32_t i = 0; i < nPlayers; i++) {
+        sPlayerDescription desc;
+        desc.nUniqueID = 10000 + i;
+        desc.vPos = {pos(rng), pos(rng)};
+        desc.vVel = olc::vf2d(dir(rng), dir(rng)) * 8.0f;
+        world.mapObjects.emplace(desc.nUniqueID, desc);
+    }
+    for (uint32_t i = 0; i < nBullets; i++) {
+        sBulletDescription bullet;
+        bullet.nOwnerID = 10000 + rng() % nPlayers;
+        bullet.vPos = {pos(rng), pos(rng)};
+        bullet.vVel = olc::vf2d(dir(rng), dir(rng)) * 20.0f;
+        world.listBullets.push_back(bullet);
+    }
+    return world;
+}
+
+// The passes of the client before the broadphase, every object against every other and every bullet against every player
+uint32_t UpdateAllPairs(sWorld &world, float fElapsedTime) {
+    uint32_t nHits = 0;
+    for (auto &object : world.mapObjects) {
+        object.second.vPos += object.second.vVel * fElapsedTime;
+        for (auto &targetObject : world.mapObjects) {
+            if (object.first == targetObject.first) continue;
+            float fDistance = (object.second.vPos - targetObject.second.vPos).mag();
+            if (fDistance <= object.second.fRadius + targetObject.second.fRadius) {
+                olc::vf2d dir = fDistance == 0 ? olc::vf2d(0.0f, 1.0f)
+                                               : (object.second.vPos - targetObject.second.vPos).norm();
+                float fOverlap = 0.5f * (fDistance - object.second.fRadius - targetObject.second.fRadius);
+                object.second.vPos -= fOverlap * dir;
+                targetObject.second.vPos += fOverlap * dir;
+            }
+        }
+    }
+    for (auto &bullet : world.listBullets) {
+        bullet.vPos += bullet.vVel * fElapsedTime;
+        for (auto &targetObject : world.mapObjects) {
+            if (bullet.nOwnerID == targetObject.first) continue;
+            float fDistance = (bullet.vPos - targetObject.second.vPos).mag();
+            if (fDistance <= bullet.fRadius + targetObject.second.fRadius) nHits++;
+        }
+    }
+    return nHits;
+}
+
+// The same passes with candidates from the grid, as the client does now
+uint32_t UpdateGrid(sWorld &world, SpatialHash &grid, float fElapsedTime) {
+    uint32_t nHits = 0;
+    grid.Clear();
+    float fMaxRadius = 0.0f, fMaxTravel = 0.0f;
+    for (auto &object : world.mapObjects) {
+        grid.Update(object.first, object.second.vPos);
+        fMaxRadius = std::max(fMaxRadius, object.second.fRadius);
+        fMaxTravel = std::max(fMaxTravel, object.second.vVel.mag() * fElapsedTime);
+    }
+    float fReach = fMaxRadius + 2.0f * fMaxTravel;
+
+    for (auto &object : world.mapObjects) {
+        object.second.vPos += object.second.vVel * fElapsedTime;
+        grid.QueryRadius(object.second.vPos, object.second.fRadius + fReach, [&](uint32_t nTargetID) {
+            if (object.first == nTargetID) return;
+            auto &targetObject = *world.mapObjects.find(nTargetID);
+            float fDistance = (object.second.vPos - targetObject.second.vPos).mag();
+            if (fDistance <= object.second.fRadius + targetObject.second.fRadius) {
+                olc::vf2d dir = fDistance == 0 ? olc::vf2d(0.0f, 1.0f)
+                                               : (object.second.vPos - targetObject.second.vPos).norm();
+                float fOverlap = 0.5f * (fDistance - object.second.fRadius - targetObject.second.fRadius);
+                object.second.vPos -= fOverlap * dir;
+                targetObject.second.vPos += fOverlap * dir;
+            }
+        });
+    }
+    for (auto &bullet : world.listBullets) {
+        bullet.vPos += bullet.vVel * fElapsedTime;
+        grid.QueryRadius(bullet.vPos, bullet.fRadius + fReach, [&](uint32_t nTargetID) {
+            if (bullet.nOwnerID == nTargetID) return;
+            auto &targetObject = *world.mapObjects.find(nTargetID);
+            float fDistance = (bullet.vPos - targetObject.second.vPos).mag();
+            if (fDistance <= bullet.fRadius + targetObject.second.fRadius) nHits++;
+        });
+    }
+    return nHits;
+}
+
+// Overlapping player pairs and bullet hits of a frozen world, found both ways, must be identical
+bool SamePairs(const sWorld &world) {
+    SpatialHash grid(2.0f);
+    for (auto &object : world.mapObjects) grid.Update(object.first, object.second.vPos);
+
+    std::vector<std::pair<uint32_t, uint32_t>> vAll, vGrid;
+    for (auto &object : world.mapObjects) {
+        for (auto &target : world.mapObjects)
+            if (object.first != target.first &&
+                (object.second.vPos - target.second.vPos).mag() <= object.second.fRadius + target.second.fRadius)
+                vAll.emplace_back(object.first, target.first);
+        grid.QueryRadius(object.second.vPos, object.second.fRadius * 2.0f, [&](uint32_t id) {
+            const auto &target = world.mapObjects.at(id);
+            if (object.first != id &&
+                (object.second.vPos - target.vPos).mag() <= object.second.fRadius + target.fRadius)
+                vGrid.emplace_back(object.first, id);
+        });
+    }
+    uint32_t nBullet = 0;
+    for (auto &bullet : world.listBullets) {
+        for (auto &target : world.mapObjects)
+            if ((bullet.vPos - target.second.vPos).mag() <= bullet.fRadius + target.second.fRadius)
+                vAll.emplace_back(nBullet, target.first);
+        grid.QueryRadius(bullet.vPos, bullet.fRadius + 0.5f, [&](uint32_t id) {
+            if ((bullet.vPos - world.mapObjects.at(id).vPos).mag() <= bullet.fRadius + world.mapObjects.at(id).fRadius)
+                vGrid.emplace_back(nBullet, id);
+        });
+        nBullet++;
+    }
+    std::sort(vAll.begin(), vAll.end());
+    std::sort(vGrid.begin(), vGrid.end());
+    return vAll == vGrid;
+}
+
+// Keeps the hit counts alive so the passes can't be optimized away
+static volatile uint32_t g_nSink = 0;
+
+// Average microseconds per frame of one path
+template<typename Function>
+double TimeFrames(uint32_t nFrames, Function &&update) {
+    auto tpStart = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < nFrames; i++) update();
+    auto tpEnd = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(tpEnd - tpStart).count() / nFrames;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t nFrames = argc > 1 ? uint32_t(std::stoul(argv[1])) : 60;
+    const float fElapsedTime = 1.0f / 60.0f;
+
+    std::cout << "frames per run: " << nFrames << ", one bullet per player\n";
+    std::cout << std::left << std::setw(12) << "entities" << std::setw(20) << "all pairs (us)"
+              << std::setw(20) << "spatial hash (us)" << "speedup\n";
+
+    bool bSame = true;
+    for (uint32_t nPlayers : {25u, 50u, 100u, 200u, 400u, 800u, 1600u}) {
+        sWorld world = MakeWorld(nPlayers, nPlayers, nPlayers);
+        bSame = SamePairs(world) && bSame;
+
+        sWorld worldAll = world, worldGrid = world;
+        SpatialHash grid(2.0f);
+        uint32_t nHits = 0;
+        double fAll = TimeFrames(nFrames, [&]() { nHits += UpdateAllPairs(worldAll, fElapsedTime); });
+        double fGrid = TimeFrames(nFrames, [&]() { nHits += UpdateGrid(worldGrid, grid, fElapsedTime); });
+
+        std::cout << std::left << std::setw(12) << nPlayers * 2
+                  << std::setw(20) << std::fixed << std::setprecision(1) << fAll
+                  << std::setw(20) << fGrid
+                  << std::setprecision(2) << fAll / fGrid << "x\n";
+        g_nSink = nHits;
+    }
+
+    std::cout << "same pairs found: " << (bSame ? "yes" : "NO") << "\n";
+    return bSame ? 0 : 1;
+}
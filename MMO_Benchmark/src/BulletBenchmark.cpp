@@ -0,0 +1,173 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <list>
+#include <algorithm>
+
+#include "MMO_Common.h"
+#include "MMO_CollisionMap.h"
+#include "MMO_BulletPool.h"
+
+// Cost of the bullet pass of MMOGame::OnUserUpdate during a firefight, a std::list of bullets swept one by one and
+// cleaned up with remove_if against the BulletPool. A burst of bouncing bullets is fired at once across a walled map
+// with pillars, and both paths fly it until the bullets are used up. Before timing, both must leave the same bullets
+// at the same places after every frame of a smaller burst.
+
+struct sMap {
+    std::string sTiles;
+    olc::vi2d vSize;
+    CollisionMap collision;
+};
+
+sMap MakeMap(int32_t nSize, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    sMap map;
+    map.vSize = {nSize, nSize};
+    map.sTiles.assign(size_t(nSize) * nSize, '.');
+    for (int32_t y = 0; y < nSize; y++) {
+        for (int32_t x = 0; x < nSize; x++) {
+            bool bBorder = x == 0 || y == 0 || x == nSize - 1 || y == nSize - 1;
+            if (bBorder || rng() % 10 == 0) map.sTiles[size_t(y) * nSize + x] = '#';
+        }
+    }
+    map.collision.Build(map.sTiles, map.vSize);
+    return map;
+}
+
+std::vector<sBulletDescription> MakeBurst(const sMap &map, uint32_t nBullets, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    std::uniform_int_distribution<int32_t> cell(1, map.vSize.x - 2);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+    std::vector<sBulletDescription> vBullets;
+    while (vBullets.size() < nBullets) {
+        olc::vi2d vCell = {cell(rng), cell(rng)};
+        if (map.sTiles[size_t(vCell.y) * map.vSize.x + vCell.x] == '#') continue;
+        float a = angle(rng);
+        sBulletDescription bullet;
+        bullet.nOwnerID = 10000 + uint32_t(vBullets.size() % 64);
+        bullet.nBounce = 3;
+        bullet.vPos = olc::vf2d(vCell) + olc::vf2d(0.5f, 0.5f);
+        bullet.vVel = olc::vf2d(std::cos(a), std::sin(a)) * 20.0f;
+        vBullets.push_back(bullet);
+    }
+    return vBullets;
+}
+
+// The bullet pass of the client with one node per bullet
+void UpdateList(std::list<sBulletDescription> &listBullets, const sMap &map, float fElapsedTime) {
+    for (auto &bullet : listBullets) {
+        olc::vf2d vDelta = bullet.vVel * fElapsedTime;
+        sSweepHit hit = map.collision.Sweep(bullet.vPos, vDelta, bullet.fRadius);
+        if (!hit.bHit) {
+            bullet.vPos += vDelta;
+            continue;
+        }
+        bullet.vPos += vDelta * hit.fTime + hit.vNormal * CollisionMap::fSkin;
+        if (bullet.nBounce > 0) bullet.vVel -= 2.0f * bullet.vVel.dot(hit.vNormal) * hit.vNormal;
+        bullet.nBounce--;
+    }
+    listBullets.remove_if([](sBulletDescription b) { return b.nBounce < 0; });
+}
+
+// Bullets of both paths sorted by position, as the pool doesn't keep the order
+bool SameBullets(const std::list<sBulletDescription> &listBullets, const BulletPool &pool) {
+    if (listBullets.size() != pool.Size()) return false;
+    auto less = [](const std::pair<olc::vf2d, int32_t> &a, const std::pair<olc::vf2d, int32_t> &b) {
+        if (a.first.x != b.first.x) return a.first.x < b.first.x;
+        return a.first.y != b.first.y ? a.first.y < b.first.y : a.second < b.second;
+    };
+    std::vector<std::pair<olc::vf2d, int32_t>> vList, vPool;
+    for (auto &bullet : listBullets) vList.emplace_back(bullet.vPos, bullet.nBounce);
+    for (size_t i = 0; i < pool.Size(); i++) vPool.emplace_back(pool.Pos(i), pool.Bounce(i));
+    std::sort(vList.begin(), vList.end(), less);
+    std::sort(vPool.begin(), vPool.end(), less);
+    for (size_t i = 0; i < vList.size(); i++) {
+        if ((vList[i].first - vPool[i].first).mag() > 1e-4f || vList[i].second != vPool[i].second) return false;
+    }
+    return true;
+}
+
+bool CheckBurst(const sMap &map, uint32_t nBullets, uint32_t nFrames, float fElapsedTime) {
+    auto vBurst = MakeBurst(map, nBullets, 7);
+    std::list<sBulletDescription> listBullets(vBurst.begin(), vBurst.end());
+    BulletPool pool;
+    for (auto &bullet : vBurst) pool.Add(bullet);
+
+    for (uint32_t nFrame = 0; nFrame < nFrames; nFrame++) {
+        UpdateList(listBullets, map, fElapsedTime);
+        pool.Update(map.collision, fElapsedTime);
+        pool.RemoveDead();
+        if (!SameBullets(listBullets, pool)) {
+            std::cout << "paths differ at frame " << nFrame << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Keeps the bullet counts alive so the passes can't be optimized away
+static volatile size_t g_nSink = 0;
+
+// Microseconds per frame of one path over the frames, the first frame is the worst as every bullet is alive
+struct sTiming {
+    double fAverage = 0.0;
+    double fWorst = 0.0;
+};
+
+template<typename Function>
+sTiming TimeFrames(uint32_t nFrames, Function &&update) {
+    sTiming timing;
+    for (uint32_t i = 0; i < nFrames; i++) {
+        auto tpStart = std::chrono::steady_clock::now();
+        update();
+        auto tpEnd = std::chrono::steady_clock::now();
+        double fFrame = std::chrono::duration<double, std::micro>(tpEnd - tpStart).count();
+        timing.fAverage += fFrame / nFrames;
+        timing.fWorst = std::max(timing.fWorst, fFrame);
+    }
+    return timing;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t nFrames = argc > 1 ? uint32_t(std::stoul(argv[1])) : 120;
+    const float fElapsedTime = 1.0f / 60.0f;
+    sMap map = MakeMap(256, 42);
+
+#if defined(__AVX__)
+    std::cout << "pool path: AVX\n";
+#elif defined(MMO_BULLETS_SSE2)
+    std::cout << "pool path: SSE2\n";
+#else
+    std::cout << "pool path: scalar\n";
+#endif
+
+    bool bSame = CheckBurst(map, 2000, 240, fElapsedTime);
+    std::cout << "same bullets every frame: " << (bSame ? "yes" : "NO") << "\n";
+
+    std::cout << "frames per burst: " << nFrames << ", 256x256 tiles, 3 bounces, budget 16667us at 60 fps\n";
+    std::cout << std::left << std::setw(10) << "bullets" << std::setw(16) << "list avg (us)"
+              << std::setw(16) << "list worst" << std::setw(16) << "pool avg (us)" << std::setw(16) << "pool worst"
+              << "speedup\n";
+
+    for (uint32_t nBullets : {1000u, 4000u, 16000u, 64000u}) {
+        auto vBurst = MakeBurst(map, nBullets, nBullets);
+        std::list<sBulletDescription> listBullets(vBurst.begin(), vBurst.end());
+        BulletPool pool;
+        for (auto &bullet : vBurst) pool.Add(bullet);
+
+        sTiming list = TimeFrames(nFrames, [&]() { UpdateList(listBullets, map, fElapsedTime); });
+        sTiming soa = TimeFrames(nFrames, [&]() {
+            pool.Update(map.collision, fElapsedTime);
+            pool.RemoveDead();
+        });
+        g_nSink = listBullets.size() + pool.Size();
+
+        std::cout << std::left << std::setw(10) << nBullets << std::fixed << std::setprecision(1)
+                  << std::setw(16) << list.fAverage << std::setw(16) << list.fWorst
+                  << std::setw(16) << soa.fAverage << std::setw(16) << soa.fWorst
+                  << std::setprecision(2) << list.fAverage / soa.fAverage << "x\n";
+    }
+    return bSame ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+
+#include "MMO_Common.h"
+#include "MMO_StateCodec.h"
+
+// Bytes per Game_UpdatePlayer with the raw sPlayerDescription against the delta encoded, quantized state.
+// A session is recorded first: players driven by random key presses through the movement model of the client at
+// 60 frames per second, sprinting, taking damage and dying now and then. Every frame of every player is then sent
+// through the codec and decoded again, as the server does with each client's stream.
+
+struct sSession {
+    uint32_t nPlayers = 0;
+    // nPlayers states per frame
+    std::vector<sPlayerDescription> vFrames;
+};
+
+sSession RecordSession(uint32_t nPlayers, uint32_t nFrames, uint32_t nSeed) {
+    const float fElapsedTime = 1.0f / 60.0f;
+    std::mt19937 rng(nSeed);
+    std::uniform_int_distribution<int> key(0, 8);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+    sSession session;
+    session.nPlayers = nPlayers;
+    std::vector<sPlayerDescription> vPlayers(nPlayers);
+    std::vector<olc::vf2d> vInput(nPlayers);
+    std::vector<bool> vSprint(nPlayers, false);
+    for (uint32_t i = 0; i < nPlayers; i++) {
+        vPlayers[i].nUniqueID = 10000 + i;
+        vPlayers[i].vPos = {3.0f + float(i % 16) * 4.0f, 3.0f + float(i / 16) * 4.0f};
+        vPlayers[i].pColor = olc::Pixel(rng() % 256, rng() % 256, rng() % 256);
+    }
+
+    session.vFrames.reserve(size_t(nPlayers) * nFrames);
+    for (uint32_t nFrame = 0; nFrame < nFrames; nFrame++) {
+        for (uint32_t i = 0; i < nPlayers; i++) {
+            auto &player = vPlayers[i];
+
+            // Players hold a direction for a while, a few times a second they change their mind
+            if (chance(rng) < 0.05f) {
+                int k = key(rng);
+                vInput[i] = k == 8 ? olc::vf2d(0.0f, 0.0f) : olc::vf2d(float(k % 3) - 1.0f, float(k / 3 % 3) - 1.0f);
+                vSprint[i] = chance(rng) < 0.2f;
+            }
+
+            // Same energy and movement model as MMOGame::HandleInput
+            if (vSprint[i] && player.nEnergy > 0 && player.vVel.mag2() > 0) {
+                player.fSpeed = 15.0f;
+                if (nFrame % 6 == 0) player.nEnergy--;
+            } else {
+                player.fSpeed = 8.0f;
+                if (nFrame % 18 == 0 && player.nEnergy < player.nMaxEnergy) player.nEnergy++;
+            }
+
+            olc::vf2d vControlAcc = vInput[i].mag2() > 0 ? vInput[i].norm() * 80.0f : olc::vf2d(0.0f, 0.0f);
+            olc::vf2d vEnvAcc = player.vVel.mag2() > 0 ? -player.vVel.norm() * 50.0f : olc::vf2d(0.0f, 0.0f);
+            player.vAcc = vEnvAcc + vControlAcc;
+
+            olc::vf2d before = player.vVel.norm();
+            if (player.vAcc.mag2() > 0) player.vVel += player.vAcc * fElapsedTime;
+            if (player.vVel.norm().dot(before) < 0) player.vVel = {0.0f, 0.0f};
+            if (player.vVel.mag() > player.fSpeed) player.vVel = player.fSpeed * player.vVel.norm();
+            player.vPos += player.vVel * fElapsedTime;
+
+            // Fights
+            if (chance(rng) < 0.002f) {
+                if (player.nHealth > 5) {
+                    player.nHealth -= 5;
+                } else {
+                    player.nHealth = 100;
+                    player.nDeaths++;
+                    vPlayers[(i + 1) % nPlayers].nKills++;
+                }
+            }
+
+            // Stamped like MMOGame stamps every state it sends
+            player.nSequence++;
+            player.nTime = nFrame * 1000 / 60;
+            session.vFrames.push_back(player);
+        }
+    }
+    return session;
+}
+
+struct sResult {
+    double fBytesPerUpdate = 0.0;
+    float fMaxError = 0.0f;
+    uint64_t nMismatches = 0;
+};
+
+sResult Replay(const sSession &session, uint32_t nStepsPerUnit) {
+    PlayerStateCodec codec(nStepsPerUnit);
+    std::vector<sPlayerDescription> vSent(session.nPlayers), vReceived(session.nPlayers);
+    std::vector<uint8_t> vBuffer;
+
+    sResult result;
+    uint64_t nBytes = 0;
+    for (size_t i = 0; i < session.vFrames.size(); i++) {
+        const auto &state = session.vFrames[i];
+        size_t nPlayer = i % session.nPlayers;
+
+        vBuffer.clear();
+        codec.Encode(state, vSent[nPlayer], vBuffer);
+        nBytes += vBuffer.size();
+
+        const uint8_t *p = vBuffer.data();
+        if (!codec.Decode(p, p + vBuffer.size(), vReceived[nPlayer]) || p != vBuffer.data() + vBuffer.size())
+            result.nMismatches++;
+
+        // The decoder must end up exactly where the encoder thinks it is, and close to the real state
+        const auto &received = vReceived[nPlayer];
+        const auto &sent = vSent[nPlayer];
+        if (received.nUniqueID != sent.nUniqueID || received.nHealth != sent.nHealth ||
+            received.nEnergy != sent.nEnergy || received.nKills != sent.nKills || received.nDeaths != sent.nDeaths ||
+            received.fSpeed != sent.fSpeed || received.vPos != sent.vPos || received.vVel != sent.vVel ||
+            received.vAcc != sent.vAcc || received.nHealth != state.nHealth || received.pColor.n != state.pColor.n ||
+            received.nSequence != state.nSequence || received.nTime != state.nTime)
+            result.nMismatches++;
+        result.fMaxError = std::max(result.fMaxError, (received.vPos - state.vPos).mag());
+    }
+    result.fBytesPerUpdate = double(nBytes) / session.vFrames.size();
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t nPlayers = argc > 1 ? uint32_t(std::stoul(argv[1])) : 64;
+    uint32_t nSeconds = argc > 2 ? uint32_t(std::stoul(argv[2])) : 60;
+
+    sSession session = RecordSession(nPlayers, nSeconds * 60, 42);
+    std::cout << "session: " << nPlayers << " players, " << nSeconds << "s at 60 updates/s, "
+              << session.vFrames.size() << " updates\n";
+    std::cout << "raw sPlayerDescription: " << sizeof(sPlayerDescription) << " B/update\n";
+    std::cout << std::left << std::setw(16) << "steps/tile" << std::setw(16) << "B/update" << std::setw(12) << "ratio"
+              << std::setw(20) << "max pos error" << "mismatches\n";
+
+    uint64_t nMismatches = 0;
+    for (uint32_t nSteps : {16u, 64u, 256u, 1024u}) {
+        sResult result = Replay(session, nSteps);
+        nMismatches += result.nMismatches;
+        std::cout << std::left << std::setw(16) << nSteps
+                  << std::setw(16) << std::fixed << std::setprecision(2) << result.fBytesPerUpdate
+                  << std::setw(12) << sizeof(sPlayerDescription) / result.fBytesPerUpdate
+                  << std::setw(20) << std::setprecision(5) << result.fMaxError
+                  << result.nMismatches << "\n";
+    }
+    return nMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <algorithm>
+
+#include "olcPixelGameEngine.h"
+#include "MMO_CollisionMap.h"
+
+// CollisionMap against the per tile '#' scan the client did before. The map is checked first: solid tiles and
+// clearance against brute force, swept circles against a finely stepped walk of the same move, fast circles against
+// thin walls, and slides never ending inside a wall. Then generated maps of growing size are built and queried with
+// random player moves (the old scan against Move) and bullet moves (the old scan against Sweep).
+
+struct sMap {
+    std::string sTiles;
+    olc::vi2d vSize;
+};
+
+sMap MakeMap(int32_t nSize, uint32_t nSolidPercent, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    sMap map;
+    map.vSize = {nSize, nSize};
+    map.sTiles.assign(size_t(nSize) * nSize, '.');
+    for (int32_t y = 0; y < nSize; y++) {
+        for (int32_t x = 0; x < nSize; x++) {
+            bool bBorder = x == 0 || y == 0 || x == nSize - 1 || y == nSize - 1;
+            if (bBorder || rng() % 100 < nSolidPercent) map.sTiles[size_t(y) * nSize + x] = '#';
+        }
+    }
+    return map;
+}
+
+bool Solid(const sMap &map, int32_t x, int32_t y) {
+    if (x < 0 || y < 0 || x >= map.vSize.x || y >= map.vSize.y) return false;
+    return map.sTiles[size_t(y) * map.vSize.x + x] == '#';
+}
+
+// Distance from a point to the nearest solid tile, looking at every tile up to 3 tiles away
+float Distance(const sMap &map, const olc::vf2d &vPos) {
+    float fBest = INFINITY;
+    olc::vi2d vCell = vPos.floor();
+    for (int32_t y = vCell.y - 3; y <= vCell.y + 3; y++) {
+        for (int32_t x = vCell.x - 3; x <= vCell.x + 3; x++) {
+            if (!Solid(map, x, y)) continue;
+            olc::vf2d vNearest = {std::max(float(x), std::min(vPos.x, float(x + 1))),
+                                  std::max(float(y), std::min(vPos.y, float(y + 1)))};
+            fBest = std::min(fBest, (vPos - vNearest).mag());
+        }
+    }
+    return fBest;
+}
+
+bool CheckTiles(const sMap &map, const CollisionMap &collision) {
+    for (int32_t y = -2; y < map.vSize.y + 2; y++) {
+        for (int32_t x = -2; x < map.vSize.x + 2; x++) {
+            if (collision.IsSolid(x, y) != Solid(map, x, y)) return false;
+            if (x < 0 || y < 0 || x >= map.vSize.x || y >= map.vSize.y) continue;
+
+            const int32_t nMax = CollisionMap::nMaxClearance;
+            int32_t nBest = nMax;
+            for (int32_t sy = y - nMax; sy <= y + nMax; sy++)
+                for (int32_t sx = x - nMax; sx <= x + nMax; sx++)
+                    if (Solid(map, sx, sy)) nBest = std::min(nBest, std::max(std::abs(sx - x), std::abs(sy - y)));
+            if (collision.Clearance(x, y) != nBest) return false;
+        }
+    }
+    return true;
+}
+
+// Random sweeps, compared with the first overlap found by walking the move in small steps
+bool CheckSweeps(const sMap &map, const CollisionMap &collision, uint32_t nSweeps) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos(1.0f, float(map.vSize.x - 1));
+    std::uniform_real_distribution<float> move(-3.0f, 3.0f);
+    std::uniform_real_distribution<float> radius(0.1f, 0.6f);
+    const uint32_t nSteps = 1024;
+    const float fTolerance = 2e-3f;
+
+    uint32_t nChecked = 0, nHits = 0, nFailed = 0;
+    while (nChecked < nSweeps) {
+        olc::vf2d vStart = {pos(rng), pos(rng)};
+        olc::vf2d vDelta = {move(rng), move(rng)};
+        float fRadius = radius(rng);
+        if (Distance(map, vStart) < fRadius + fTolerance) continue;
+        nChecked++;
+
+        float fFirstOverlap = -1.0f;
+        for (uint32_t k = 1; k <= nSteps && fFirstOverlap < 0; k++) {
+            float t = float(k) / nSteps;
+            if (Distance(map, vStart + vDelta * t) < fRadius - fTolerance) fFirstOverlap = t;
+        }
+
+        sSweepHit hit = collision.Sweep(vStart, vDelta, fRadius);
+        bool bOk = true;
+        if (fFirstOverlap >= 0) bOk = hit.bHit && hit.fTime <= fFirstOverlap + 1e-3f;
+        if (hit.bHit) {
+            // Touching, not inside, where the sweep stops, and a normal pointing back against the move
+            nHits++;
+            float fContact = Distance(map, vStart + vDelta * hit.fTime);
+            bOk = bOk && std::abs(fContact - fRadius) < fTolerance && std::abs(hit.vNormal.mag() - 1.0f) < 1e-3f &&
+                  hit.vNormal.dot(vDelta) < 0;
+        }
+        if (!bOk) nFailed++;
+    }
+    std::cout << "sweeps: " << nChecked << " checked, " << nHits << " hits, " << nFailed << " wrong\n";
+    return nFailed == 0;
+}
+
+// Circles fired at a wall one tile thick, up to 50 tiles per step, must stop in front of it
+bool CheckTunnelling() {
+    sMap map;
+    map.vSize = {64, 8};
+    map.sTiles.assign(64 * 8, '.');
+    for (int32_t y = 0; y < 8; y++) map.sTiles[size_t(y) * 64 + 32] = '#';
+    CollisionMap collision(map.sTiles, map.vSize);
+
+    for (float fSpeed = 2.0f; fSpeed <= 50.0f; fSpeed += 0.5f) {
+        sSweepHit hit = collision.Sweep({30.5f, 4.3f}, {fSpeed, 0.1f}, 0.2f);
+        if (!hit.bHit || 30.5f + fSpeed * hit.fTime + 0.2f > 32.0f + 1e-3f || hit.vNormal.x != -1.0f) return false;
+    }
+    return true;
+}
+
+// Random slides must never end inside a wall
+bool CheckMoves(const sMap &map, const CollisionMap &collision, uint32_t nMoves) {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> pos(1.0f, float(map.vSize.x - 1));
+    std::uniform_real_distribution<float> move(-2.0f, 2.0f);
+    uint32_t nChecked = 0;
+    while (nChecked < nMoves) {
+        olc::vf2d vStart = {pos(rng), pos(rng)};
+        if (Distance(map, vStart) < 0.5f) continue;
+        nChecked++;
+        olc::vf2d vEnd = collision.Move(vStart, {move(rng), move(rng)}, 0.5f);
+        if (Distance(map, vEnd) < 0.5f - 1e-3f) return false;
+    }
+    return true;
+}
+
+// The player pass of the client before the collision map
+olc::vf2d ScanPlayer(const sMap &map, const olc::vf2d &vPos, const olc::vf2d &vDelta, float fRadius) {
+    const std::string &sWorldMap = map.sTiles;
+    const olc::vi2d &vWorldSize = map.vSize;
+    olc::vf2d vPotentialPosition = vPos + vDelta;
+
+    olc::vi2d vCurrentCell = vPos.floor();
+    olc::vi2d vTargetCell = vPotentialPosition;
+    olc::vi2d vAreaTL = (vCurrentCell.min(vTargetCell) - olc::vi2d(1, 1)).max({0, 0});
+    olc::vi2d vAreaBR = (vCurrentCell.max(vTargetCell) + olc::vi2d(1, 1)).min(vWorldSize);
+
+    olc::vi2d vCell;
+    for (vCell.y = vAreaTL.y; vCell.y <= vAreaBR.y; vCell.y++) {
+        for (vCell.x = vAreaTL.x; vCell.x <= vAreaBR.x; vCell.x++) {
+            if (sWorldMap[vCell.y * vWorldSize.x + vCell.x] == '#') {
+                olc::vf2d vNearestPoint;
+                vNearestPoint.x = std::max(float(vCell.x), std::min(vPotentialPosition.x, float(vCell.x + 1)));
+                vNearestPoint.y = std::max(float(vCell.y), std::min(vPotentialPosition.y, float(vCell.y + 1)));
+
+                olc::vf2d vRayToNearest = vNearestPoint - vPotentialPosition;
+                float fOverlap = fRadius - vRayToNearest.mag();
+                if (std::isnan(fOverlap)) fOverlap = 0;
+                if (fOverlap > 0) vPotentialPosition = vPotentialPosition - vRayToNearest.norm() * fOverlap;
+            }
+        }
+    }
+    return vPotentialPosition;
+}
+
+// Keeps the results alive so the queries can't be optimized away
+static volatile float g_fSink = 0.0f;
+
+template<typename Function>
+double NanosecondsPerCall(size_t nCalls, Function &&f) {
+    auto tpStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < nCalls; i++) f(i);
+    auto tpEnd = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(tpEnd - tpStart).count() / nCalls;
+}
+
+int main(int argc, char *argv[]) {
+    size_t nQueries = argc > 1 ? size_t(std::stoul(argv[1])) : 1000000;
+
+    sMap mapCheck = MakeMap(48, 20, 3);
+    CollisionMap collisionCheck(mapCheck.sTiles, mapCheck.vSize);
+    // Sparse enough for clearances past the cap, and over several chunks
+    sMap mapChunks = MakeMap(300, 1, 5);
+    bool bTiles = CheckTiles(mapCheck, collisionCheck) &&
+                  CheckTiles(mapChunks, CollisionMap(mapChunks.sTiles, mapChunks.vSize));
+    bool bSweeps = CheckSweeps(mapCheck, collisionCheck, 20000);
+    bool bTunnelling = CheckTunnelling();
+    bool bMoves = CheckMoves(mapCheck, collisionCheck, 20000);
+    std::cout << "solid tiles and clearance: " << (bTiles ? "ok" : "WRONG") << "\n";
+    std::cout << "sweeps against stepping: " << (bSweeps ? "ok" : "WRONG") << "\n";
+    std::cout << "no tunnelling through thin walls: " << (bTunnelling ? "ok" : "WRONG") << "\n";
+    std::cout << "slides end outside walls: " << (bMoves ? "ok" : "WRONG") << "\n\n";
+
+    std::cout << "queries per map: " << nQueries << ", 10% pillars, moves of 1/3 tile\n";
+    std::cout << std::left << std::setw(8) << "map" << std::setw(12) << "build (ms)" << std::setw(14) << "string (KB)"
+              << std::setw(14) << "map (KB)" << std::setw(16) << "player scan ns" << std::setw(16) << "Move ns"
+              << std::setw(16) << "bullet scan ns" << "Sweep ns\n";
+
+    for (int32_t nSize : {256, 1024, 4096}) {
+        sMap map = MakeMap(nSize, 10, uint32_t(nSize));
+        auto tpStart = std::chrono::steady_clock::now();
+        CollisionMap collision(map.sTiles, map.vSize);
+        double fBuild = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+
+        // Movers spread over the whole map, starting clear of the walls
+        std::mt19937 rng{uint32_t(nSize)};
+        std::uniform_real_distribution<float> pos(1.0f, float(nSize - 1));
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        std::vector<olc::vf2d> vStart, vDelta;
+        while (vStart.size() < 4096) {
+            olc::vf2d v = {pos(rng), pos(rng)};
+            if (collision.Clearance(int32_t(v.x), int32_t(v.y)) == 0) continue;
+            v = collision.PushOut(v, 0.5f);
+            float a = angle(rng);
+            vStart.push_back(v);
+            vDelta.push_back(olc::vf2d(std::cos(a), std::sin(a)) / 3.0f);
+        }
+        auto nQuery = [&](size_t i) { return (i * 2654435761u) % vStart.size(); };
+
+        float fSum = 0.0f;
+        double fPlayerScan = NanosecondsPerCall(nQueries, [&](size_t i) {
+            fSum += ScanPlayer(map, vStart[nQuery(i)], vDelta[nQuery(i)], 0.5f).x;
+        });
+        double fMove = NanosecondsPerCall(nQueries, [&](size_t i) {
+            fSum += collision.Move(vStart[nQuery(i)], vDelta[nQuery(i)], 0.5f).x;
+        });
+        double fBulletScan = NanosecondsPerCall(nQueries, [&](size_t i) {
+            fSum += ScanPlayer(map, vStart[nQuery(i)], vDelta[nQuery(i)], 0.2f).x;
+        });
+        double fSweep = NanosecondsPerCall(nQueries, [&](size_t i) {
+            fSum += collision.Sweep(vStart[nQuery(i)], vDelta[nQuery(i)], 0.2f).fTime;
+        });
+        g_fSink = fSum;
+
+        std::cout << std::left << std::setw(8) << nSize << std::fixed << std::setprecision(1)
+                  << std::setw(12) << fBuild << std::setw(14) << map.sTiles.size() / 1024.0
+                  << std::setw(14) << collision.MemoryBytes() / 1024.0
+                  << std::setw(16) << fPlayerScan << std::setw(16) << fMove
+                  << std::setw(16) << fBulletScan << fSweep << "\n";
+    }
+    return bTiles && bSweeps && bTunnelling && bMoves ? 0 : 1;
+}
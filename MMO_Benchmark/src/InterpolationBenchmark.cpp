@@ -0,0 +1,151 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "MMO_Common.h"
+#include "MMO_SnapshotBuffer.h"
+
+// How smoothly a remote player is drawn: snapped to each state as it arrives and moved on by its velocity every frame,
+// as the client did, against drawn from a SnapshotBuffer. The player runs in a circle and its client sends its state
+// at a fixed rate, the states cross a network adding a random delay and losing some, in the order they arrive, and the
+// receiver draws a frame at its own rate. Jitter is how far the movement drawn in a frame is from how far the player
+// really moved in a frame. Without delay variation or loss the buffer must draw the true path, only late.
+
+struct sNetwork {
+    float fMinLatency = 0.03f;
+    // Added to the latency of each state, uniformly up to this
+    float fJitter = 0.06f;
+    float fLoss = 0.05f;
+};
+
+struct sArrival {
+    double fTime = 0.0;
+    sPlayerDescription state;
+};
+
+const float fRadius = 5.0f, fAngularSpeed = 0.8f;
+
+olc::vf2d TruePos(double fTime) {
+    float a = float(fTime) * fAngularSpeed;
+    return {fRadius * std::cos(a), fRadius * std::sin(a)};
+}
+
+olc::vf2d TrueVel(double fTime) {
+    float a = float(fTime) * fAngularSpeed;
+    return olc::vf2d(-std::sin(a), std::cos(a)) * fRadius * fAngularSpeed;
+}
+
+// Every state the sender sends during fSeconds, with when it arrives, in arrival order
+std::vector<sArrival> Send(float fSendRate, float fSeconds, const sNetwork &network, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+    std::vector<sArrival> vArrivals;
+    uint32_t nSequence = 0;
+    for (double fTime = 0.0; fTime < fSeconds; fTime += 1.0 / fSendRate) {
+        sPlayerDescription state;
+        state.nUniqueID = 1;
+        state.vPos = TruePos(fTime);
+        state.vVel = TrueVel(fTime);
+        state.nSequence = ++nSequence;
+        state.nTime = uint32_t(std::lround(fTime * 1000.0));
+        if (chance(rng) < network.fLoss) continue;
+        vArrivals.push_back({fTime + network.fMinLatency + network.fJitter * chance(rng), state});
+    }
+    std::stable_sort(vArrivals.begin(), vArrivals.end(),
+                     [](const sArrival &a, const sArrival &b) { return a.fTime < b.fTime; });
+    return vArrivals;
+}
+
+struct sResult {
+    double fMeanJitter = 0.0;
+    double fMaxJitter = 0.0;
+    // Frames drawn more than fSnap off the true movement of a frame
+    uint64_t nSnaps = 0;
+    // Largest distance to the true path, delayed by fLag
+    double fMaxError = 0.0;
+};
+
+const float fSnap = 0.05f;
+
+template<typename Draw>
+sResult Render(const std::vector<sArrival> &vArrivals, float fFrameRate, float fSeconds, double fLag, Draw &&draw) {
+    sResult result;
+    size_t nNext = 0, nFrames = 0;
+    olc::vf2d vLast;
+    const double fFrame = 1.0 / fFrameRate;
+    // Measured after the first half second, once the buffer saw states arrive one by one
+    for (double fNow = 0.0; fNow < fSeconds; fNow += fFrame) {
+        std::vector<const sPlayerDescription *> vArrived;
+        while (nNext < vArrivals.size() && vArrivals[nNext].fTime <= fNow) vArrived.push_back(&vArrivals[nNext++].state);
+        olc::vf2d vPos = draw(fNow, float(fFrame), vArrived);
+
+        if (fNow > 0.5) {
+            result.fMaxError = std::max(result.fMaxError, double((vPos - TruePos(fNow - fLag)).mag()));
+            double fJitter = ((vPos - vLast) - (TruePos(fNow - fLag) - TruePos(fNow - fLag - fFrame))).mag();
+            result.fMeanJitter += fJitter;
+            result.fMaxJitter = std::max(result.fMaxJitter, fJitter);
+            if (fJitter > fSnap) result.nSnaps++;
+            nFrames++;
+        }
+        vLast = vPos;
+    }
+    result.fMeanJitter /= double(std::max<size_t>(nFrames, 1));
+    return result;
+}
+
+sResult RenderLatest(const std::vector<sArrival> &vArrivals, float fFrameRate, float fSeconds) {
+    sPlayerDescription drawn;
+    return Render(vArrivals, fFrameRate, fSeconds, 0.0, [&](double, float fElapsed, auto &vArrived) {
+        for (auto *state : vArrived) drawn = *state;
+        drawn.vPos += drawn.vVel * fElapsed;
+        return drawn.vPos;
+    });
+}
+
+sResult RenderBuffered(const std::vector<sArrival> &vArrivals, float fFrameRate, float fSeconds, double fDelay,
+                       double fLag) {
+    SnapshotBuffer buffer;
+    sPlayerDescription drawn;
+    return Render(vArrivals, fFrameRate, fSeconds, fLag, [&](double fNow, float, auto &vArrived) {
+        for (auto *state : vArrived) buffer.Push(*state, fNow);
+        buffer.Sample(fNow, fDelay, 0.25, drawn);
+        return drawn.vPos;
+    });
+}
+
+int main(int argc, char *argv[]) {
+    float fSendRate = argc > 1 ? std::stof(argv[1]) : 20.0f;
+    float fFrameRate = argc > 2 ? std::stof(argv[2]) : 144.0f;
+    const float fSeconds = 60.0f;
+    const double fDelay = 2.0 / fSendRate;
+
+    std::cout << "player sent at " << fSendRate << "Hz, drawn at " << fFrameRate << " frames/s for " << fSeconds
+              << "s, interpolation delay " << fDelay * 1000.0 << "ms, jitter over " << fSnap << " tiles is a snap\n";
+    std::cout << std::left << std::setw(30) << "network" << std::setw(12) << "drawn"
+              << std::setw(20) << "mean jitter (tile)" << std::setw(18) << "max jitter (tile)" << "snaps\n";
+    std::cout << std::fixed << std::setprecision(4);
+
+    sNetwork vNetworks[] = {{0.03f, 0.0f, 0.0f}, {0.03f, 0.03f, 0.0f}, {0.03f, 0.06f, 0.05f}, {0.05f, 0.12f, 0.1f}};
+    bool bTrue = true;
+    for (const auto &network : vNetworks) {
+        auto vArrivals = Send(fSendRate, fSeconds, network, 42);
+        std::string sNetwork = std::to_string(int(network.fMinLatency * 1000)) + "ms +0-" +
+                               std::to_string(int(network.fJitter * 1000)) + "ms, " +
+                               std::to_string(int(network.fLoss * 100)) + "% lost";
+        sResult latest = RenderLatest(vArrivals, fFrameRate, fSeconds);
+        sResult buffered = RenderBuffered(vArrivals, fFrameRate, fSeconds, fDelay, network.fMinLatency + fDelay);
+        std::cout << std::setw(30) << sNetwork << std::setw(12) << "latest" << std::setw(20) << latest.fMeanJitter
+                  << std::setw(18) << latest.fMaxJitter << latest.nSnaps << "\n";
+        std::cout << std::setw(30) << "" << std::setw(12) << "buffered" << std::setw(20) << buffered.fMeanJitter
+                  << std::setw(18) << buffered.fMaxJitter << buffered.nSnaps << "\n";
+        // Arrivals are only seen at frames, so the buffer may run up to a frame late
+        if (network.fJitter == 0.0f && network.fLoss == 0.0f)
+            bTrue = buffered.fMaxError < fRadius * fAngularSpeed / fFrameRate + 0.01f;
+    }
+
+    std::cout << "\nbuffer draws the true path, late, on a steady network: " << (bTrue ? "yes" : "NO") << "\n";
+    return bTrue ? 0 : 1;
+}
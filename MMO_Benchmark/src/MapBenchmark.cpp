@@ -0,0 +1,138 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <fstream>
+#include <chrono>
+
+#include "olcPixelGameEngine.h"
+#include "MMO_MapFile.h"
+#include "MMO_CollisionMap.h"
+
+// Loading a big map the way the client did, a text file read into a string with the collision data built for every
+// tile, against opening the binary chunked file with the chunks streamed in around the players. Both files are
+// written first, so the timings are with the file in the OS cache. The mapped map must answer the same as the text
+// one: every tile, and the clearance of every tile around the players.
+
+struct sMap {
+    std::string sTiles;
+    olc::vi2d vSize;
+};
+
+sMap MakeMap(int32_t nSize, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    sMap map;
+    map.vSize = {nSize, nSize};
+    map.sTiles.assign(size_t(nSize) * nSize, '.');
+    for (int32_t y = 0; y < nSize; y++) {
+        for (int32_t x = 0; x < nSize; x++) {
+            bool bBorder = x == 0 || y == 0 || x == nSize - 1 || y == nSize - 1;
+            if (bBorder || rng() % 100 < 2) map.sTiles[size_t(y) * nSize + x] = '#';
+        }
+    }
+    return map;
+}
+
+bool WriteText(const sMap &map, const std::string &sPath) {
+    std::ofstream file(sPath, std::ios::trunc);
+    for (int32_t y = 0; y < map.vSize.y; y++)
+        file.write(map.sTiles.data() + size_t(y) * map.vSize.x, map.vSize.x) << "\n";
+    return bool(file);
+}
+
+// Players gathered in a few groups, as they would be around the points of interest of a map
+std::vector<olc::vf2d> MakePlayers(int32_t nSize, size_t nPlayers) {
+    std::mt19937 rng{uint32_t(nPlayers)};
+    std::uniform_real_distribution<float> group(64.0f, float(nSize - 64)), spread(-48.0f, 48.0f);
+    std::vector<olc::vf2d> vGroups(8);
+    for (auto &vGroup : vGroups) vGroup = {group(rng), group(rng)};
+    std::vector<olc::vf2d> vPlayers;
+    for (size_t i = 0; i < nPlayers; i++)
+        vPlayers.push_back(vGroups[i % vGroups.size()] + olc::vf2d(spread(rng), spread(rng)));
+    return vPlayers;
+}
+
+bool CheckSame(const CollisionMap &text, const CollisionMap &mapped, const std::vector<olc::vf2d> &vPlayers) {
+    olc::vi2d vSize = text.Size();
+    if (mapped.Size() != vSize) return false;
+    for (int32_t y = -1; y <= vSize.y; y++)
+        for (int32_t x = -1; x <= vSize.x; x++)
+            if (text.IsSolid(x, y) != mapped.IsSolid(x, y)) return false;
+
+    for (auto &vPlayer : vPlayers) {
+        olc::vi2d vTile = vPlayer.floor();
+        for (int32_t y = vTile.y - 32; y <= vTile.y + 32; y++)
+            for (int32_t x = vTile.x - 32; x <= vTile.x + 32; x++)
+                if (text.Clearance(x, y) != mapped.Clearance(x, y)) return false;
+    }
+    return true;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point tpStart) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+}
+
+int main(int argc, char *argv[]) {
+    int32_t nSize = argc > 1 ? std::stoi(argv[1]) : 4096;
+    const size_t nPlayers = 64;
+    const std::string sText = "map_benchmark.txt", sBinary = "map_benchmark.mmo";
+
+    {
+        sMap map = MakeMap(nSize, 42);
+        MapFile file;
+        file.FromText(map.sTiles, map.vSize);
+        if (!WriteText(map, sText) || !file.Save(sBinary)) {
+            std::cout << "can't write the maps\n";
+            return 1;
+        }
+    }
+    auto vPlayers = MakePlayers(nSize, nPlayers);
+
+    // Mapped first, as memory given back by the text load isn't always returned to the system
+    size_t nBefore = ResidentMemoryBytes();
+    auto tpStart = std::chrono::steady_clock::now();
+    MapFile file;
+    bool bOpened = file.Open(sBinary) && file.IsMapped();
+    CollisionMap mapped(std::move(file));
+    double fOpen = Milliseconds(tpStart);
+    tpStart = std::chrono::steady_clock::now();
+    mapped.Stream(vPlayers, 1);
+    double fStreamIn = Milliseconds(tpStart);
+    size_t nMapped = ResidentMemoryBytes() - nBefore;
+
+    // Players staying in their chunks, what every later call costs
+    tpStart = std::chrono::steady_clock::now();
+    const int nStreams = 100;
+    for (int i = 0; i < nStreams; i++) mapped.Stream(vPlayers, 1);
+    double fStream = Milliseconds(tpStart) / nStreams;
+
+    nBefore = ResidentMemoryBytes();
+    tpStart = std::chrono::steady_clock::now();
+    MapFile fileText;
+    bool bRead = fileText.LoadText(sText);
+    CollisionMap text(std::move(fileText));
+    text.StreamAll();
+    double fText = Milliseconds(tpStart);
+    size_t nText = ResidentMemoryBytes() - nBefore;
+
+    bool bSame = bOpened && bRead && CheckSame(text, mapped, vPlayers);
+    std::cout << "mapped map answers like the text map: " << (bSame ? "yes" : "NO") << "\n\n";
+
+    std::cout << "map " << nSize << "x" << nSize << ", " << nPlayers << " players in 8 groups, chunks of "
+              << MapFile::nChunkSize << " tiles streamed 1 chunk around them\n";
+    std::cout << std::left << std::setw(22) << "load" << std::setw(14) << "time (ms)"
+              << std::setw(16) << "resident (KB)" << std::setw(16) << "map data (KB)" << "chunks\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(22) << "text, all chunks" << std::setw(14) << fText << std::setw(16) << nText / 1024
+              << std::setw(16) << text.MemoryBytes() / 1024 << text.ResidentChunks() << "/" << text.Chunks() << "\n";
+    std::cout << std::setw(22) << "mapped, streamed" << std::setw(14) << fOpen + fStreamIn << std::setw(16)
+              << nMapped / 1024 << std::setw(16) << mapped.MemoryBytes() / 1024 << mapped.ResidentChunks() << "/"
+              << mapped.Chunks() << "\n";
+    std::cout << std::setprecision(3) << "open: " << fOpen << "ms, first stream: " << fStreamIn
+              << "ms, later streams: " << fStream << "ms\n";
+
+    std::remove(sText.c_str());
+    std::remove(sBinary.c_str());
+    return bSame ? 0 : 1;
+}
@@ -0,0 +1,402 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <algorithm>
+
+#include "MMO_Common.h"
+
+// Cost of the bsl::net primitives with the payloads the game sends: message operator<< and operator>>, and
+// message_writer and message_reader, of player, bullet and hit descriptions, tsqueue and mpscqueue push and pop from several producers, and full round trips
+// through connection over loopback against an echo server_interface. Every result is printed and, with --out, also
+// appended to a file as one JSON object per line, tagged with --label, to compare runs across versions of
+// net_message.h, net_tsqueue.h and net_connection.h:
+//     MMO_NetBenchmark --label before --out net.jsonl
+
+using OwnedMsg = bsl::net::owned_message<GameMsg>;
+
+struct sResult {
+    std::string sBenchmark;
+    std::string sPayload;
+    // Descriptions per message, their size on the wire and the threads involved
+    size_t nItems = 0;
+    size_t nBytes = 0;
+    size_t nThreads = 0;
+    double fValue = 0.0;
+    std::string sUnit;
+};
+
+class Results {
+public:
+    Results(std::ostream &out, const std::string &sLabel, const std::string &sPath)
+            : m_out(out), m_sLabel(JsonEscape(sLabel)) {
+        if (!sPath.empty()) m_file.open(sPath, std::ios::app);
+        m_out << std::left << std::setw(22) << "benchmark" << std::setw(16) << "payload" << std::setw(8) << "items"
+              << std::setw(10) << "bytes" << std::setw(10) << "threads" << "result\n";
+    }
+
+    void Add(const sResult &result) {
+        m_out << std::left << std::setw(22) << result.sBenchmark << std::setw(16) << result.sPayload
+              << std::setw(8) << result.nItems << std::setw(10) << result.nBytes << std::setw(10) << result.nThreads
+              << std::fixed << std::setprecision(2) << result.fValue << " " << result.sUnit << "\n";
+        if (!m_file) return;
+        m_file << "{\"label\":\"" << m_sLabel << "\",\"benchmark\":\"" << result.sBenchmark << "\",\"payload\":\""
+               << result.sPayload << "\",\"items\":" << result.nItems << ",\"bytes\":" << result.nBytes
+               << ",\"threads\":" << result.nThreads << ",\"value\":" << std::setprecision(4) << result.fValue
+               << ",\"unit\":\"" << result.sUnit << "\"}\n";
+    }
+
+private:
+    // s as the inside of a JSON string, the label is given on the command line and may hold anything
+    static std::string JsonEscape(const std::string &s) {
+        std::string sOut;
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                sOut += '\\';
+                sOut += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                const char *sHex = "0123456789abcdef";
+                sOut += "\\u00";
+                sOut += sHex[c >> 4];
+                sOut += sHex[c & 0xf];
+            } else {
+                sOut += c;
+            }
+        }
+        return sOut;
+    }
+
+    std::ostream &m_out;
+    // Escaped for the JSON lines
+    std::string m_sLabel;
+    std::ofstream m_file;
+};
+
+template<typename Description>
+struct sPayload;
+
+template<>
+struct sPayload<sPlayerDescription> {
+    static constexpr const char *sName = "player";
+
+    // A description that differs from the one of every other n
+    static sPlayerDescription Make(uint32_t n) {
+        sPlayerDescription desc;
+        desc.nUniqueID = n;
+        desc.nHealth = n % 100;
+        desc.vPos = {float(n), -float(n)};
+        desc.vVel = {0.5f * float(n), 1.0f};
+        desc.nSequence = n;
+        desc.nTime = 50 * n;
+        return desc;
+    }
+};
+
+template<>
+struct sPayload<sBulletDescription> {
+    static constexpr const char *sName = "bullet";
+
+    static sBulletDescription Make(uint32_t n) {
+        sBulletDescription bullet;
+        bullet.nOwnerID = n;
+        bullet.vPos = {float(n), -float(n)};
+        bullet.vVel = {20.0f, float(n)};
+        return bullet;
+    }
+};
+
+template<>
+struct sPayload<sHitDescription> {
+    static constexpr const char *sName = "hit";
+
+    static sHitDescription Make(uint32_t n) {
+        return {n, n + 1, n % 7};
+    }
+};
+
+// Keeps the results alive so the work can't be optimized away
+static volatile size_t g_nSink = 0;
+
+double Seconds(std::chrono::steady_clock::time_point tpStart) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+}
+
+// Nanoseconds per operator<< and per operator>> of nItems descriptions per message, nTotal descriptions in all, then
+// the same with message_writer and message_reader, field by field and as one length prefixed array. Returns whether
+// the reader read back, in order, what the writer wrote
+template<typename Description>
+bool BenchmarkMessage(Results &results, size_t nItems, size_t nTotal) {
+    size_t nMessages = std::max<size_t>(nTotal / nItems, 1);
+    std::vector<bsl::net::message<GameMsg>> vMessages(nMessages);
+    Description desc{};
+
+    auto tpStart = std::chrono::steady_clock::now();
+    for (auto &msg : vMessages) {
+        msg.header.id = GameMsg::Game_UpdatePlayer;
+        for (size_t i = 0; i < nItems; i++) msg << desc;
+    }
+    double fPush = Seconds(tpStart);
+
+    size_t nSum = 0;
+    tpStart = std::chrono::steady_clock::now();
+    for (auto &msg : vMessages) {
+        for (size_t i = 0; i < nItems; i++) {
+            msg >> desc;
+            nSum += reinterpret_cast<const uint8_t *>(&desc)[0];
+        }
+    }
+    double fPop = Seconds(tpStart);
+    g_nSink = nSum;
+
+    size_t nBytes = sizeof(Description) * nItems;
+    double fOperations = double(nMessages * nItems);
+    results.Add({"message <<", sPayload<Description>::sName, nItems, nBytes, 1, fPush / fOperations * 1e9, "ns/op"});
+    results.Add({"message >>", sPayload<Description>::sName, nItems, nBytes, 1, fPop / fOperations * 1e9, "ns/op"});
+
+    // Every description of a message is different, so reading them back out of order shows
+    std::vector<Description> vItems(nItems);
+    for (size_t i = 0; i < nItems; i++) vItems[i] = sPayload<Description>::Make(uint32_t(i + 1));
+
+    for (auto &msg : vMessages) msg.body.clear();
+    tpStart = std::chrono::steady_clock::now();
+    for (auto &msg : vMessages) {
+        bsl::net::message_writer<GameMsg> writer(msg, nBytes);
+        for (auto &item : vItems) writer.Write(item);
+    }
+    double fWrite = Seconds(tpStart);
+
+    bool bSame = true;
+    tpStart = std::chrono::steady_clock::now();
+    for (auto &msg : vMessages) {
+        bsl::net::message_reader<GameMsg> reader(msg);
+        for (size_t i = 0; i < nItems; i++) {
+            reader.Read(desc);
+            nSum += reinterpret_cast<const uint8_t *>(&desc)[0];
+        }
+        bSame &= reader.Good() && reader.Remaining() == 0;
+    }
+    double fRead = Seconds(tpStart);
+    bSame &= std::memcmp(vMessages.back().body.data(), vItems.data(), nBytes) == 0;
+
+    results.Add({"writer", sPayload<Description>::sName, nItems, nBytes, 1, fWrite / fOperations * 1e9, "ns/op"});
+    results.Add({"reader", sPayload<Description>::sName, nItems, nBytes, 1, fRead / fOperations * 1e9, "ns/op"});
+    if (nItems == 1) {
+        g_nSink = nSum;
+        return bSame;
+    }
+
+    for (auto &msg : vMessages) msg.body.clear();
+    tpStart = std::chrono::steady_clock::now();
+    for (auto &msg : vMessages) bsl::net::message_writer<GameMsg>(msg, sizeof(uint32_t) + nBytes).WriteArray(vItems);
+    double fWriteArray = Seconds(tpStart);
+
+    std::vector<Description> vRead;
+    tpStart = std::chrono::steady_clock::now();
+    for (auto &msg : vMessages) {
+        bsl::net::message_reader<GameMsg> reader(msg);
+        bSame &= reader.ReadArray(vRead, nItems);
+        nSum += reinterpret_cast<const uint8_t *>(vRead.data())[0];
+    }
+    double fReadArray = Seconds(tpStart);
+    bSame &= vRead.size() == nItems && std::memcmp(vRead.data(), vItems.data(), nBytes) == 0;
+    g_nSink = nSum;
+
+    results.Add({"writer array", sPayload<Description>::sName, nItems, nBytes, 1,
+                 fWriteArray / fOperations * 1e9, "ns/op"});
+    results.Add({"reader array", sPayload<Description>::sName, nItems, nBytes, 1,
+                 fReadArray / fOperations * 1e9, "ns/op"});
+    return bSame;
+}
+
+// Pop every message one at a time, as the client drains Incoming()
+size_t Consume(bsl::net::tsqueue<OwnedMsg> &queue, size_t nTotal) {
+    size_t nReceived = 0;
+    while (nReceived < nTotal) {
+        queue.wait();
+        while (!queue.empty()) {
+            auto msg = queue.pop_front();
+            nReceived++;
+        }
+    }
+    return nReceived;
+}
+
+// Drain in batches, as server_interface::Update does
+size_t Consume(bsl::net::mpscqueue<OwnedMsg> &queue, size_t nTotal) {
+    std::vector<OwnedMsg> vBatch;
+    size_t nReceived = 0;
+    while (nReceived < nTotal) {
+        queue.wait();
+        vBatch.clear();
+        nReceived += queue.drain(vBatch);
+    }
+    return nReceived;
+}
+
+// Millions of messages per second through a queue, from nProducers threads pushing copies of player updates to one
+// consumer
+template<typename Queue>
+void BenchmarkQueue(Results &results, const char *sName, size_t nItems, size_t nProducers, size_t nTotal) {
+    Queue queue;
+    OwnedMsg msgTemplate;
+    msgTemplate.msg.header.id = GameMsg::Game_UpdatePlayer;
+    for (size_t i = 0; i < nItems; i++) msgTemplate.msg << sPlayerDescription();
+
+    size_t nPerProducer = nTotal / nProducers;
+    std::atomic<bool> bGo{false};
+    std::vector<std::thread> vProducers;
+    for (size_t p = 0; p < nProducers; p++) {
+        vProducers.emplace_back([&]() {
+            while (!bGo.load()) std::this_thread::yield();
+            for (size_t i = 0; i < nPerProducer; i++) queue.push_back(msgTemplate);
+        });
+    }
+
+    auto tpStart = std::chrono::steady_clock::now();
+    bGo.store(true);
+    g_nSink = Consume(queue, nPerProducer * nProducers);
+    double fElapsed = Seconds(tpStart);
+    for (auto &thread : vProducers) thread.join();
+
+    results.Add({sName, "player", nItems, msgTemplate.msg.size(), nProducers + 1,
+                 double(nPerProducer * nProducers) / fElapsed / 1e6, "Mmsg/s"});
+}
+
+// Sends every message back to the connection it came from
+class EchoServer : public bsl::net::server_interface<GameMsg> {
+public:
+    EchoServer(uint16_t nPort) : bsl::net::server_interface<GameMsg>(nPort) {}
+
+protected:
+    void OnClientValidated(std::shared_ptr<bsl::net::connection<GameMsg>> client) override {
+        bsl::net::message<GameMsg> msg;
+        msg.header.id = GameMsg::Client_Accept;
+        client->Send(std::move(msg));
+    }
+
+    void OnMessage(std::shared_ptr<bsl::net::connection<GameMsg>> client, bsl::net::message<GameMsg> &msg) override {
+        MessageClient(client, std::move(msg));
+    }
+};
+
+class EchoClient : public bsl::net::client_interface<GameMsg> {
+public:
+    // Wait for the server to accept the connection
+    bool WaitForAccept() {
+        auto tpDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (Incoming().wait_until(tpDeadline)) {
+            if (Incoming().pop_front().msg.header.id == GameMsg::Client_Accept) return true;
+        }
+        return false;
+    }
+
+    // One message out and back, the round trip in microseconds or a negative time if it never came back
+    float RoundTrip(const bsl::net::message<GameMsg> &msg) {
+        auto tpStart = std::chrono::steady_clock::now();
+        Send(msg);
+        if (!Incoming().wait_until(tpStart + std::chrono::seconds(5))) return -1.0f;
+        Incoming().pop_front();
+        return std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - tpStart).count();
+    }
+};
+
+float Percentile(std::vector<float> &vSamples, float fPercent) {
+    if (vSamples.empty()) return 0.0f;
+    size_t n = std::min(vSamples.size() - 1, size_t(fPercent / 100.0f * float(vSamples.size())));
+    std::nth_element(vSamples.begin(), vSamples.begin() + n, vSamples.end());
+    return vSamples[n];
+}
+
+// Round trips of messages holding nItems player descriptions through the echo server, nClients clients each on its
+// own thread and connection, one message in flight per client
+void BenchmarkRoundTrip(Results &results, uint16_t nPort, size_t nItems, size_t nClients, float fSeconds) {
+    bsl::net::message<GameMsg> msg;
+    msg.header.id = GameMsg::Game_UpdatePlayer;
+    for (size_t i = 0; i < nItems; i++) msg << sPlayerDescription();
+
+    std::vector<std::vector<float>> vSamples(nClients);
+    std::atomic<size_t> nFailed{0};
+    std::vector<std::thread> vClients;
+    for (size_t c = 0; c < nClients; c++) {
+        vClients.emplace_back([&, c]() {
+            EchoClient client;
+            if (!client.Connect("127.0.0.1", nPort) || !client.WaitForAccept()) {
+                nFailed++;
+                return;
+            }
+            auto tpEnd = std::chrono::steady_clock::now() + std::chrono::duration<float>(fSeconds);
+            while (std::chrono::steady_clock::now() < tpEnd) {
+                float fTime = client.RoundTrip(msg);
+                if (fTime < 0.0f) {
+                    nFailed++;
+                    return;
+                }
+                vSamples[c].push_back(fTime);
+            }
+        });
+    }
+    for (auto &thread : vClients) thread.join();
+
+    std::vector<float> vAll;
+    for (auto &v : vSamples) vAll.insert(vAll.end(), v.begin(), v.end());
+    if (nFailed > 0) std::cerr << nFailed << " clients failed\n";
+
+    size_t nBytes = sizeof(bsl::net::message_header<GameMsg>) + msg.size();
+    results.Add({"roundtrip rate", "player", nItems, nBytes, nClients, double(vAll.size()) / fSeconds / 1e3,
+                 "Krt/s"});
+    results.Add({"roundtrip p50", "player", nItems, nBytes, nClients, Percentile(vAll, 50.0f), "us"});
+    results.Add({"roundtrip p99", "player", nItems, nBytes, nClients, Percentile(vAll, 99.0f), "us"});
+}
+
+int main(int argc, char *argv[]) {
+    // Options are given as "--name value" pairs
+    std::string sLabel = "current", sOut;
+    size_t nTotal = 1000000;
+    float fSeconds = 1.0f;
+    uint16_t nPort = 2697;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string sOption = argv[i];
+        if (sOption == "--label") sLabel = argv[i + 1];
+        if (sOption == "--out") sOut = argv[i + 1];
+        if (sOption == "--messages") nTotal = std::stoul(argv[i + 1]);
+        if (sOption == "--seconds") fSeconds = std::stof(argv[i + 1]);
+        if (sOption == "--port") nPort = uint16_t(std::stoul(argv[i + 1]));
+    }
+
+    // The server prints every connection, results go to their own stream on stdout and std::cout is silenced once
+    // the server starts
+    std::ostream out(std::cout.rdbuf());
+    Results results(out, sLabel, sOut);
+
+    bool bSame = true;
+    for (size_t nItems : {1, 16, 128}) {
+        bSame &= BenchmarkMessage<sPlayerDescription>(results, nItems, nTotal);
+        bSame &= BenchmarkMessage<sBulletDescription>(results, nItems, nTotal);
+        bSame &= BenchmarkMessage<sHitDescription>(results, nItems, nTotal);
+    }
+    out << "message_reader reads back what message_writer wrote: " << (bSame ? "yes" : "NO") << "\n";
+
+    for (size_t nItems : {1, 16}) {
+        for (size_t nProducers : {1, 2, 4, 8}) {
+            BenchmarkQueue<bsl::net::tsqueue<OwnedMsg>>(results, "tsqueue", nItems, nProducers, nTotal / 4);
+            BenchmarkQueue<bsl::net::mpscqueue<OwnedMsg>>(results, "mpscqueue", nItems, nProducers, nTotal / 4);
+        }
+    }
+
+    std::cout.rdbuf(nullptr);
+    EchoServer server(nPort);
+    if (!server.Start(2)) return 1;
+    std::atomic<bool> bRunning{true};
+    std::thread thrServer([&]() {
+        while (bRunning.load())
+            server.Update(-1, std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+    });
+
+    for (size_t nItems : {1, 16, 128})
+        for (size_t nClients : {1, 4, 16})
+            BenchmarkRoundTrip(results, nPort, nItems, nClients, fSeconds);
+
+    bRunning.store(false);
+    thrServer.join();
+    return bSame ? 0 : 1;
+}
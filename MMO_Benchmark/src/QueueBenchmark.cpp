@@ -0,0 +1,86 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "MMO_Common.h"
+
+// Compare the inbound queue of the server, the locked tsqueue against the lock free mpscqueue.
+// Producers play the role of connections pushing owned messages, the consumer plays server_interface::Update.
+
+using OwnedMsg = bsl::net::owned_message<GameMsg>;
+
+OwnedMsg MakeMessage(uint32_t nID) {
+    sPlayerDescription desc;
+    desc.nUniqueID = nID;
+    OwnedMsg msg;
+    msg.msg.header.id = GameMsg::Game_UpdatePlayer;
+    msg.msg << desc;
+    return msg;
+}
+
+// Consumer used by the old Update: check empty and pop one message at a time
+size_t Consume(bsl::net::tsqueue<OwnedMsg> &queue, size_t nTotal) {
+    size_t nReceived = 0;
+    while (nReceived < nTotal) {
+        queue.wait();
+        while (!queue.empty()) {
+            auto msg = queue.pop_front();
+            nReceived++;
+        }
+    }
+    return nReceived;
+}
+
+// Consumer used by the new Update: drain everything pending in one pass
+size_t Consume(bsl::net::mpscqueue<OwnedMsg> &queue, size_t nTotal) {
+    std::vector<OwnedMsg> vBatch;
+    size_t nReceived = 0;
+    while (nReceived < nTotal) {
+        queue.wait();
+        vBatch.clear();
+        nReceived += queue.drain(vBatch);
+    }
+    return nReceived;
+}
+
+template<typename Queue>
+double Run(size_t nProducers, size_t nTotal) {
+    Queue queue;
+    size_t nPerProducer = nTotal / nProducers;
+    OwnedMsg msgTemplate = MakeMessage(1);
+
+    std::atomic<bool> bGo{false};
+    std::vector<std::thread> vProducers;
+    for (size_t p = 0; p < nProducers; p++) {
+        vProducers.emplace_back([&]() {
+            while (!bGo.load()) std::this_thread::yield();
+            for (size_t i = 0; i < nPerProducer; i++) queue.push_back(msgTemplate);
+        });
+    }
+
+    auto tpStart = std::chrono::steady_clock::now();
+    bGo.store(true);
+    Consume(queue, nPerProducer * nProducers);
+    auto tpEnd = std::chrono::steady_clock::now();
+
+    for (auto &t : vProducers) t.join();
+    return std::chrono::duration<double>(tpEnd - tpStart).count();
+}
+
+int main(int argc, char *argv[]) {
+    size_t nTotal = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::cout << "messages per run: " << nTotal << "\n";
+    std::cout << std::left << std::setw(12) << "producers" << std::setw(20) << "tsqueue (Mmsg/s)"
+              << std::setw(20) << "mpscqueue (Mmsg/s)" << "speedup\n";
+
+    for (size_t nProducers : {1, 4, 16}) {
+        double fLocked = Run<bsl::net::tsqueue<OwnedMsg>>(nProducers, nTotal);
+        double fLockFree = Run<bsl::net::mpscqueue<OwnedMsg>>(nProducers, nTotal);
+        std::cout << std::left << std::setw(12) << nProducers
+                  << std::setw(20) << std::fixed << std::setprecision(2) << nTotal / fLocked / 1e6
+                  << std::setw(20) << nTotal / fLockFree / 1e6
+                  << fLocked / fLockFree << "x\n";
+    }
+    return 0;
+}
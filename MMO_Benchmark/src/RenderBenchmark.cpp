@@ -0,0 +1,144 @@
+#define OLC_IMAGE_STB
+#define OLC_PGE_APPLICATION
+
+#include "olcPixelGameEngine.h"
+
+#define OLC_PGEX_TRANSFORMEDVIEW
+
+#include "olcPGEX_TransformedView.h"
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <chrono>
+
+#include "MMO_MapFile.h"
+#include "MMO_CollisionMap.h"
+#include "MMO_TileLayer.h"
+
+// Drawing the walls of the map the way the client did, two rectangles for every wall tile in view, against copying
+// the cached chunks of MMO_TileLayer, at zoom levels from a few tiles to the whole map on screen. The engine is never
+// started, frames are drawn into a sprite, so the chunks are copied by the CPU rather than drawn as decals: the GPU
+// path costs less on the CPU, a quad per chunk. The view pans a few pixels every frame. Where the zoom is a power of
+// two the chunks are not scaled, and both must draw the same pixels.
+
+struct sMap {
+    std::string sTiles;
+    olc::vi2d vSize;
+};
+
+// Rooms of walls with doors in them, and pillars in between
+sMap MakeMap(int32_t nSize, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    sMap map;
+    map.vSize = {nSize, nSize};
+    map.sTiles.assign(size_t(nSize) * nSize, '.');
+    for (int32_t y = 0; y < nSize; y++) {
+        for (int32_t x = 0; x < nSize; x++) {
+            bool bBorder = x == 0 || y == 0 || x == nSize - 1 || y == nSize - 1;
+            bool bRoom = (x % 24 == 0 || y % 24 == 0) && x % 24 != 12 && y % 24 != 12;
+            if (bBorder || bRoom || rng() % 100 < 3) map.sTiles[size_t(y) * nSize + x] = '#';
+        }
+    }
+    return map;
+}
+
+void DrawTiles(olc::TileTransformedView &tv, const CollisionMap &map) {
+    olc::vi2d vTL = tv.GetTopLeftTile().max({0, 0});
+    olc::vi2d vBR = tv.GetBottomRightTile().min(map.Size());
+    olc::vi2d vTile;
+    for (vTile.y = vTL.y; vTile.y < vBR.y; vTile.y++) {
+        for (vTile.x = vTL.x; vTile.x < vBR.x; vTile.x++) {
+            if (map.IsSolid(vTile.x, vTile.y)) {
+                tv.DrawRect(vTile, {1.0f, 1.0f});
+                tv.DrawRect(olc::vf2d(vTile) + olc::vf2d(0.1f, 0.1f), {0.8f, 0.8f});
+            }
+        }
+    }
+}
+
+// Offset of the view for a frame, in whole pixels so the chunks of a power of two zoom land on the same pixels
+olc::vf2d FrameOffset(const olc::vf2d &vCenter, const olc::vi2d &vScreen, float fScale, int nFrame) {
+    olc::vf2d vOffset = vCenter - olc::vf2d(vScreen) / (2.0f * fScale);
+    olc::vf2d vPixels = (vOffset * fScale).floor() + olc::vf2d(3.0f, 2.0f) * float(nFrame);
+    return vPixels / fScale;
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point tpStart) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+}
+
+int main(int argc, char *argv[]) {
+    int32_t nSize = argc > 1 ? std::stoi(argv[1]) : 1024;
+    const olc::vi2d vScreen = {800, 600};
+    const int nFrames = 60;
+    const float vScales[] = {64.0f, 32.0f, 24.0f, 16.0f, 8.0f, 6.0f, 4.0f, 2.0f, 1.0f};
+
+    sMap generated = MakeMap(nSize, 42);
+    MapFile file;
+    file.FromText(generated.sTiles, generated.vSize);
+    CollisionMap map(std::move(file));
+    map.StreamAll();
+
+    // Never started, only to draw into sprites
+    olc::PixelGameEngine pge;
+    olc::Sprite sprTiles(vScreen.x, vScreen.y), sprChunks(vScreen.x, vScreen.y);
+    olc::TileTransformedView tv(vScreen, {32, 32});
+    TileLayer layer;
+    olc::vf2d vCenter = olc::vf2d(map.Size()) / 2.0f + olc::vf2d(0.37f, 0.61f);
+
+    std::cout << "map " << nSize << "x" << nSize << ", " << vScreen.x << "x" << vScreen.y << " screen, " << nFrames
+              << " frames per zoom, chunks of " << TileLayer::nChunkPixels << " pixels\n";
+    std::cout << std::left << std::setw(14) << "pixels/tile" << std::setw(16) << "tiles in view" << std::setw(18)
+              << "tile by tile (ms)" << std::setw(14) << "chunks (ms)" << std::setw(18) << "first frame (ms)"
+              << std::setw(10) << "speedup" << "chunks drawn\n";
+    std::cout << std::fixed << std::setprecision(3);
+
+    bool bSame = true;
+    for (float fScale : vScales) {
+        tv.SetWorldScale({fScale, fScale});
+
+        pge.SetDrawTarget(&sprTiles);
+        auto tpStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < nFrames; i++) {
+            tv.SetWorldOffset(FrameOffset(vCenter, vScreen, fScale, i));
+            pge.Clear(olc::BLACK);
+            DrawTiles(tv, map);
+        }
+        double fTiles = Milliseconds(tpStart) / nFrames;
+
+        // The first frame draws the chunks in view, the next ones mostly copy them
+        pge.SetDrawTarget(&sprChunks);
+        uint64_t nDrawnBefore = layer.ChunksDrawn();
+        tpStart = std::chrono::steady_clock::now();
+        tv.SetWorldOffset(FrameOffset(vCenter, vScreen, fScale, 0));
+        pge.Clear(olc::BLACK);
+        layer.Draw(pge, tv, map, false);
+        double fFirst = Milliseconds(tpStart);
+        tpStart = std::chrono::steady_clock::now();
+        for (int i = 1; i < nFrames; i++) {
+            tv.SetWorldOffset(FrameOffset(vCenter, vScreen, fScale, i));
+            pge.Clear(olc::BLACK);
+            layer.Draw(pge, tv, map, false);
+        }
+        double fChunks = Milliseconds(tpStart) / (nFrames - 1);
+
+        // Both sprites hold the last frame. The tile loop starts at the first tile in view, so it misses the edges of
+        // the walls just outside that fall on the first row and column, which the chunks draw
+        if (float(layer.TilePixels()) == fScale) {
+            for (int32_t y = 1; y < vScreen.y; y++)
+                for (int32_t x = 1; x < vScreen.x; x++)
+                    if (sprTiles.GetPixel(x, y) != sprChunks.GetPixel(x, y)) bSame = false;
+        }
+
+        olc::vi2d vTiles = tv.GetVisibleTiles();
+        std::cout << std::setw(14) << fScale << std::setw(16) << std::to_string(vTiles.x) + "x" + std::to_string(vTiles.y)
+                  << std::setw(18) << fTiles << std::setw(14) << fChunks << std::setw(18) << fFirst << std::setw(10)
+                  << fTiles / fChunks << layer.ChunksDrawn() - nDrawnBefore << "\n";
+    }
+
+    std::cout << "\nchunks draw the same pixels as tile by tile at power of two zooms: " << (bSame ? "yes" : "NO")
+              << "\n";
+    return bSame ? 0 : 1;
+}
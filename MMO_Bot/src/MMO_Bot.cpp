@@ -0,0 +1,419 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <unordered_set>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "MMO_Common.h"
+#include "MMO_StateCodec.h"
+
+// Headless load generator. Simulated players connect to a server, go through the handshake and registration like
+// MMOGame, then walk around sending player updates, firing bullets and pinging the server at fixed rates. All the
+// bots share a few network threads and are driven from one loop, so thousands fit in one process.
+// The number of bots is stepped up, every step reports throughput, ping latency and, given its pid on Linux, the
+// CPU time of the server:
+//     MMO_Bot --bots 10,100,500,1000,2000 --seconds 10 --server-pid $(pidof MMO_Server)
+// The new bots of a step connect all at once, like clients reconnecting after a restart, and how long it takes until
+// they joined and every bot knows every player is reported too. Against a fresh server, one step is such a storm:
+//     MMO_Bot --bots 1000 --seconds 5 --server-pid $(pidof MMO_Server)
+
+struct sBotOptions {
+    std::string sHost = "127.0.0.1";
+    uint16_t nPort = 2696;
+    std::vector<size_t> vBotSteps = {10, 100, 500, 1000, 2000};
+    float fSeconds = 10.0f;
+    // Messages per second per bot
+    float fUpdateRate = 20.0f;
+    float fFireRate = 2.0f;
+    float fPingRate = 1.0f;
+    // Bots walk around in a square of this many tiles
+    float fArea = 64.0f;
+    // Bots drift back and forth across the area at this many tiles per second, crossing the zones of a sharded
+    // server, 0 keeps them where they start
+    float fRoam = 0.0f;
+    size_t nIOThreads = 2;
+    bool bDatagrams = false;
+    int nServerPID = 0;
+};
+
+// What the bots did during a step, counted from the driving loop
+struct sBotStats {
+    uint64_t nUpdatesSent = 0;
+    uint64_t nBulletsSent = 0;
+    uint64_t nMessagesIn = 0;
+    uint64_t nBytesIn = 0;
+    // Players added and removed, part of the messages in
+    uint64_t nPresenceIn = 0;
+    uint64_t nPresenceBytesIn = 0;
+    // Round trip of Server_GetPing, in milliseconds
+    std::vector<float> vPings;
+};
+
+class Bot : public bsl::net::client_interface<GameMsg> {
+public:
+    Bot(asio::io_context &context, const sBotOptions &options, uint32_t nSeed)
+            : bsl::net::client_interface<GameMsg>(context), m_options(options), m_rng(nSeed) {
+        std::uniform_real_distribution<float> pos(2.0f, options.fArea - 2.0f), phase(0.0f, 1.0f);
+        m_vCenter = {pos(m_rng), pos(m_rng)};
+        // Spread the messages of the bots over the period instead of sending them all at once
+        auto tpNow = std::chrono::steady_clock::now();
+        m_tpStart = tpNow;
+        m_fRoamStart = m_vCenter.x - 2.0f;
+        m_tpUpdate = tpNow + Period(options.fUpdateRate, phase(m_rng));
+        m_tpFire = tpNow + Period(options.fFireRate, phase(m_rng));
+        m_tpPing = tpNow + Period(options.fPingRate, phase(m_rng));
+    }
+
+    bool IsRegistered() const {
+        return m_nPlayerID != 0;
+    }
+
+    // The server added our own player, the bot is in the game
+    bool HasJoined() const {
+        return IsRegistered() && m_setKnown.count(m_nPlayerID) > 0;
+    }
+
+    // Players the server told this bot about, itself included
+    size_t KnownPlayers() const {
+        return m_setKnown.size();
+    }
+
+    // Handle the messages received and send what is due
+    void Step(std::chrono::steady_clock::time_point tpNow, sBotStats &stats) {
+        while (!Incoming().empty()) {
+            auto msg = Incoming().pop_front().msg;
+            stats.nMessagesIn++;
+            stats.nBytesIn += msg.size();
+            if (IsPresence(msg.header.id)) {
+                stats.nPresenceIn++;
+                stats.nPresenceBytesIn += msg.size();
+            }
+
+            switch (msg.header.id) {
+                case GameMsg::Client_Accept: {
+                    bsl::net::message<GameMsg> msgRegister;
+                    msgRegister.header.id = GameMsg::Client_RegisterWithServer;
+                    m_descPlayer.vPos = m_vCenter;
+                    msgRegister << m_descPlayer;
+                    m_descSent = m_descPlayer;
+                    Send(std::move(msgRegister));
+                    break;
+                }
+                case GameMsg::Client_AssignID: {
+                    msg >> m_nPlayerID;
+                    m_descPlayer.nUniqueID = m_nPlayerID;
+                    break;
+                }
+                case GameMsg::Game_AddPlayer: {
+                    sPlayerDescription desc;
+                    msg >> desc;
+                    m_setKnown.insert(desc.nUniqueID);
+                    break;
+                }
+                case GameMsg::Game_RemovePlayer: {
+                    uint32_t nID = 0;
+                    msg >> nID;
+                    m_setKnown.erase(nID);
+                    break;
+                }
+                case GameMsg::Game_AddPlayers: {
+                    std::vector<sPlayerDescription> vPlayers;
+                    bsl::net::message_reader<GameMsg>(msg).ReadArray(vPlayers, nMaxPresencePerMessage);
+                    for (const auto &desc : vPlayers) m_setKnown.insert(desc.nUniqueID);
+                    break;
+                }
+                case GameMsg::Game_RemovePlayers: {
+                    std::vector<uint32_t> vIDs;
+                    bsl::net::message_reader<GameMsg>(msg).ReadArray(vIDs, nMaxPresencePerMessage);
+                    for (uint32_t nID : vIDs) m_setKnown.erase(nID);
+                    break;
+                }
+                case GameMsg::Server_GetPing: {
+                    std::chrono::steady_clock::time_point tpThen;
+                    msg >> tpThen;
+                    stats.vPings.push_back(std::chrono::duration<float, std::milli>(tpNow - tpThen).count());
+                    break;
+                }
+                case GameMsg::Game_Dead: {
+                    // Back at once, the server takes the bot for alive again once it counted the death
+                    sDeadDescription desc;
+                    msg >> desc;
+                    if (desc.nSuffererID == m_nPlayerID) m_descPlayer.nDeaths++;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        if (!IsRegistered()) return;
+
+        if (Due(tpNow, m_tpUpdate, m_options.fUpdateRate)) {
+            SendUpdate(tpNow);
+            stats.nUpdatesSent++;
+        }
+        if (Due(tpNow, m_tpFire, m_options.fFireRate)) {
+            Fire();
+            stats.nBulletsSent++;
+        }
+        if (Due(tpNow, m_tpPing, m_options.fPingRate)) {
+            bsl::net::message<GameMsg> msg;
+            msg.header.id = GameMsg::Server_GetPing;
+            msg << tpNow;
+            Send(std::move(msg));
+        }
+    }
+
+private:
+    static bool IsPresence(GameMsg id) {
+        return id == GameMsg::Game_AddPlayer || id == GameMsg::Game_RemovePlayer || id == GameMsg::Game_AddPlayers ||
+               id == GameMsg::Game_RemovePlayers;
+    }
+
+    // Time between the messages of a stream, or a fraction of it
+    static std::chrono::steady_clock::duration Period(float fRate, float fFraction = 1.0f) {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>((fRate > 0.0f ? 1.0 / fRate : 1.0) * fFraction));
+    }
+
+    // True if the next message of a stream is due, a bot that fell behind skips the missed ones instead of bursting
+    static bool Due(std::chrono::steady_clock::time_point tpNow, std::chrono::steady_clock::time_point &tpNext,
+                    float fRate) {
+        if (fRate <= 0.0f || tpNow < tpNext) return false;
+        tpNext += Period(fRate);
+        if (tpNext < tpNow) tpNext = tpNow + Period(fRate);
+        return true;
+    }
+
+    // Walk a circle around the starting point, sent like MMOGame sends its player
+    void SendUpdate(std::chrono::steady_clock::time_point tpNow) {
+        float fTime = std::chrono::duration<float>(tpNow.time_since_epoch()).count();
+        float fAngle = fTime * 0.5f + float(m_nPlayerID);
+        if (m_options.fRoam > 0.0f) {
+            float fSpan = m_options.fArea - 4.0f;
+            float fTravel = std::fmod(m_fRoamStart + m_options.fRoam *
+                                                     std::chrono::duration<float>(tpNow - m_tpStart).count(),
+                                      2.0f * fSpan);
+            m_vCenter.x = 2.0f + (fTravel < fSpan ? fTravel : 2.0f * fSpan - fTravel);
+        }
+        olc::vf2d vDir = {std::cos(fAngle), std::sin(fAngle)};
+        m_descPlayer.vPos = m_vCenter + vDir * 1.5f;
+        m_descPlayer.vVel = olc::vf2d(-vDir.y, vDir.x) * 0.75f;
+        m_descPlayer.nSequence++;
+        m_descPlayer.nTime = uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(tpNow - m_tpStart).count());
+
+        bsl::net::message<GameMsg> msg;
+        msg.header.id = GameMsg::Game_UpdatePlayer;
+        if (IsDatagramBound()) {
+            m_codec.EncodeKeyframe(m_descPlayer, msg.body);
+            msg.header.size = uint32_t(msg.size());
+            SendUnreliable(std::move(msg));
+        } else {
+            m_codec.Encode(m_descPlayer, m_descSent, msg.body);
+            msg.header.size = uint32_t(msg.size());
+            Send(std::move(msg));
+        }
+    }
+
+    void Fire() {
+        std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+        float a = angle(m_rng);
+        sBulletDescription bullet = {m_nPlayerID, 5, 2, 1, 0.2f,
+                                     olc::Pixel(255, 0, 0),
+                                     m_descPlayer.vPos,
+                                     olc::vf2d(std::cos(a), std::sin(a)) * 20.0f};
+        bsl::net::message<GameMsg> msg;
+        msg.header.id = GameMsg::Game_FireBullet;
+        msg << bullet;
+        Send(std::move(msg));
+    }
+
+    const sBotOptions &m_options;
+    std::mt19937 m_rng;
+    olc::vf2d m_vCenter;
+    std::chrono::steady_clock::time_point m_tpStart;
+    float m_fRoamStart = 0.0f;
+
+    uint32_t m_nPlayerID = 0;
+    std::unordered_set<uint32_t> m_setKnown;
+    sPlayerDescription m_descPlayer;
+    PlayerStateCodec m_codec;
+    sPlayerDescription m_descSent;
+
+    std::chrono::steady_clock::time_point m_tpUpdate;
+    std::chrono::steady_clock::time_point m_tpFire;
+    std::chrono::steady_clock::time_point m_tpPing;
+};
+
+// CPU time used by a process so far in seconds, from /proc, negative where it can't be read
+double ProcessCPUSeconds(int nPID) {
+#if defined(__linux__)
+    if (nPID <= 0) return -1.0;
+    std::ifstream file("/proc/" + std::to_string(nPID) + "/stat");
+    std::string sStat;
+    if (!std::getline(file, sStat)) return -1.0;
+    // The fields after the command name, which can hold spaces, utime and stime are the 12th and 13th
+    std::istringstream fields(sStat.substr(sStat.rfind(')') + 2));
+    std::string sField;
+    double fUser = 0.0, fSystem = 0.0;
+    for (int i = 0; i < 13 && fields >> sField; i++) {
+        if (i == 11) fUser = std::stod(sField);
+        if (i == 12) fSystem = std::stod(sField);
+    }
+    return (fUser + fSystem) / double(sysconf(_SC_CLK_TCK));
+#else
+    return -1.0;
+#endif
+}
+
+float Percentile(std::vector<float> &vSamples, float fPercent) {
+    if (vSamples.empty()) return 0.0f;
+    size_t n = std::min(vSamples.size() - 1, size_t(fPercent / 100.0f * float(vSamples.size())));
+    std::nth_element(vSamples.begin(), vSamples.begin() + n, vSamples.end());
+    return vSamples[n];
+}
+
+// Comma separated list of bot counts
+std::vector<size_t> ParseSteps(const std::string &sSteps) {
+    std::vector<size_t> vSteps;
+    std::istringstream list(sSteps);
+    std::string sStep;
+    while (std::getline(list, sStep, ',')) vSteps.push_back(std::stoul(sStep));
+    std::sort(vSteps.begin(), vSteps.end());
+    return vSteps;
+}
+
+int main(int argc, char *argv[]) {
+    // Options are given as "--name value" pairs
+    sBotOptions options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string sOption = argv[i];
+        if (sOption == "--host") options.sHost = argv[i + 1];
+        if (sOption == "--port") options.nPort = uint16_t(std::stoul(argv[i + 1]));
+        if (sOption == "--bots") options.vBotSteps = ParseSteps(argv[i + 1]);
+        if (sOption == "--seconds") options.fSeconds = std::stof(argv[i + 1]);
+        if (sOption == "--update-rate") options.fUpdateRate = std::stof(argv[i + 1]);
+        if (sOption == "--fire-rate") options.fFireRate = std::stof(argv[i + 1]);
+        if (sOption == "--ping-rate") options.fPingRate = std::stof(argv[i + 1]);
+        if (sOption == "--area") options.fArea = std::stof(argv[i + 1]);
+        if (sOption == "--roam") options.fRoam = std::stof(argv[i + 1]);
+        if (sOption == "--io-threads") options.nIOThreads = std::stoul(argv[i + 1]);
+        if (sOption == "--udp") options.bDatagrams = std::stoi(argv[i + 1]) != 0;
+        if (sOption == "--server-pid") options.nServerPID = std::stoi(argv[i + 1]);
+    }
+
+    // Network threads shared by every bot, kept running while bots come and go
+    asio::io_context context;
+    auto work = asio::make_work_guard(context);
+    std::vector<std::thread> vThreads;
+    for (size_t i = 0; i < std::max<size_t>(options.nIOThreads, 1); i++)
+        vThreads.emplace_back([&context]() { context.run(); });
+
+    std::cout << "bots against " << options.sHost << ":" << options.nPort << ", per bot " << options.fUpdateRate
+              << " updates/s " << options.fFireRate << " bullets/s " << options.fPingRate << " pings/s, "
+              << options.fSeconds << "s per step\n";
+    std::cout << std::left << std::setw(8) << "bots" << std::setw(12) << "registered" << std::setw(14) << "updates/s"
+              << std::setw(14) << "bullets/s" << std::setw(14) << "msgs in/s" << std::setw(12) << "KB in/s"
+              << std::setw(12) << "ping p50" << std::setw(12) << "ping p99" << "server CPU\n";
+
+    std::vector<std::unique_ptr<Bot>> vBots;
+    sBotStats stats;
+    // Replies are only seen once per frame, which bounds the ping resolution
+    const auto tpFrame = std::chrono::milliseconds(1);
+    // Step the bots for tpDuration, or until bUntil returns true after a frame
+    auto RunUntil = [&](std::chrono::steady_clock::duration tpDuration, auto &&bUntil) {
+        auto tpEnd = std::chrono::steady_clock::now() + tpDuration;
+        while (std::chrono::steady_clock::now() < tpEnd) {
+            auto tpNow = std::chrono::steady_clock::now();
+            for (auto &bot : vBots) bot->Step(tpNow, stats);
+            if (bUntil()) return;
+            std::this_thread::sleep_until(tpNow + tpFrame);
+        }
+    };
+    auto RunFor = [&](std::chrono::steady_clock::duration tpDuration) {
+        RunUntil(tpDuration, []() { return false; });
+    };
+    auto MillisecondsSince = [](std::chrono::steady_clock::time_point tpStart) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+    };
+
+    bool bConnected = true;
+    for (size_t nBots : options.vBotSteps) {
+        // The new bots connect at once. Measured until every bot joined, then until every bot knows every player,
+        // which with an area of interest on the server never happens and stops at the time limit
+        stats = sBotStats();
+        double fStormServerStart = ProcessCPUSeconds(options.nServerPID);
+        auto tpStorm = std::chrono::steady_clock::now();
+        while (vBots.size() < nBots && bConnected) {
+            vBots.push_back(std::make_unique<Bot>(context, options, uint32_t(vBots.size() + 1)));
+            if (options.bDatagrams) vBots.back()->EnableDatagrams();
+            bConnected = vBots.back()->Connect(options.sHost, options.nPort);
+        }
+        size_t nJoined = 0, nComplete = 0;
+        RunUntil(std::chrono::seconds(10), [&]() {
+            nJoined = size_t(std::count_if(vBots.begin(), vBots.end(),
+                                           [](const std::unique_ptr<Bot> &bot) { return bot->HasJoined(); }));
+            return nJoined == vBots.size();
+        });
+        double fJoined = MillisecondsSince(tpStorm);
+        RunUntil(std::chrono::seconds(10), [&]() {
+            nComplete = size_t(std::count_if(vBots.begin(), vBots.end(), [&](const std::unique_ptr<Bot> &bot) {
+                return bot->KnownPlayers() == vBots.size();
+            }));
+            return nComplete == vBots.size();
+        });
+        double fComplete = MillisecondsSince(tpStorm);
+        double fStormServerEnd = ProcessCPUSeconds(options.nServerPID);
+        sBotStats storm = stats;
+
+        // Let the bots settle, then measure
+        RunFor(std::chrono::seconds(1));
+        size_t nRegistered = size_t(std::count_if(vBots.begin(), vBots.end(),
+                                                  [](const std::unique_ptr<Bot> &bot) { return bot->IsRegistered(); }));
+
+        stats = sBotStats();
+        double fServerStart = ProcessCPUSeconds(options.nServerPID);
+        auto tpStart = std::chrono::steady_clock::now();
+        RunFor(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<float>(options.fSeconds)));
+        double fElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+        double fServerEnd = ProcessCPUSeconds(options.nServerPID);
+
+        std::cout << std::left << std::fixed << std::setprecision(1) << std::setw(8) << vBots.size()
+                  << std::setw(12) << nRegistered
+                  << std::setw(14) << stats.nUpdatesSent / fElapsed << std::setw(14) << stats.nBulletsSent / fElapsed
+                  << std::setw(14) << stats.nMessagesIn / fElapsed
+                  << std::setw(12) << stats.nBytesIn / 1024.0 / fElapsed
+                  << std::setprecision(2) << std::setw(12) << Percentile(stats.vPings, 50.0f)
+                  << std::setw(12) << Percentile(stats.vPings, 99.0f);
+        if (fServerStart >= 0.0 && fServerEnd >= 0.0)
+            std::cout << std::setprecision(1) << 100.0 * (fServerEnd - fServerStart) / fElapsed << "%\n";
+        else
+            std::cout << "-\n";
+
+        std::cout << std::setprecision(1) << "        connect storm: " << nJoined << " joined in " << fJoined << "ms, ";
+        if (nComplete == vBots.size())
+            std::cout << "all know all " << vBots.size() << " players in " << fComplete << "ms";
+        else
+            std::cout << nComplete << " know all " << vBots.size() << " players";
+        std::cout << ", presence " << storm.nPresenceIn << " messages / " << storm.nPresenceBytesIn / 1024.0
+                  << "KB of " << storm.nMessagesIn << " in";
+        if (fStormServerStart >= 0.0 && fStormServerEnd >= 0.0)
+            std::cout << ", server CPU " << std::setprecision(2) << fStormServerEnd - fStormServerStart << "s";
+        std::cout << "\n";
+        if (!bConnected || nRegistered < vBots.size()) break;
+    }
+
+    // The bots' connections live on the shared context, stop it before they go
+    work.reset();
+    context.stop();
+    for (auto &thread : vThreads) thread.join();
+    vBots.clear();
+    return 0;
+}
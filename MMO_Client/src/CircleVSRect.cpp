@@ -5,6 +5,8 @@
 #define OLC_PGEX_TRANSFORMEDVIEW
 #include "olcPGEX_TransformedView.h"
 
+#include "MMO_CollisionMap.h"
+
 class CircleVSRect : public olc::PixelGameEngine {
 public:
     CircleVSRect() { sAppName = "Circle Vs Rectangle"; }
@@ -24,6 +26,7 @@ private:
     // '#' means block, '.' means space player can move
     std::string sWorldMap;
     olc::vi2d vWorldSize = {0, 0};
+    CollisionMap mapCollision;
 
     // Flag means follow player or not
     bool bFollowObject = false;
@@ -38,6 +41,7 @@ private:
             vWorldSize.y++;
         }
         vWorldSize.x = line.length();
+        mapCollision.Build(sWorldMap, vWorldSize);
 
         std::cout << "Map " << path << " loaded\nSize: (" << vWorldSize.x << "," << vWorldSize.y << ")\n";
     }
@@ -71,43 +75,16 @@ public:
         // Press Space key to toggle Follow mode
         if (GetKey(olc::Key::SPACE).bReleased) bFollowObject = !bFollowObject;
 
-        // Caculate the new positon of the player
+        // Caculate the new positon of the player, sweeping it along its move and sliding along the walls
         // Because the frame rate is different, so we need to use elapsed time to get approximate speed
-        olc::vf2d vPotentialPosition = object.vPos + object.vVel * fElapsedTime;
+        olc::vf2d vDelta = object.vVel * fElapsedTime;
 
         // Get the region of world cells that may have collision
-        olc::vi2d vCurrentCell = object.vPos.floor();
-        olc::vi2d vTargetCell = vPotentialPosition;
-        // TopLeft
-        olc::vi2d vAreaTL = (vCurrentCell.min(vTargetCell) - olc::vi2d(1, 1)).max({0, 0});
-        // BottomRight
-        olc::vi2d vAreaBR = (vCurrentCell.min(vTargetCell) + olc::vi2d(1, 1)).min(vWorldSize);
-
-        olc::vf2d vRayToNearest;
-
-        // Iterate through each cell in collision test area
-        olc::vi2d vCell;
-        for (vCell.y = vAreaTL.y; vCell.y <= vAreaBR.y; vCell.y++) {
-            for (vCell.x = vAreaTL.x; vCell.x <= vAreaBR.x; vCell.x++) {
-                // Check the cell is solid or not
-                if (sWorldMap[vCell.y * vWorldSize.x + vCell.x] == '#') {
-                    olc::vf2d vNearestPoint;
-                    vNearestPoint.x = std::max(float(vCell.x), std::min(vPotentialPosition.x, float(vCell.x + 1)));
-                    vNearestPoint.y = std::max(float(vCell.y), std::min(vPotentialPosition.y, float(vCell.y + 1)));
-
-                    vRayToNearest = vNearestPoint - vPotentialPosition;
-                    float fOverlap = object.fRadius - vRayToNearest.mag();
-                    if (std::isnan(fOverlap)) fOverlap = 0;
-
-                    if (fOverlap > 0) {
-                        vPotentialPosition = vPotentialPosition - vRayToNearest.norm() * fOverlap;
-                    }
-                }
-            }
-        }
+        olc::vi2d vAreaTL = (object.vPos.min(object.vPos + vDelta) - olc::vf2d(object.fRadius, object.fRadius)).floor();
+        olc::vi2d vAreaBR = (object.vPos.max(object.vPos + vDelta) + olc::vf2d(object.fRadius, object.fRadius)).floor();
 
         // Set the object new position
-        object.vPos = vPotentialPosition;
+        object.vPos = mapCollision.Move(object.vPos, vDelta, object.fRadius);
 
         // Clear World, do it before draw any component
         Clear(olc::VERY_DARK_BLUE);
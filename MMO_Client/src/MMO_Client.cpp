@@ -9,9 +9,14 @@
 
 // Must include after game engine
 #include "MMO_Common.h"
+#include "MMO_StateCodec.h"
+#include "MMO_SpatialHash.h"
+#include "MMO_CollisionMap.h"
+#include "MMO_BulletPool.h"
+#include "MMO_TileLayer.h"
+#include "MMO_SnapshotBuffer.h"
 
 #include <unordered_map>
-#include <fstream>
 #include "magic_enum.hpp"
 
 enum class ShootDirection : uint8_t {
@@ -23,16 +28,22 @@ enum class ShootDirection : uint8_t {
 
 class MMOGame : public olc::PixelGameEngine, bsl::net::client_interface<GameMsg> {
 public:
-    MMOGame() {
+    // Our player is sent fSendRate times per second, every frame with 0. Remote players are drawn fInterpDelay
+    // seconds in the past, between the states received for them
+    explicit MMOGame(float fSendRate = 20.0f, float fInterpDelay = 0.1f)
+            : fSendRate(fSendRate), fInterpDelay(fInterpDelay) {
         sAppName = "MMO Client";
     }
 
 private:
     olc::TileTransformedView tv;
 
-    std::string sWorldMap;
+    // Solid tiles of the map for players and bullets, with the chunks around the players streamed in
+    CollisionMap mapCollision;
+    std::vector<olc::vf2d> vStreamCenters;
 
-    olc::vi2d vWorldSize = {0, 0};
+    // Walls of the map drawn into cached chunks, see MMO_TileLayer
+    TileLayer layerTiles;
 
 private:
     // Map contains player information
@@ -40,8 +51,29 @@ private:
     uint32_t nPlayerID = 0;
     sPlayerDescription descPlayer;
 
-    // List contain all the bullets
-    std::list<sBulletDescription> listBullets;
+    // Player states travel delta encoded, each side keeps the last state sent or received as the baseline
+    PlayerStateCodec codec;
+    sPlayerDescription descSent;
+    std::unordered_map<uint32_t, sPlayerDescription> mapReceived;
+
+    // Our player's states are sent at a fixed rate, stamped with a sequence number and the time since we started
+    float fSendRate = 20.0f;
+    float fSendTime = 0.0f;
+    std::chrono::steady_clock::time_point tpStart = std::chrono::steady_clock::now();
+
+    // Recent states of every remote player, sampled each frame to place it. Past its newest state a player keeps
+    // going for at most fMaxExtrapolation seconds
+    std::unordered_map<uint32_t, SnapshotBuffer> mapSnapshots;
+    float fInterpDelay = 0.1f;
+    float fMaxExtrapolation = 0.25f;
+
+    // All the bullets in flight
+    BulletPool poolBullets;
+
+    // Broadphase for player and bullet collisions, rebuilt from the player positions every frame. Queries are padded
+    // by the largest radius and by how far players move during the frame, as positions change while the grid is used
+    SpatialHash gridObjects{2.0f};
+    float fObjectReach = 0.0f;
 
     bool bWaitingForConnection = true;
 
@@ -54,6 +86,7 @@ private:
     // Get status 5 per second
     float fStatusTime = 0.0f;
     ServerStatus serverStatus = ServerStatus::IDLE;
+    sServerMetrics serverMetrics;
 
     // Time for ROF(rate of fire)
     float fROFTime = 0.0f;
@@ -75,7 +108,10 @@ private:
                     // When Server back the status message
                     case (GameMsg::Server_GetStatus): {
                         fStatusTime = 0;
-                        msg >> serverStatus;
+                        bsl::net::message_reader<GameMsg> reader(msg);
+                        reader.Read(serverStatus);
+                        // Servers that measure their load send it along
+                        if (reader.Remaining() >= sizeof(sServerMetrics)) reader.Read(serverMetrics);
                         break;
                     }
 
@@ -96,6 +132,7 @@ private:
                         msg.header.id = GameMsg::Client_RegisterWithServer;
                         descPlayer.vPos = {3.0f, 3.0f};
                         msg << descPlayer;
+                        descSent = descPlayer;
                         Send(msg);
                         break;
                     }
@@ -109,58 +146,74 @@ private:
                     case (GameMsg::Game_AddPlayer): {
                         sPlayerDescription desc;
                         msg >> desc;
-                        mapObjects.insert_or_assign(desc.nUniqueID, desc);
-
-                        if (desc.nUniqueID == nPlayerID) {
-                            // Successfully add our own player to the game world
-                            bWaitingForConnection = false;
-                        }
+                        AddPlayer(desc);
                         break;
                     }
                         // When Server remove player
                     case (GameMsg::Game_RemovePlayer): {
                         uint32_t nRemovalID = 0;
                         msg >> nRemovalID;
-                        mapObjects.erase(nRemovalID);
+                        RemovePlayer(nRemovalID);
+                        break;
+                    }
+
+                        // When Server adds or removes players in bulk, the whole roster when we join
+                    case (GameMsg::Game_AddPlayers): {
+                        std::vector<sPlayerDescription> vPlayers;
+                        bsl::net::message_reader<GameMsg>(msg).ReadArray(vPlayers, nMaxPresencePerMessage);
+                        for (const auto &desc : vPlayers) AddPlayer(desc);
+                        break;
+                    }
+                    case (GameMsg::Game_RemovePlayers): {
+                        std::vector<uint32_t> vRemovalIDs;
+                        bsl::net::message_reader<GameMsg>(msg).ReadArray(vRemovalIDs, nMaxPresencePerMessage);
+                        for (uint32_t nRemovalID : vRemovalIDs) RemovePlayer(nRemovalID);
                         break;
                     }
                         // When Server update player information
                     case (GameMsg::Game_UpdatePlayer): {
-                        sPlayerDescription desc;
-                        msg >> desc;
-                        mapObjects.insert_or_assign(desc.nUniqueID, desc);
+                        const uint8_t *p = msg.body.data();
+                        ReceiveState(p, p + msg.body.size());
+                        break;
+                    }
+
+                        // When Server publish the players updated during its tick
+                    case (GameMsg::Game_Snapshot): {
+                        uint32_t nPlayers = 0;
+                        msg >> nPlayers;
+                        const uint8_t *p = msg.body.data();
+                        const uint8_t *pEnd = p + msg.body.size();
+                        for (uint32_t i = 0; i < nPlayers; i++) {
+                            if (!ReceiveState(p, pEnd)) break;
+                        }
                         break;
                     }
 
                     case (GameMsg::Game_FireBullet): {
                         sBulletDescription bullet;
                         msg >> bullet;
-                        listBullets.push_back(bullet);
+                        poolBullets.Add(bullet);
                         break;
                     }
 
+                    // Hits and deaths are decided by the server, which simulates the bullets too
                     case (GameMsg::Game_HitPlayer): {
                         sHitDescription desc;
                         msg >> desc;
-                        if (desc.nSuffererID == nPlayerID) {
-                            if (desc.nDamage >= mapObjects[nPlayerID].nHealth) {
-                                mapObjects[nPlayerID].nHealth = 0;
-                                mapObjects[nPlayerID].status = PlayerStatus::Dead;
-                                mapObjects[nPlayerID].vPos = {-3.0f, -3.0f};
-                                mapObjects[nPlayerID].nDeaths++;
-                                sDeadDescription d = {desc.nShooterID, desc.nSuffererID};
-                                bsl::net::message<GameMsg> m;
-                                m.header.id = GameMsg::Game_Dead;
-                                m << d;
-                                Send(m);
-                            } else mapObjects[nPlayerID].nHealth -= desc.nDamage;
-                        }
+                        if (desc.nSuffererID == nPlayerID)
+                            mapObjects[nPlayerID].nHealth -= std::min(desc.nDamage, mapObjects[nPlayerID].nHealth);
                         break;
                     }
 
                     case (GameMsg::Game_Dead): {
                         sDeadDescription desc;
                         msg >> desc;
+                        if (desc.nSuffererID == nPlayerID && mapObjects[nPlayerID].status != PlayerStatus::Dead) {
+                            mapObjects[nPlayerID].nHealth = 0;
+                            mapObjects[nPlayerID].status = PlayerStatus::Dead;
+                            mapObjects[nPlayerID].vPos = {-3.0f, -3.0f};
+                            mapObjects[nPlayerID].nDeaths++;
+                        }
                         if (desc.nKillerID == nPlayerID) {
                             mapObjects[nPlayerID].nKills++;
                         }
@@ -172,10 +225,63 @@ private:
         // When connecting to server, display blank blue
     }
 
+    // Decode one player state against the last one received for that player
+    // Keyframes arrive by datagram, possibly after the player was removed, and don't touch the baseline
+    bool ReceiveState(const uint8_t *&p, const uint8_t *pEnd) {
+        uint32_t id = 0;
+        bool bKeyframe = false;
+        if (!PlayerStateCodec::Peek(p, pEnd, id, bKeyframe)) return false;
+        auto baseline = mapReceived.find(id);
+        if (bKeyframe) {
+            sPlayerDescription keyframe;
+            if (!codec.Decode(p, pEnd, keyframe)) return false;
+            if (baseline != mapReceived.end() && id != nPlayerID) ReceiveRemote(keyframe);
+            return true;
+        }
+
+        auto &received = baseline != mapReceived.end() ? baseline->second : mapReceived[id];
+        if (!codec.Decode(p, pEnd, received)) return false;
+        // Our own player is simulated locally
+        if (id != nPlayerID) ReceiveRemote(received);
+        return true;
+    }
+
+    // The full description of a player, the baseline of its later updates
+    void AddPlayer(const sPlayerDescription &desc) {
+        mapObjects.insert_or_assign(desc.nUniqueID, desc);
+        mapReceived.insert_or_assign(desc.nUniqueID, desc);
+        mapSnapshots[desc.nUniqueID].Clear();
+        if (desc.nUniqueID != nPlayerID) mapSnapshots[desc.nUniqueID].Push(desc, Now());
+
+        if (desc.nUniqueID == nPlayerID) {
+            // Successfully add our own player to the game world
+            bWaitingForConnection = false;
+        }
+    }
+
+    void RemovePlayer(uint32_t nRemovalID) {
+        mapObjects.erase(nRemovalID);
+        mapReceived.erase(nRemovalID);
+        mapSnapshots.erase(nRemovalID);
+    }
+
+    // Keep a state of a remote player for the frames to come, a player seen for the first time shows at once
+    void ReceiveRemote(const sPlayerDescription &state) {
+        mapSnapshots[state.nUniqueID].Push(state, Now());
+        if (mapObjects.count(state.nUniqueID) == 0) mapObjects.insert_or_assign(state.nUniqueID, state);
+    }
+
+    // Seconds since the client started
+    double Now() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+    }
+
     void DisplayHUD() {
 
         // Display Server status
-        DrawString({10, 10}, "Server: " + (std::string) magic_enum::enum_name(serverStatus));
+        DrawString({10, 10}, "Server: " + (std::string) magic_enum::enum_name(serverStatus) + " load: " +
+                             std::to_string(int(serverMetrics.fLoad)) + "% players: " +
+                             std::to_string(serverMetrics.nPlayers));
 
         // Display Ping
         DrawString({10, 20}, "Ping: " + std::to_string(fPing) + "ms");
@@ -274,16 +380,18 @@ private:
         }
     }
 
+    // Load a binary map (see MMO_MapConverter) or a text map, chunks are streamed in as players come near them
     void SetMap(std::string path) {
-        std::ifstream file(path);
-
-        std::string line;
-        while (std::getline(file, line)) {
-            sWorldMap.append(line);
-            vWorldSize.y++;
-        }
-        vWorldSize.x = line.length();
-        std::cout << "Map " << path << " loaded\nSize: (" << vWorldSize.x << "," << vWorldSize.y << ")\n";
+        auto tpStart = std::chrono::steady_clock::now();
+        MapFile file;
+        if (!file.Open(path)) std::cout << "Map " << path << " can't be loaded\n";
+        mapCollision = CollisionMap(std::move(file));
+        layerTiles.Clear();
+        double fLoad = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+
+        olc::vi2d vSize = mapCollision.Size();
+        std::cout << "Map " << path << " loaded in " << fLoad << "ms\nSize: (" << vSize.x << "," << vSize.y << ")\n"
+                  << "Resident memory: " << ResidentMemoryBytes() / 1024 << "KB\n";
     }
 
     void GetPing() {
@@ -318,7 +426,7 @@ private:
                                      olc::Pixel(255, 0, 0),
                                      mapObjects[nPlayerID].vPos,
                                      v};
-        listBullets.push_back(bullet);
+        poolBullets.Add(bullet);
         // Send bullet fire message
         bsl::net::message<GameMsg> FireMsg;
         FireMsg.header.id = GameMsg::Game_FireBullet;
@@ -326,26 +434,12 @@ private:
         Send(FireMsg);
     }
 
-    inline olc::vf2d reflect(olc::vf2d d, olc::vf2d n) {
-        olc::vf2d r;
-        r = d.norm() - 2 * (d.norm().dot(n.norm())) * n.norm();
-        r *= d.mag();
-        return r;
-    }
-
-    inline void HitPlayer(uint32_t shooterID, uint32_t suffererID, uint32_t damage) {
-        bsl::net::message<GameMsg> HitMsg;
-        HitMsg.header.id = GameMsg::Game_HitPlayer;
-        sHitDescription desc = {shooterID, suffererID, damage};
-        HitMsg << desc;
-        Send(HitMsg);
-    }
-
 public:
     bool OnUserCreate() override {
         tv = olc::TileTransformedView({ScreenWidth(), ScreenHeight()}, {32, 32});
         SetMap("resources/map/map_demo.txt");
-        // Connect to the server
+        // Connect to the server, player states go by datagram if the server offers it
+        EnableDatagrams();
         if (Connect("127.0.0.1", 2696)) {
             return true;
         }
@@ -389,49 +483,42 @@ public:
         // Handle User input
         HandleInput(fElapsedTime);
 
-        // update objects locally
+        // Bucket the players so collisions only test the players nearby
+        gridObjects.Clear();
+        float fMaxRadius = 0.0f, fMaxTravel = 0.0f;
+        for (auto &object : mapObjects) {
+            gridObjects.Update(object.first, object.second.vPos);
+            fMaxRadius = std::max(fMaxRadius, object.second.fRadius);
+            fMaxTravel = std::max(fMaxTravel, object.second.vVel.mag() * fElapsedTime);
+        }
+        fObjectReach = fMaxRadius + 2.0f * fMaxTravel;
+
+        // Keep the map around the players streamed in
+        vStreamCenters.clear();
+        for (auto &object : mapObjects) vStreamCenters.push_back(object.second.vPos);
+        mapCollision.Stream(vStreamCenters, 1);
+
+        // Remote players are where their states put them fInterpDelay seconds ago
+        double fNow = Now();
+        for (auto &snapshots : mapSnapshots) {
+            auto object = mapObjects.find(snapshots.first);
+            if (object == mapObjects.end() || snapshots.first == nPlayerID) continue;
+            snapshots.second.Sample(fNow, fInterpDelay, fMaxExtrapolation, object->second);
+        }
+
+        // update objects locally, only our player moves here
         for (auto &object : mapObjects) {
-            // Caculate the new positon of the player
+            if (object.first != nPlayerID) continue;
+            // Caculate the new positon of the player, sliding along the walls it runs into
             // Because the frame rate is different, so we need to use elapsed time to get approximate speed
-            olc::vf2d vPotentialPosition = object.second.vPos + object.second.vVel * fElapsedTime;
-
-            // Get the region of world cells that may have collision
-            olc::vi2d vCurrentCell = object.second.vPos.floor();
-            olc::vi2d vTargetCell = vPotentialPosition;
-            // TopLeft
-            olc::vi2d vAreaTL = (vCurrentCell.min(vTargetCell) - olc::vi2d(1, 1)).max({0, 0});
-            // BottomRight
-            olc::vi2d vAreaBR = (vCurrentCell.max(vTargetCell) + olc::vi2d(1, 1)).min(vWorldSize);
-
-//            tv.FillRectDecal(vAreaTL, vAreaBR - vAreaTL + olc::vi2d(1, 1), olc::Pixel(0, 255, 255, 32));
-
-            olc::vf2d vRayToNearest;
-
-            // Iterate through each cell in collision test area
-            olc::vi2d vCell;
-            for (vCell.y = vAreaTL.y; vCell.y <= vAreaBR.y; vCell.y++) {
-                for (vCell.x = vAreaTL.x; vCell.x <= vAreaBR.x; vCell.x++) {
-                    // Check the cell is solid or not
-                    if (sWorldMap[vCell.y * vWorldSize.x + vCell.x] == '#') {
-                        olc::vf2d vNearestPoint;
-                        vNearestPoint.x = std::max(float(vCell.x), std::min(vPotentialPosition.x, float(vCell.x + 1)));
-                        vNearestPoint.y = std::max(float(vCell.y), std::min(vPotentialPosition.y, float(vCell.y + 1)));
-
-                        vRayToNearest = vNearestPoint - vPotentialPosition;
-                        float fOverlap = object.second.fRadius - vRayToNearest.mag();
-                        if (std::isnan(fOverlap)) fOverlap = 0;
-
-                        if (fOverlap > 0) {
-                            vPotentialPosition = vPotentialPosition - vRayToNearest.norm() * fOverlap;
-                        }
-                    }
-                }
-            }
+            olc::vf2d vPotentialPosition = mapCollision.Move(object.second.vPos, object.second.vVel * fElapsedTime,
+                                                             object.second.fRadius);
 
-            // Check collision with other object
-            for (auto &targetObject : mapObjects) {
+            // Check collision with other object, only the ones in the cells around it can touch it
+            gridObjects.QueryRadius(object.second.vPos, object.second.fRadius + fObjectReach, [&](uint32_t nTargetID) {
                 // Ignore your self
-                if (object.first == targetObject.first) continue;
+                if (object.first == nTargetID) return;
+                auto &targetObject = *mapObjects.find(nTargetID);
 
                 float fDistance = (object.second.vPos - targetObject.second.vPos).mag();
                 // Collision happened
@@ -446,89 +533,38 @@ public:
                     object.second.vPos -= fOverlap * dir;
                     targetObject.second.vPos += fOverlap * dir;
                 }
-
-            }
+            });
 
             // Set the object new position
             object.second.vPos = vPotentialPosition;
         }
 
-        // Update bullets locally
-        for (auto &bullet : listBullets) {
-            // Caculate the new position of the bullet
-            olc::vf2d vPotentialPosition = bullet.vPos + bullet.vVel * fElapsedTime;
-
-            // Get the region of world cells that may have collision
-            olc::vi2d vCurrentCell = bullet.vPos.floor();
-            olc::vi2d vTargetCell = vPotentialPosition;
-            olc::vi2d vAreaTL = (vCurrentCell.min(vTargetCell) - olc::vi2d(1, 1)).max({0, 0});
-            olc::vi2d vAreaBR = (vCurrentCell.max(vTargetCell) + olc::vi2d(1, 1)).min(vWorldSize);
-//            tv.FillRectDecal(vAreaTL, vAreaBR - vAreaTL + olc::vi2d(1, 1), olc::Pixel(0, 255, 255, 32));
-            olc::vf2d vRayToNearest;
-
-            // Iterate through each cell in collision test area
-            olc::vi2d vCell;
-            bool bCollisionHappen = false;
-            for (vCell.y = vAreaTL.y; vCell.y <= vAreaBR.y; vCell.y++) {
-                for (vCell.x = vAreaTL.x; vCell.x <= vAreaBR.x; vCell.x++) {
-                    // Check the cell is solid or not
-                    if (sWorldMap[vCell.y * vWorldSize.x + vCell.x] == '#') {
-                        olc::vf2d vNearestPoint;
-                        vNearestPoint.x = std::max(float(vCell.x), std::min(vPotentialPosition.x, float(vCell.x + 1)));
-                        vNearestPoint.y = std::max(float(vCell.y), std::min(vPotentialPosition.y, float(vCell.y + 1)));
-
-                        vRayToNearest = vNearestPoint - vPotentialPosition;
-                        float fOverlap = bullet.fRadius - vRayToNearest.mag();
-                        if (std::isnan(fOverlap)) fOverlap = 0;
-
-                        if (fOverlap > 0) {
-                            bCollisionHappen = true;
-                            vPotentialPosition = vPotentialPosition - vRayToNearest.norm() * fOverlap;
-                            // If happen collision, nBounce minus 1, and reverse the velocity
-                            if (bullet.nBounce > 0)
-                                bullet.vVel = reflect(bullet.vVel, -vRayToNearest);
-                            bullet.nBounce--;
-                            break;
-                        }
-                    }
-                }
-                if (bCollisionHappen) break;
-            }
-
-            for (auto &targetObject : mapObjects) {
+        // Update bullets locally, moving them and bouncing them off the walls. A bullet touching a player is only
+        // stopped here, the server tells who it hit
+        poolBullets.Update(mapCollision, fElapsedTime);
+        for (size_t i = 0; i < poolBullets.Size(); i++) {
+            olc::vf2d vPos = poolBullets.Pos(i);
+            uint32_t nOwnerID = poolBullets.Owner(i);
+            float fRadius = poolBullets.Radius(i);
+            gridObjects.QueryRadius(vPos, fRadius + fObjectReach, [&](uint32_t nTargetID) {
                 // Ignore your self
-                if (bullet.nOwnerID == targetObject.first) continue;
+                if (nOwnerID == nTargetID) return;
+                auto &targetObject = *mapObjects.find(nTargetID);
 
-                float fDistance = (bullet.vPos - targetObject.second.vPos).mag();
+                float fDistance = (vPos - targetObject.second.vPos).mag();
                 // Collision happened
-                if (fDistance <= bullet.fRadius + targetObject.second.fRadius) {
-                    HitPlayer(bullet.nOwnerID, targetObject.first, bullet.nDamage);
-                    bullet.nBounce = -1;
-                }
-            }
-
-            // Set the object new position
-            bullet.vPos = vPotentialPosition;
+                if (fDistance <= fRadius + targetObject.second.fRadius) poolBullets.Kill(i);
+            });
         }
         // Remove all the bullet which can't bounce
-        listBullets.remove_if([](sBulletDescription b) { return b.nBounce < 0; });
+        poolBullets.RemoveDead();
 
 
         // Clear World
         Clear(olc::BLACK);
 
-        // Draw World
-        olc::vi2d vTL = tv.GetTopLeftTile().max({0, 0});
-        olc::vi2d vBR = tv.GetBottomRightTile().min(vWorldSize);
-        olc::vi2d vTile;
-        for (vTile.y = vTL.y; vTile.y < vBR.y; vTile.y++) {
-            for (vTile.x = vTL.x; vTile.x < vBR.x; vTile.x++) {
-                if (sWorldMap[vTile.y * vWorldSize.x + vTile.x] == '#') {
-                    tv.DrawRect(vTile, {1.0f, 1.0f});
-                    tv.DrawRect(olc::vf2d(vTile) + olc::vf2d(0.1f, 0.1f), {0.8f, 0.8f});
-                }
-            }
-        }
+        // Draw World, the walls as decals so the GPU scales the cached chunks
+        layerTiles.Draw(*this, tv, mapCollision, true);
 
         // Draw World Objects
         for (auto &object : mapObjects) {
@@ -554,24 +590,50 @@ public:
                     sHealth, olc::RED, {1, 1});
         }
         // Draw Bullet
-        for (auto &bullet : listBullets) {
-            tv.FillCircle(bullet.vPos, bullet.fRadius, bullet.pColor);
+        for (size_t i = 0; i < poolBullets.Size(); i++) {
+            tv.FillCircle(poolBullets.Pos(i), poolBullets.Radius(i), poolBullets.Color(i));
         }
 
         // Display HUD
         DisplayHUD();
 
-        // Send player description
+        // Send player description fSendRate times per second, a keyframe by datagram once the channel is up, else
+        // only what changed since the last one over TCP. The remainder is kept so the rate doesn't drift with the
+        // frame rate, and a long frame doesn't cause a burst
+        fSendTime += fElapsedTime;
+        if (fSendRate > 0.0f) {
+            if (fSendTime < 1.0f / fSendRate) return true;
+            fSendTime = std::fmod(fSendTime, 1.0f / fSendRate);
+        }
+        mapObjects[nPlayerID].nSequence++;
+        mapObjects[nPlayerID].nTime = uint32_t(
+                std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tpStart).count());
+
         bsl::net::message<GameMsg> msg;
         msg.header.id = GameMsg::Game_UpdatePlayer;
-        msg << mapObjects[nPlayerID];
-        Send(msg);
+        if (IsDatagramBound()) {
+            codec.EncodeKeyframe(mapObjects[nPlayerID], msg.body);
+            msg.header.size = uint32_t(msg.size());
+            SendUnreliable(std::move(msg));
+        } else {
+            codec.Encode(mapObjects[nPlayerID], descSent, msg.body);
+            msg.header.size = uint32_t(msg.size());
+            Send(std::move(msg));
+        }
         return true;
     }
 };
 
-int main() {
-    MMOGame demo;
+int main(int argc, char *argv[]) {
+    // Options are given as "--name value" pairs
+    float fSendRate = 20.0f, fInterpDelay = 0.1f;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string sOption = argv[i];
+        if (sOption == "--send-rate") fSendRate = std::stof(argv[i + 1]);
+        if (sOption == "--interp-delay") fInterpDelay = std::stof(argv[i + 1]);
+    }
+
+    MMOGame demo(fSendRate, fInterpDelay);
     if (demo.Construct(800, 600, 1, 1))
         demo.Start();
     return 0;
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <chrono>
+
+#include "MMO_MapFile.h"
+
+// Convert a text map ('#' is solid, one line per row) to the binary chunked format the client and the server
+// memory map, or generate a large test map straight to it:
+//     MMO_MapConverter map.txt map.mmo
+//     MMO_MapConverter --generate 4096 map.mmo
+
+// Walled map with scattered pillars and a few rooms, roughly what a big hand made map would hold
+std::string GenerateTiles(int32_t nSize, uint32_t nSeed) {
+    std::mt19937 rng(nSeed);
+    std::string sTiles(size_t(nSize) * nSize, '.');
+    auto Set = [&](int32_t x, int32_t y) {
+        if (x >= 0 && y >= 0 && x < nSize && y < nSize) sTiles[size_t(y) * nSize + x] = '#';
+    };
+
+    for (int32_t i = 0; i < nSize; i++) {
+        Set(i, 0);
+        Set(i, nSize - 1);
+        Set(0, i);
+        Set(nSize - 1, i);
+    }
+
+    // Rooms, hollow boxes with a door in the top wall
+    std::uniform_int_distribution<int32_t> pos(1, nSize - 2), side(6, 24);
+    for (int32_t nRoom = 0; nRoom < nSize * nSize / 4096; nRoom++) {
+        int32_t x0 = pos(rng), y0 = pos(rng), w = side(rng), h = side(rng);
+        for (int32_t x = x0; x <= x0 + w; x++) {
+            if (x != x0 + w / 2) Set(x, y0);
+            Set(x, y0 + h);
+        }
+        for (int32_t y = y0; y <= y0 + h; y++) {
+            Set(x0, y);
+            Set(x0 + w, y);
+        }
+    }
+
+    for (int32_t nPillar = 0; nPillar < nSize * nSize / 100; nPillar++) Set(pos(rng), pos(rng));
+    return sTiles;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3 && !(argc == 4 && std::string(argv[1]) == "--generate")) {
+        std::cout << "usage: " << argv[0] << " <map.txt> <map.mmo>\n"
+                  << "       " << argv[0] << " --generate <size> <map.mmo>\n";
+        return 1;
+    }
+
+    auto tpStart = std::chrono::steady_clock::now();
+    MapFile map;
+    std::string sOut;
+    if (argc == 4) {
+        int32_t nSize = std::stoi(argv[2]);
+        map.FromText(GenerateTiles(nSize, uint32_t(nSize)), {nSize, nSize});
+        sOut = argv[3];
+    } else {
+        if (!map.LoadText(argv[1])) {
+            std::cout << "can't read " << argv[1] << "\n";
+            return 1;
+        }
+        sOut = argv[2];
+    }
+
+    if (!map.Save(sOut)) {
+        std::cout << "can't write " << sOut << "\n";
+        return 1;
+    }
+    double fTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+    std::cout << sOut << ": " << map.Size().x << "x" << map.Size().y << " tiles, " << map.ChunksX() * map.ChunksY()
+              << " chunks, " << map.ImageBytes() / 1024 << "KB, " << fTime << "ms\n";
+    return 0;
+}
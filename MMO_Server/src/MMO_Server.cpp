@@ -1,21 +1,1282 @@
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "MMO_Common.h"
+#include "MMO_SpatialHash.h"
+#include "MMO_StateCodec.h"
+#include "MMO_CollisionMap.h"
+#include "MMO_BulletPool.h"
+#include "magic_enum.hpp"
 
 class GameServer : public bsl::net::server_interface<GameMsg> {
 public:
     GameServer(uint16_t nPort) : bsl::net::server_interface<GameMsg>(nPort) {}
 
+    // Server without a listener, for Replay
+    GameServer() = default;
+
+    // Shard nShard of a sharded server, behind the listener of lobby
+    GameServer(GameServer &lobby, int32_t nShard)
+            : bsl::net::server_interface<GameMsg>(lobby), m_nShard(nShard),
+              m_sTag("[Shard " + std::to_string(nShard) + "] ") {}
+
     std::unordered_map<uint32_t, sPlayerDescription> m_mapPlayerRoster;
     // Player need to be deleted
     std::vector<uint32_t> m_vGarbageIDs;
 
+    // Simulation ticks per second, 0 relays every update as it arrives
+    void SetTickRate(float fTickRate) {
+        m_fTickRate = fTickRate;
+    }
+
+    // Only exchange state between players within fRadius tiles of each other, 0 sends everything to everyone
+    void SetInterestRadius(float fRadius) {
+        m_fInterestRadius = fRadius;
+        m_gridInterest = SpatialHash(std::max(fRadius, 1.0f));
+    }
+
+    // Make this server the lobby of vShards: it keeps the listener and hands every player that registers to the shard
+    // of its zone. Zones are strips of the world fZoneWidth tiles wide from x = 0, the last one reaching to the edge
+    // of the world, 0 splits the width of the map evenly. Call after the shards are set up
+    void SetShards(const std::vector<GameServer *> &vShards, float fZoneWidth) {
+        if (fZoneWidth <= 0.0f) {
+            olc::vi2d vSize = vShards.front()->m_mapCollision.Size();
+            fZoneWidth = (vSize.x > 0 ? float(vSize.x) : fDefaultWorldWidth) / float(vShards.size());
+        }
+        m_vShards = vShards;
+        m_fZoneWidth = fZoneWidth;
+        m_sTag = "[Lobby] ";
+        for (auto *pShard : vShards) {
+            pShard->m_vShards = vShards;
+            pShard->m_fZoneWidth = fZoneWidth;
+            // Far enough to hold every player a player across the border can see, the 3x3 cells around it
+            pShard->m_fMirrorMargin = 2.0f * std::max(pShard->m_fInterestRadius, 1.0f) + fHandoffMargin;
+        }
+        std::cout << "[Shards] " << vShards.size() << " zones of " << fZoneWidth << " tiles, players within "
+                  << vShards.front()->m_fMirrorMargin << " tiles of a border are mirrored\n";
+    }
+
+    // Dump the metrics every fInterval seconds, to sPath if given or stdout, 0 turns the dump off
+    void SetMetricsReport(float fInterval, const std::string &sPath) {
+        m_fMetricsInterval = fInterval;
+        if (!sPath.empty()) m_fileMetrics.open(sPath, std::ios::app);
+    }
+
+    // Load the world map, a binary map is memory mapped and its chunks are streamed in around the players
+    bool LoadMap(const std::string &sPath) {
+        auto tpStart = std::chrono::steady_clock::now();
+        MapFile file;
+        if (!file.Open(sPath)) {
+            std::cout << m_sTag << "[Map] can't load " << sPath << "\n";
+            return false;
+        }
+        bool bMapped = file.IsMapped();
+        m_mapCollision = CollisionMap(std::move(file));
+        double fLoad = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tpStart).count();
+        olc::vi2d vSize = m_mapCollision.Size();
+        std::cout << m_sTag << "[Map] " << sPath << " " << vSize.x << "x" << vSize.y << (bMapped ? " mapped" : " from text")
+                  << " in " << fLoad << "ms, resident: " << ResidentMemoryBytes() / 1024 << "KB\n";
+        return true;
+    }
+
+    // Serve clients forever
+    void Run() {
+        if (m_fTickRate <= 0.0f) {
+            // Messages are handled as they come, wake up a few times a second to keep the map streamed
+            while (1) {
+                Update(-1, WakeAt(std::chrono::steady_clock::now() + std::chrono::milliseconds(250)));
+                FlushGarbage();
+                FlushPresence();
+                StepBullets(std::chrono::steady_clock::now());
+                StreamMap();
+                ReportCodec();
+                UpdateMetrics();
+            }
+        }
+
+        // Fixed tick mode, handle messages until the next tick is due, then publish the tick's snapshot
+        auto tpPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(1.0 / m_fTickRate));
+        auto tpNextTick = std::chrono::steady_clock::now() + tpPeriod;
+        while (1) {
+            Update(-1, WakeAt(tpNextTick));
+            StepBullets(std::chrono::steady_clock::now());
+            UpdateMetrics();
+
+            auto tpNow = std::chrono::steady_clock::now();
+            if (tpNow >= tpNextTick) {
+                Tick(tpNow - tpNextTick);
+                StreamMap();
+                ReportCodec();
+                tpNextTick += tpPeriod;
+
+                // Too far behind to catch up, skip the missed ticks instead of bursting them
+                if (std::chrono::steady_clock::now() > tpNextTick + tpPeriod)
+                    tpNextTick = std::chrono::steady_clock::now() + tpPeriod;
+            }
+        }
+    }
+
+    // Feed a session recorded with RecordSession through OnMessage, with stand-in connections for its clients, at
+    // fSpeed times the recorded pace or as fast as possible for 0. Ticks and bullet steps follow the recorded clock
+    // instead of the wall clock, so every replay of a log sends the same. False if the log can't be read to its end
+    bool Replay(const std::string &sPath, float fSpeed) {
+        bsl::net::session_reader<GameMsg> reader;
+        if (!reader.Open(sPath)) {
+            std::cout << "[Replay] can't read " << sPath << "\n";
+            return false;
+        }
+        m_bReplaying = true;
+
+        auto tpStart = std::chrono::steady_clock::now();
+        auto tpPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(m_fTickRate > 0.0f ? 1.0 / m_fTickRate : 0.0));
+        auto tpNextTick = tpStart + tpPeriod;
+        uint64_t nRecords = 0, nRecordedTime = 0;
+        bsl::net::session_record<GameMsg> record, next;
+        bool bNext = reader.Next(next);
+        while (bNext) {
+            record = std::move(next);
+            bNext = reader.Next(next);
+            nRecords++;
+            nRecordedTime = record.nTime;
+            auto tpAt = tpStart + std::chrono::microseconds(record.nTime);
+            if (fSpeed > 0.0f)
+                std::this_thread::sleep_until(tpStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double, std::micro>(double(record.nTime) / fSpeed)));
+
+            // What the recorded clock had due before the record
+            for (; m_fTickRate > 0.0f && tpNextTick <= tpAt; tpNextTick += tpPeriod) {
+                StepBullets(tpNextTick);
+                Tick(std::chrono::steady_clock::duration(0));
+            }
+            StepBullets(tpAt);
+
+            if (record.kind == bsl::net::record_kind::message)
+                ReplayMessage(record.nConnectionID, std::move(record.msg), tpAt);
+            else
+                ReplayDisconnect(record.nConnectionID);
+            // Clients are recorded gone once the server tried to send to them while handling a message, they were
+            // gone before that message
+            for (; bNext && next.kind == bsl::net::record_kind::disconnect; bNext = reader.Next(next)) {
+                ReplayDisconnect(next.nConnectionID);
+                nRecords++;
+            }
+            if (m_fTickRate <= 0.0f) {
+                FlushGarbage();
+                FlushPresence();
+            }
+            Update(-1, false);
+            UpdateMetrics();
+        }
+
+        double fTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - tpStart).count();
+        bsl::net::message_stats total = TotalStats(GetMessageStats());
+        std::cout << std::fixed << std::setprecision(3) << "[Replay] " << sPath << ": " << nRecords << " records, "
+                  << double(nRecordedTime) / 1e6 << "s recorded, replayed in " << fTime << "s ("
+                  << std::setprecision(0) << double(nRecords) / std::max(fTime, 1e-9) << " records/s)\n"
+                  << "[Replay] sent " << total.nMessagesOut << " messages / " << total.nBytesOut << "B, digest "
+                  << std::hex << std::setw(16) << std::setfill('0') << GetReplayDigest() << std::dec
+                  << std::setfill(' ') << (reader.Truncated() ? ", the log is cut off" : "") << "\n";
+        return !reader.Truncated();
+    }
+
 private:
+    // Busy once the game thread is handling messages or ticking for more than half of the time, a tick was late,
+    // or messages pile up on the way in or on the way out to a client
     ServerStatus getServerStatus() {
+        if (m_metrics.fLoad > fBusyLoad || m_windowLoad.nLastOverruns > 0) return ServerStatus::BUSY;
+        if (m_metrics.nIncomingDepth > nBusyQueueDepth || m_metrics.nOutgoingDepth > nBusyQueueDepth)
+            return ServerStatus::BUSY;
         return ServerStatus::IDLE;
     }
 
+    // Sum of the counters of every message type
+    static bsl::net::message_stats TotalStats(const std::vector<bsl::net::message_stats> &vStats) {
+        bsl::net::message_stats total;
+        for (auto &stats : vStats) {
+            total.nMessagesIn += stats.nMessagesIn;
+            total.nBytesIn += stats.nBytesIn;
+            total.nMessagesOut += stats.nMessagesOut;
+            total.nBytesOut += stats.nBytesOut;
+            total.tpHandle += stats.tpHandle;
+            for (size_t i = 0; i < total.nHandleHistogram.size(); i++)
+                total.nHandleHistogram[i] += stats.nHandleHistogram[i];
+        }
+        return total;
+    }
+
+    // Counters of now minus counters of before
+    static bsl::net::message_stats Difference(const bsl::net::message_stats &now,
+                                              const bsl::net::message_stats &before) {
+        bsl::net::message_stats diff;
+        diff.nMessagesIn = now.nMessagesIn - before.nMessagesIn;
+        diff.nBytesIn = now.nBytesIn - before.nBytesIn;
+        diff.nMessagesOut = now.nMessagesOut - before.nMessagesOut;
+        diff.nBytesOut = now.nBytesOut - before.nBytesOut;
+        diff.tpHandle = now.tpHandle - before.tpHandle;
+        for (size_t i = 0; i < diff.nHandleHistogram.size(); i++)
+            diff.nHandleHistogram[i] = now.nHandleHistogram[i] - before.nHandleHistogram[i];
+        return diff;
+    }
+
+    // Upper bound of the histogram bucket holding the given percentile of the handling times, in microseconds
+    static float HandlePercentile(const bsl::net::message_stats &stats, float fPercent) {
+        uint64_t nTotal = 0;
+        for (auto n : stats.nHandleHistogram) nTotal += n;
+        if (nTotal == 0) return 0.0f;
+        uint64_t nRank = uint64_t(std::ceil(double(nTotal) * fPercent / 100.0)), nSeen = 0;
+        for (size_t i = 0; i < stats.nHandleHistogram.size(); i++) {
+            nSeen += stats.nHandleHistogram[i];
+            if (nSeen >= nRank) return float(uint64_t(2) << i);
+        }
+        return float(uint64_t(2) << (stats.nHandleHistogram.size() - 1));
+    }
+
+    // Longest queue of messages waiting to be sent to one client
+    size_t OutgoingDepth() const {
+        size_t nDepth = 0;
+        for (auto &client : m_connections) nDepth = std::max(nDepth, client->GetQueuedMessages());
+        return nDepth;
+    }
+
+    // Close the load window every second, the status and its reply describe the last window, then dump the metrics
+    // when it's time
+    void UpdateMetrics() {
+        auto tpNow = std::chrono::steady_clock::now();
+        double fWindow = std::chrono::duration<double>(tpNow - m_windowLoad.tpStart).count();
+        if (fWindow < 1.0) return;
+
+        bsl::net::message_stats total = TotalStats(GetMessageStats());
+        bsl::net::message_stats diff = Difference(total, m_windowLoad.statsStart);
+        auto tpBusy = diff.tpHandle + m_windowLoad.tpTick;
+
+        m_metrics.nConnections = uint32_t(m_connections.Size());
+        m_metrics.nPlayers = uint32_t(m_mapPlayerRoster.size() - m_setGhostIDs.size());
+        m_metrics.fLoad = float(100.0 * std::chrono::duration<double>(tpBusy).count() / fWindow);
+        m_metrics.nIncomingDepth = uint32_t(GetIncomingDepth());
+        m_metrics.nOutgoingDepth = uint32_t(OutgoingDepth());
+        m_metrics.fMessagesIn = float(diff.nMessagesIn / fWindow);
+        m_metrics.fMessagesOut = float(diff.nMessagesOut / fWindow);
+        m_metrics.fBytesIn = float(diff.nBytesIn / fWindow);
+        m_metrics.fBytesOut = float(diff.nBytesOut / fWindow);
+        m_metrics.fHandleP99 = HandlePercentile(diff, 99.0f);
+
+        m_windowLoad.nLastOverruns = m_windowLoad.nOverruns;
+        m_windowLoad.nOverruns = 0;
+        m_windowLoad.tpTick = std::chrono::steady_clock::duration(0);
+        m_windowLoad.statsStart = total;
+        m_windowLoad.tpStart = tpNow;
+
+        if (m_fMetricsInterval > 0.0f && tpNow - m_tpMetricsReport > std::chrono::duration<float>(m_fMetricsInterval)) {
+            ReportMetrics();
+            m_tpMetricsReport = tpNow;
+        }
+    }
+
+    // Dump the load, then the traffic and handling time of every message type since the last dump, then the
+    // connections: all of them to a file, the ones with the longest outgoing queues to stdout
+    void ReportMetrics() {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        out << m_sTag << "[Metrics] status: " << magic_enum::enum_name(getServerStatus()) << " load: " << m_metrics.fLoad << "%"
+            << " connections: " << m_metrics.nConnections << " players: " << m_metrics.nPlayers
+            << " in: " << m_metrics.fMessagesIn << "msg/s " << m_metrics.fBytesIn / 1024.0f << "KB/s"
+            << " out: " << m_metrics.fMessagesOut << "msg/s " << m_metrics.fBytesOut / 1024.0f << "KB/s"
+            << " queued in: " << m_metrics.nIncomingDepth << " queued out (max): " << m_metrics.nOutgoingDepth
+            << " handle p99: " << m_metrics.fHandleP99 << "us overflow disconnects: " << GetOverflowDisconnects()
+            << "\n";
+
+        auto &vStats = GetMessageStats();
+        m_vMetricsReported.resize(vStats.size());
+        for (size_t i = 0; i < vStats.size(); i++) {
+            bsl::net::message_stats diff = Difference(vStats[i], m_vMetricsReported[i]);
+            if (diff.nMessagesIn + diff.nMessagesOut == 0) continue;
+            double fAverage = diff.nMessagesIn ? std::chrono::duration<double, std::micro>(diff.tpHandle).count() /
+                                                 double(diff.nMessagesIn) : 0.0;
+            out << m_sTag << "[Metrics] " << magic_enum::enum_name(GameMsg(i)) << " in: " << diff.nMessagesIn << " / "
+                << diff.nBytesIn << "B out: " << diff.nMessagesOut << " / " << diff.nBytesOut << "B"
+                << " handle avg: " << fAverage << "us p50: " << HandlePercentile(diff, 50.0f)
+                << "us p99: " << HandlePercentile(diff, 99.0f) << "us\n";
+        }
+        m_vMetricsReported = vStats;
+
+        // Queue depths change under the I/O threads, sort a snapshot of them
+        std::vector<std::pair<size_t, std::shared_ptr<bsl::net::connection<GameMsg>>>> vConnections;
+        for (auto &client : m_connections) vConnections.emplace_back(client->GetQueuedMessages(), client);
+        size_t nShown = vConnections.size();
+        if (!m_fileMetrics.is_open()) nShown = std::min(nShown, nReportConnections);
+        std::partial_sort(vConnections.begin(), vConnections.begin() + nShown, vConnections.end(),
+                          [](const auto &a, const auto &b) { return a.first > b.first; });
+        for (size_t i = 0; i < nShown; i++) {
+            auto &client = vConnections[i].second;
+            out << m_sTag << "[Metrics] [" << client->GetID() << "] in: " << client->GetReadStats().nMessages << " / "
+                << client->GetReadStats().nBytes << "B out: " << client->GetWriteStats().nMessages << " / "
+                << client->GetWriteStats().nBytes << "B queued: " << vConnections[i].first
+                << " replaced: " << client->GetWriteStats().nReplaced << "\n";
+        }
+
+        if (m_fileMetrics.is_open())
+            m_fileMetrics << out.str() << std::flush;
+        else
+            std::cout << out.str();
+    }
+
+    // Forget the players that left, every client is told about them by the next FlushPresence
+    // Done here rather than in OnClientDisconnect, which can run from inside a send while the maps below are iterated
+    void FlushGarbage() {
+        while (!m_vGarbageIDs.empty()) {
+            std::vector<uint32_t> vGarbageIDs;
+            vGarbageIDs.swap(m_vGarbageIDs);
+            std::sort(vGarbageIDs.begin(), vGarbageIDs.end());
+            m_vClientIDs.erase(std::remove_if(m_vClientIDs.begin(), m_vClientIDs.end(), [&](uint32_t id) {
+                return std::binary_search(vGarbageIDs.begin(), vGarbageIDs.end(), id);
+            }), m_vClientIDs.end());
+            for (auto pid : vGarbageIDs) {
+                m_gridInterest.Remove(pid);
+                for (uint32_t other : m_mapVisible[pid]) m_mapVisible[other].erase(pid);
+                m_mapVisible.erase(pid);
+                m_mapReceived.erase(pid);
+                m_mapSent.erase(pid);
+                for (auto &sent : m_mapSent) sent.second.erase(pid);
+                m_mapPresence.erase(pid);
+                m_mapCombat.erase(pid);
+                m_setGhostIDs.erase(pid);
+                auto mirrored = m_mapMirrored.find(pid);
+                if (mirrored != m_mapMirrored.end()) {
+                    PostUnmirror(pid, mirrored->second);
+                    m_mapMirrored.erase(mirrored);
+                }
+            }
+
+            for (auto pid : vGarbageIDs) {
+                std::cout << "[Remove]: " << pid << "\n";
+                m_vLeftIDs.push_back(pid);
+                m_setDirtyIDs.erase(pid);
+            }
+        }
+    }
+
+    // Send the presence changes queued since the last flush in as few Game_AddPlayers and Game_RemovePlayers as
+    // possible. The players that left go to every client at once. Without an area of interest the players that
+    // joined are encoded once for everyone, and the roster once for all the clients that joined, so a storm of
+    // joins costs two lists per flush instead of a message per pair of players
+    void FlushPresence() {
+        std::vector<bsl::net::shared_message<GameMsg>> vFrames;
+        if (!m_vLeftIDs.empty()) {
+            AppendPresenceFrames(GameMsg::Game_RemovePlayers, m_vLeftIDs, vFrames);
+            m_vLeftIDs.clear();
+            for (const auto &frame : vFrames) MessageAllClients(frame);
+        }
+
+        if (!m_vJoinedIDs.empty()) {
+            std::unordered_set<uint32_t> setJoined;
+            std::vector<sPlayerDescription> vJoined, vRoster;
+            for (uint32_t id : m_vJoinedIDs) {
+                auto player = m_mapPlayerRoster.find(id);
+                if (player != m_mapPlayerRoster.end() && setJoined.insert(id).second) vJoined.push_back(player->second);
+            }
+            m_vJoinedIDs.clear();
+            for (const auto &player : m_mapPlayerRoster) vRoster.push_back(player.second);
+
+            std::vector<bsl::net::shared_message<GameMsg>> vJoinedFrames, vRosterFrames;
+            AppendPresenceFrames(GameMsg::Game_AddPlayers, vJoined, vJoinedFrames);
+            AppendPresenceFrames(GameMsg::Game_AddPlayers, vRoster, vRosterFrames);
+            for (uint32_t nClientID : m_vClientIDs) {
+                auto client = m_connections.Find(nClientID);
+                if (!client) continue;
+                bool bJoined = setJoined.count(nClientID) > 0;
+                auto &mapSent = m_mapSent[nClientID];
+                for (const auto &desc : bJoined ? vRoster : vJoined) mapSent[desc.nUniqueID] = desc;
+                for (const auto &frame : bJoined ? vRosterFrames : vJoinedFrames) {
+                    MessageClient(client, frame);
+                    // Found gone, its baselines go with it at the next FlushGarbage
+                    if (!client->IsConnected()) break;
+                }
+            }
+        }
+
+        for (const auto &pending : m_mapPresence) SendPresence(pending.first, pending.second);
+        m_mapPresence.clear();
+    }
+
+    // Send the presence changes queued for client nTargetID now rather than with the next flush
+    void FlushPresence(uint32_t nTargetID) {
+        auto pending = m_mapPresence.find(nTargetID);
+        if (pending == m_mapPresence.end()) return;
+        SendPresence(nTargetID, pending->second);
+        m_mapPresence.erase(pending);
+    }
+
+    // Split a list of player descriptions or IDs over as many presence messages as it takes
+    template<typename DataType>
+    static void AppendPresenceFrames(GameMsg id, const std::vector<DataType> &vItems,
+                                     std::vector<bsl::net::shared_message<GameMsg>> &vFrames) {
+        for (size_t i = 0; i < vItems.size(); i += nMaxPresencePerMessage) {
+            size_t nCount = std::min<size_t>(vItems.size() - i, nMaxPresencePerMessage);
+            bsl::net::message<GameMsg> msg;
+            msg.header.id = id;
+            bsl::net::message_writer<GameMsg>(msg, sizeof(uint32_t) + nCount * sizeof(DataType))
+                    .WriteArray(vItems.data() + i, nCount);
+            vFrames.push_back(bsl::net::make_shared_message(std::move(msg)));
+        }
+    }
+
+    // Send each client the latest state of the players it sees that were updated since the last tick
+    void Tick(std::chrono::steady_clock::duration tpLate) {
+        auto tpStart = std::chrono::steady_clock::now();
+
+        FlushGarbage();
+        FlushPresence();
+
+        if (!m_setDirtyIDs.empty()) {
+            // States are encoded against what each client last received, so every client gets its own snapshot.
+            // Clients with a datagram channel get keyframes over UDP instead, a lost snapshot is replaced by the next
+            for (uint32_t nClientID : m_vClientIDs) {
+                auto client = m_connections.Find(nClientID);
+                if (!client) continue;
+                const auto &setVisible = m_mapVisible[nClientID];
+                bool bKeyframe = HasDatagramChannel(client);
+                bsl::net::message<GameMsg> msgSnapshot;
+                msgSnapshot.header.id = GameMsg::Game_Snapshot;
+                uint32_t nPlayers = 0;
+                for (auto id : m_setDirtyIDs) {
+                    // A client simulates its own player, and with an area of interest only sees the players around it
+                    if (id == nClientID || (m_fInterestRadius > 0.0f && setVisible.count(id) == 0)) continue;
+                    if (!HasBaseline(nClientID, id)) continue;
+                    auto player = m_mapPlayerRoster.find(id);
+                    if (player == m_mapPlayerRoster.end()) continue;
+                    EncodeState(nClientID, player->second, msgSnapshot, bKeyframe);
+                    nPlayers++;
+                }
+                if (nPlayers == 0) continue;
+                msgSnapshot << nPlayers;
+                m_statsTick.nSnapshotPlayers += nPlayers;
+                if (bKeyframe)
+                    MessageClientUnreliable(client, std::move(msgSnapshot));
+                else
+                    MessageClient(client, std::move(msgSnapshot));
+            }
+            m_setDirtyIDs.clear();
+        }
+
+        // Per tick timing, reported every few seconds
+        auto tpDuration = std::chrono::steady_clock::now() - tpStart;
+        m_windowLoad.tpTick += tpDuration;
+        m_statsTick.nTicks++;
+        m_statsTick.tpTotal += tpDuration;
+        m_statsTick.tpMax = std::max(m_statsTick.tpMax, tpDuration);
+        if (tpLate > std::chrono::duration<double>(1.0 / m_fTickRate)) {
+            m_statsTick.nOverruns++;
+            m_windowLoad.nOverruns++;
+        }
+
+        if (tpStart - m_statsTick.tpReport > std::chrono::seconds(5)) {
+            using ms = std::chrono::duration<double, std::milli>;
+            std::cout << m_sTag << "[Tick] rate: " << m_fTickRate << "Hz ticks: " << m_statsTick.nTicks
+                      << " avg: " << ms(m_statsTick.tpTotal).count() / m_statsTick.nTicks << "ms"
+                      << " max: " << ms(m_statsTick.tpMax).count() << "ms"
+                      << " overruns: " << m_statsTick.nOverruns
+                      << " players/tick: " << double(m_statsTick.nSnapshotPlayers) / m_statsTick.nTicks << "\n";
+            m_statsTick = tick_stats();
+            m_statsTick.tpReport = tpStart;
+        }
+    }
+
+    // Keep the map chunks around the players streamed in, a few times a second as players only cross a chunk now
+    // and then, and report what the map holds every few seconds
+    void StreamMap() {
+        if (m_mapCollision.Chunks() == 0) return;
+        auto tpNow = std::chrono::steady_clock::now();
+        if (tpNow - m_tpStreamed < std::chrono::milliseconds(250)) return;
+        m_tpStreamed = tpNow;
+
+        m_vStreamCenters.clear();
+        for (auto &player : m_mapPlayerRoster) m_vStreamCenters.push_back(player.second.vPos);
+        m_mapCollision.Stream(m_vStreamCenters, 1);
+
+        if (tpNow - m_tpMapReport < std::chrono::seconds(5)) return;
+        m_tpMapReport = tpNow;
+        std::cout << m_sTag << "[Map] chunks: " << m_mapCollision.ResidentChunks() << "/" << m_mapCollision.Chunks()
+                  << " map memory: " << m_mapCollision.MemoryBytes() / 1024 << "KB"
+                  << " resident: " << ResidentMemoryBytes() / 1024 << "KB\n";
+    }
+
+    // Wake up for the next bullet step before tpUntil while bullets are in flight
+    std::chrono::steady_clock::time_point WakeAt(std::chrono::steady_clock::time_point tpUntil) const {
+        return m_poolBullets.Empty() ? tpUntil : std::min(tpUntil, m_tpBulletStep);
+    }
+
+    // Move the bullets in fixed steps whatever the tick rate, so they travel and hit the same way at any rate. A
+    // server too far behind drops the missed steps rather than bursting them
+    void StepBullets(std::chrono::steady_clock::time_point tpNow) {
+        auto tpStep = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(fBulletStep));
+        if (m_poolBullets.Empty()) {
+            m_tpBulletStep = tpNow + tpStep;
+            return;
+        }
+        for (int nSteps = 0; tpNow >= m_tpBulletStep && nSteps < nMaxBulletSteps; nSteps++) {
+            SimulateBullets(fBulletStep);
+            m_tpBulletStep += tpStep;
+        }
+        if (tpNow >= m_tpBulletStep) m_tpBulletStep = tpNow + tpStep;
+
+        if (tpNow - m_statsBullets.tpReport < std::chrono::seconds(5)) return;
+        std::cout << m_sTag << "[Bullets] in flight: " << m_poolBullets.Size() << " fired: " << m_statsBullets.nFired
+                  << " hits: " << m_statsBullets.nHits << " deaths: " << m_statsBullets.nDeaths << "\n";
+        m_statsBullets = bullet_stats();
+        m_statsBullets.tpReport = tpNow;
+    }
+
+    // Move every bullet against the map and the players, a bullet stops at the first player it touches and the
+    // hit is resolved here once, instead of by every client that saw it. Only the local players are hit when
+    // sharded, a ghost is hit by the shard that owns it, which simulates the bullets of the players mirrored to it
+    void SimulateBullets(float fElapsedTime) {
+        m_poolBullets.Update(m_mapCollision, fElapsedTime);
+
+        m_gridTargets.Clear();
+        float fMaxRadius = 0.0f;
+        for (auto &player : m_mapPlayerRoster) {
+            if (player.second.status == PlayerStatus::Dead || m_setGhostIDs.count(player.first) > 0) continue;
+            m_gridTargets.Update(player.first, player.second.vPos);
+            fMaxRadius = std::max(fMaxRadius, player.second.fRadius);
+        }
+
+        for (size_t i = 0; i < m_poolBullets.Size(); i++) {
+            if (m_poolBullets.Bounce(i) < 0) continue;
+            if (m_poolBullets.Age(i) > fBulletLifetime) {
+                m_poolBullets.Kill(i);
+                continue;
+            }
+            olc::vf2d vPos = m_poolBullets.Pos(i);
+            uint32_t nOwnerID = m_poolBullets.Owner(i);
+            float fRadius = m_poolBullets.Radius(i);
+            // The nearest player it touches, the query visits them in no particular order
+            uint32_t nTargetID = 0;
+            float fNearest = 0.0f;
+            m_gridTargets.QueryRadius(vPos, fRadius + fMaxRadius, [&](uint32_t nID) {
+                if (nID == nOwnerID) return;
+                // A hit earlier in the pass may have killed a player, or found its client gone and removed it
+                auto player = m_mapPlayerRoster.find(nID);
+                if (player == m_mapPlayerRoster.end() || player->second.status == PlayerStatus::Dead) return;
+                const auto &target = player->second;
+                float fDistance = (vPos - target.vPos).mag();
+                if (fDistance <= fRadius + target.fRadius && (nTargetID == 0 || fDistance < fNearest)) {
+                    nTargetID = nID;
+                    fNearest = fDistance;
+                }
+            });
+            if (nTargetID == 0) continue;
+            m_poolBullets.Kill(i);
+            ResolveHit(nOwnerID, nTargetID, m_poolBullets.Damage(i));
+        }
+        m_poolBullets.RemoveDead();
+    }
+
+    // Damage a local player, killing it once its health runs out. One Game_HitPlayer, and one Game_Dead for the
+    // lethal hit, go to the clients interested in the sufferer, the sufferer and the shooter
+    void ResolveHit(uint32_t nShooterID, uint32_t nSuffererID, uint32_t nDamage) {
+        auto player = m_mapPlayerRoster.find(nSuffererID);
+        auto combat = m_mapCombat.find(nSuffererID);
+        if (player == m_mapPlayerRoster.end() || combat == m_mapCombat.end() || combat->second.bDead) return;
+
+        // Settled before anything is sent, a client found gone while sending leaves the roster
+        bool bLethal = nDamage >= combat->second.nHealth;
+        combat->second.nHealth -= std::min(nDamage, combat->second.nHealth);
+        player->second.nHealth = combat->second.nHealth;
+        if (bLethal) {
+            // Back once its client reports it alive after counting this death
+            combat->second.bDead = true;
+            combat->second.nDeaths = player->second.nDeaths + 1;
+            player->second.status = PlayerStatus::Dead;
+        }
+
+        bsl::net::message<GameMsg> msgHit;
+        msgHit.header.id = GameMsg::Game_HitPlayer;
+        msgHit << sHitDescription{nShooterID, nSuffererID, nDamage};
+        RelayEvent(nSuffererID, std::move(msgHit));
+        m_statsBullets.nHits++;
+        if (!bLethal) return;
+
+        bsl::net::message<GameMsg> msgDead;
+        msgDead.header.id = GameMsg::Game_Dead;
+        msgDead << sDeadDescription{nShooterID, nSuffererID};
+        RelayEvent(nSuffererID, std::move(msgDead));
+        m_statsBullets.nDeaths++;
+    }
+
+    // Put the bullet of msg in flight for player nOwnerID and rewrite msg with what the server made of it: its owner,
+    // size and damage are the server's, not the client's. A dead player doesn't shoot, and a message that isn't
+    // exactly a bullet is dropped. The bullets of a local player also leave from where the roster has it, no faster
+    // than it can shoot, bounce and run; a ghost's bullets were checked by the shard that owns it
+    bool LaunchBullet(uint32_t nOwnerID, bsl::net::message<GameMsg> &msg) {
+        auto combat = m_mapCombat.find(nOwnerID);
+        if (combat != m_mapCombat.end() && combat->second.bDead) return false;
+        if (msg.body.size() != sizeof(sBulletDescription)) return false;
+        sBulletDescription bullet;
+        if (!bsl::net::message_reader<GameMsg>(msg).Read(bullet)) return false;
+        if (!std::isfinite(bullet.vPos.x) || !std::isfinite(bullet.vPos.y) || !std::isfinite(bullet.vVel.x) ||
+            !std::isfinite(bullet.vVel.y))
+            return false;
+        bullet.nOwnerID = nOwnerID;
+        bullet.fRadius = fBulletRadius;
+        bullet.nDamage = nBulletDamage;
+
+        auto player = m_mapPlayerRoster.find(nOwnerID);
+        if (combat != m_mapCombat.end()) {
+            if (player == m_mapPlayerRoster.end()) return false;
+
+            // Shots come no closer together than the player's rate of fire, with a little burst for the jitter
+            auto tpNow = MessageArrived();
+            auto tpInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / std::clamp<uint8_t>(player->second.nRof, 1, nMaxRof)));
+            if (tpNow < combat->second.tpNextShot - tpInterval * (nBulletBurst - 1)) return false;
+            combat->second.tpNextShot = std::max(combat->second.tpNextShot, tpNow) + tpInterval;
+
+            // The roster lags the client by an update, the bullet may leave from a little way off the player
+            olc::vf2d vOffset = bullet.vPos - player->second.vPos;
+            float fReach = std::clamp(player->second.fRadius, 0.0f, fMaxPlayerRadius) + fBulletReach;
+            if (vOffset.mag2() > fReach * fReach) bullet.vPos = player->second.vPos + vOffset.norm() * fReach;
+            float fMaxSpeed = fBulletSpeed + std::clamp(player->second.fSpeed, 0.0f, fMaxPlayerSpeed);
+            if (bullet.vVel.mag2() > fMaxSpeed * fMaxSpeed) bullet.vVel = bullet.vVel.norm() * fMaxSpeed;
+            bullet.nBounce = std::clamp<int32_t>(bullet.nBounce, 0, nMaxBulletBounces);
+        }
+
+        msg.body.clear();
+        bsl::net::message_writer<GameMsg>(msg, sizeof(bullet)).Write(bullet);
+        m_poolBullets.Add(bullet);
+        m_statsBullets.nFired++;
+        return true;
+    }
+
+    // Health and life of a player are decided here, the state its client sends only brings it back to life, once
+    // the client counted the death that killed it
+    void ApplyCombat(sPlayerDescription &desc) {
+        auto combat = m_mapCombat.find(desc.nUniqueID);
+        if (combat == m_mapCombat.end()) return;
+        if (combat->second.bDead && desc.status != PlayerStatus::Dead && desc.nDeaths >= combat->second.nDeaths) {
+            combat->second.bDead = false;
+            combat->second.nHealth = nSpawnHealth;
+        }
+        desc.nHealth = combat->second.nHealth;
+        if (combat->second.bDead)
+            desc.status = PlayerStatus::Dead;
+        else if (desc.status == PlayerStatus::Dead)
+            desc.status = PlayerStatus::Alive;
+    }
+
+    // Print the size of the encoded player states against the size of the raw description every few seconds
+    void ReportCodec() {
+        auto tpNow = std::chrono::steady_clock::now();
+        if (tpNow - m_statsCodec.tpReport < std::chrono::seconds(5)) return;
+        if (m_statsCodec.nStatesIn + m_statsCodec.nStatesOut > 0) {
+            auto PerState = [](uint64_t nBytes, uint64_t nStates) { return nStates ? double(nBytes) / nStates : 0.0; };
+            std::cout << m_sTag << "[Codec] raw: " << sizeof(sPlayerDescription) << "B/update"
+                      << " in: " << m_statsCodec.nStatesIn << " x "
+                      << PerState(m_statsCodec.nBytesIn, m_statsCodec.nStatesIn) << "B"
+                      << " out: " << m_statsCodec.nStatesOut << " x "
+                      << PerState(m_statsCodec.nBytesOut, m_statsCodec.nStatesOut) << "B\n";
+        }
+        m_statsCodec = codec_stats();
+        m_statsCodec.tpReport = tpNow;
+    }
+
+    // Append the state of a player to msg, encoded against the last state client nTargetID received for that player,
+    // or as a keyframe for the datagram channel
+    void EncodeState(uint32_t nTargetID, const sPlayerDescription &desc, bsl::net::message<GameMsg> &msg,
+                     bool bKeyframe) {
+        size_t nBefore = msg.body.size();
+        if (bKeyframe)
+            m_codec.EncodeKeyframe(desc, msg.body);
+        else
+            m_codec.Encode(desc, m_mapSent[nTargetID][desc.nUniqueID], msg.body);
+        msg.header.size = uint32_t(msg.size());
+        m_statsCodec.nStatesOut++;
+        m_statsCodec.nBytesOut += msg.body.size() - nBefore;
+    }
+
+    // Send the state of a player to every other client interested in it
+    void RelayState(const sPlayerDescription &desc) {
+        auto Send = [&](uint32_t nTargetID, const std::shared_ptr<bsl::net::connection<GameMsg>> &target) {
+            if (!HasBaseline(nTargetID, desc.nUniqueID)) return;
+            // Decide once, the channel may come up in the meantime and a delta must never be sent unreliably
+            bool bDatagram = HasDatagramChannel(target);
+            bool bLatest = !bDatagram && IsBacklogged(nTargetID, target, desc.nUniqueID);
+            bsl::net::message<GameMsg> msg;
+            msg.header.id = GameMsg::Game_UpdatePlayer;
+            EncodeState(nTargetID, desc, msg, bDatagram || bLatest);
+            if (bDatagram)
+                MessageClientUnreliable(target, std::move(msg));
+            else if (bLatest)
+                MessageClientLatest(target, std::move(msg), LatestKey(GameMsg::Game_UpdatePlayer, desc.nUniqueID));
+            else
+                MessageClient(target, std::move(msg));
+        };
+
+        if (m_fInterestRadius <= 0.0f) {
+            for (uint32_t id : m_vClientIDs) {
+                auto target = m_connections.Find(id);
+                if (target && id != desc.nUniqueID) Send(id, target);
+            }
+            return;
+        }
+        for (uint32_t id : m_mapVisible[desc.nUniqueID]) {
+            auto target = m_connections.Find(id);
+            if (target) Send(id, target);
+        }
+    }
+
+    // Move a player in the interest grid. When it changes cell, exchange presence with the players that came into or
+    // went out of view. Views are the 3x3 cells around a player so visibility is symmetric
+    void UpdateInterest(const sPlayerDescription &desc) {
+        uint32_t id = desc.nUniqueID;
+        if (!m_gridInterest.Update(id, desc.vPos)) return;
+
+        m_setInView.clear();
+        olc::vi2d vCell = m_gridInterest.CellOfEntity(id);
+        m_gridInterest.QueryCells(vCell - olc::vi2d(1, 1), vCell + olc::vi2d(1, 1), [&](uint32_t other) {
+            if (other != id) m_setInView.insert(other);
+        });
+
+        auto &setVisible = m_mapVisible[id];
+
+        // Players that went out of view
+        for (auto it = setVisible.begin(); it != setVisible.end();) {
+            uint32_t other = *it;
+            if (m_setInView.count(other) == 0) {
+                QueuePresence(id, GameMsg::Game_RemovePlayer, other);
+                QueuePresence(other, GameMsg::Game_RemovePlayer, id);
+                m_mapVisible[other].erase(id);
+                it = setVisible.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // Players that came into view
+        for (uint32_t other : m_setInView) {
+            if (setVisible.insert(other).second) {
+                QueuePresence(id, GameMsg::Game_AddPlayer, other);
+                QueuePresence(other, GameMsg::Game_AddPlayer, id);
+                m_mapVisible[other].insert(id);
+            }
+        }
+    }
+
+    // A client falling behind gets keyframes of the players it already has a baseline of, so a newer state of a
+    // player replaces the one still queued. Deltas can't be replaced, each is encoded against the one before
+    bool IsBacklogged(uint32_t nTargetID, const std::shared_ptr<bsl::net::connection<GameMsg>> &target,
+                      uint32_t nSubjectID) {
+        return target->GetQueuedMessages() >= nBackloggedQueue && HasBaseline(nTargetID, nSubjectID);
+    }
+
+    // True once client nTargetID was sent player nSubjectID. Until then its states aren't sent, the add still
+    // queued carries the state the player is in when it is flushed
+    bool HasBaseline(uint32_t nTargetID, uint32_t nSubjectID) const {
+        auto sent = m_mapSent.find(nTargetID);
+        return sent != m_mapSent.end() && sent->second.count(nSubjectID) > 0;
+    }
+
+    static uint64_t LatestKey(GameMsg id, uint32_t nSubjectID) {
+        return (uint64_t(id) << 32) | nSubjectID;
+    }
+
+    // Tell client nTargetID that player nSubjectID was added or removed, with the next FlushPresence
+    void QueuePresence(uint32_t nTargetID, GameMsg id, uint32_t nSubjectID) {
+        m_mapPresence[nTargetID][nSubjectID] = id == GameMsg::Game_AddPlayer;
+    }
+
+    // Send client nTargetID one Game_RemovePlayers and one Game_AddPlayers for its queued changes. The full
+    // description becomes the baseline of the later updates. A player removed before the client was told about it
+    // is left out
+    void SendPresence(uint32_t nTargetID, const std::unordered_map<uint32_t, bool> &mapChanges) {
+        auto target = m_connections.Find(nTargetID);
+        if (!target) return;
+
+        auto &mapSent = m_mapSent[nTargetID];
+        std::vector<sPlayerDescription> vAdded;
+        std::vector<uint32_t> vRemoved;
+        for (const auto &change : mapChanges) {
+            if (change.second) {
+                auto subject = m_mapPlayerRoster.find(change.first);
+                if (subject == m_mapPlayerRoster.end()) continue;
+                vAdded.push_back(subject->second);
+                mapSent[change.first] = subject->second;
+            } else if (mapSent.erase(change.first) > 0) {
+                vRemoved.push_back(change.first);
+            }
+        }
+
+        std::vector<bsl::net::shared_message<GameMsg>> vFrames;
+        AppendPresenceFrames(GameMsg::Game_RemovePlayers, vRemoved, vFrames);
+        AppendPresenceFrames(GameMsg::Game_AddPlayers, vAdded, vFrames);
+        for (const auto &frame : vFrames) {
+            MessageClient(target, frame);
+            if (!target->IsConnected()) break;
+        }
+    }
+
+    // Send a message from a player to the clients interested in it, and to nAlsoID if that client must see it anyway
+    void MessageInterested(uint32_t nSenderID, bsl::net::message<GameMsg> &&msg, uint32_t nAlsoID = 0) {
+        if (m_fInterestRadius <= 0.0f) {
+            MessageAllClients(std::move(msg), m_connections.Find(nSenderID));
+            return;
+        }
+
+        auto frame = bsl::net::make_shared_message(std::move(msg));
+        const auto &setVisible = m_mapVisible[nSenderID];
+        for (uint32_t id : setVisible) {
+            auto target = m_connections.Find(id);
+            if (target) MessageClient(target, frame);
+        }
+
+        if (nAlsoID != 0 && nAlsoID != nSenderID && setVisible.count(nAlsoID) == 0) {
+            auto target = m_connections.Find(nAlsoID);
+            if (target) MessageClient(target, frame);
+        }
+    }
+
+    // Add the player of a client to the roster, tell it its ID and exchange presence with the other players
+    void RegisterPlayer(const std::shared_ptr<bsl::net::connection<GameMsg>> &client, sPlayerDescription desc) {
+        // The client encodes its updates against the description it registered with
+        m_mapReceived.insert_or_assign(client->GetID(), desc);
+        desc.nUniqueID = client->GetID();
+        m_mapCombat[desc.nUniqueID] = {nSpawnHealth, desc.nDeaths, desc.status == PlayerStatus::Dead};
+        if (m_mapPlayerRoster.insert_or_assign(desc.nUniqueID, desc).second)
+            m_vClientIDs.push_back(desc.nUniqueID);
+
+        // Message that return to the client the uniqueid
+        bsl::net::message<GameMsg> msgSendID;
+        msgSendID.header.id = GameMsg::Client_AssignID;
+        msgSendID << desc.nUniqueID;
+        MessageClient(client, std::move(msgSendID));
+
+        if (m_fInterestRadius > 0.0f) {
+            // The new client learns about itself and the players around it in one message now, they learn about it
+            // with the next flush
+            QueuePresence(desc.nUniqueID, GameMsg::Game_AddPlayer, desc.nUniqueID);
+            UpdateInterest(desc);
+            FlushPresence(desc.nUniqueID);
+            if (IsSharded()) CrossBorders(desc);
+            return;
+        }
+
+        // The next flush sends the new client the whole roster and every other client the new player, shared with
+        // the other clients that joined meanwhile
+        m_vJoinedIDs.push_back(desc.nUniqueID);
+    }
+
+    // Move a player in the area of interest and send its new state, now or with the next tick
+    void PublishState(const sPlayerDescription &desc) {
+        if (m_fInterestRadius > 0.0f) UpdateInterest(desc);
+
+        if (m_fTickRate > 0.0f) {
+            // Keep the latest state only, the next tick publishes it
+            m_setDirtyIDs.insert(desc.nUniqueID);
+        } else {
+            RelayState(desc);
+        }
+    }
+
+    // Send a bullet from a player, or a hit or a death of a player, to the clients interested in it, the neighbouring
+    // shards the player is mirrored to pass it on to theirs. The sufferer and the shooter of a hit always get it
+    void RelayEvent(uint32_t nSenderID, bsl::net::message<GameMsg> &&msg) {
+        // Read in place, the body goes on as it is
+        uint32_t nAlsoID = 0;
+        if (msg.header.id == GameMsg::Game_HitPlayer) {
+            sHitDescription desc;
+            if (bsl::net::message_reader<GameMsg>(msg).Read(desc)) nAlsoID = desc.nShooterID;
+        } else if (msg.header.id == GameMsg::Game_Dead) {
+            sDeadDescription desc;
+            if (bsl::net::message_reader<GameMsg>(msg).Read(desc)) nAlsoID = desc.nKillerID;
+        }
+
+        auto mirrored = m_mapMirrored.find(nSenderID);
+        if (mirrored != m_mapMirrored.end() && m_setGhostIDs.count(nSenderID) == 0) {
+            for (int32_t nSide = 0; nSide < 2; nSide++) {
+                if ((mirrored->second & (1 << nSide)) == 0) continue;
+                bsl::net::message<GameMsg> msgMirror = msg;
+                msgMirror << nSenderID;
+                m_vShards[Neighbour(nSide)]->PostMessage(std::move(msgMirror));
+            }
+        }
+        if (nAlsoID != 0) {
+            auto sufferer = m_connections.Find(nSenderID);
+            if (sufferer) MessageClient(sufferer, bsl::net::message<GameMsg>(msg));
+        }
+        MessageInterested(nSenderID, std::move(msg), nAlsoID);
+    }
+
+    bool IsSharded() const {
+        return !m_vShards.empty();
+    }
+
+    // Shard simulating the strip of the world x is in
+    int32_t ZoneOf(float x) const {
+        return std::clamp(int32_t(std::floor(x / m_fZoneWidth)), 0, int32_t(m_vShards.size()) - 1);
+    }
+
+    // Shard on the left (nSide 0) or on the right (nSide 1) of this one
+    int32_t Neighbour(int32_t nSide) const {
+        return m_nShard + (nSide == 0 ? -1 : 1);
+    }
+
+    // Hand a player that registered with the lobby to the shard of its zone. The client is transferred before the
+    // shard hears of it and its messages go to the shard before the shard can answer, so none has to be held
+    void JoinShard(const std::shared_ptr<bsl::net::connection<GameMsg>> &client, const sPlayerDescription &desc) {
+        uint32_t nID = client->GetID();
+        GameServer &shard = *m_vShards[ZoneOf(desc.vPos.x)];
+        TransferClient(client, shard);
+        bsl::net::message<GameMsg> msgJoin;
+        msgJoin.header.id = GameMsg::Shard_Join;
+        msgJoin << desc << nID;
+        shard.PostMessage(std::move(msgJoin));
+
+        bsl::net::message<GameMsg> msgCut;
+        msgCut.header.id = GameMsg::Shard_Cut;
+        msgCut << nID;
+        RedirectClient(client, shard, std::move(msgCut));
+    }
+
+    // Mirror a local player to the neighbours whose border it is close to, and hand it over once it is well inside
+    // the zone of another shard, the margin keeps a player walking along a border from bouncing between them
+    void CrossBorders(const sPlayerDescription &desc) {
+        uint32_t nID = desc.nUniqueID;
+        if (m_mapLeaving.count(nID) > 0) return;
+
+        float fLeft = float(m_nShard) * m_fZoneWidth, fRight = fLeft + m_fZoneWidth;
+        uint8_t &nMirrored = m_mapMirrored[nID];
+        for (int32_t nSide = 0; nSide < 2; nSide++) {
+            int32_t nNeighbour = Neighbour(nSide);
+            if (nNeighbour < 0 || nNeighbour >= int32_t(m_vShards.size())) continue;
+            uint8_t nBit = uint8_t(1 << nSide);
+            bool bNear = nSide == 0 ? desc.vPos.x < fLeft + m_fMirrorMargin : desc.vPos.x >= fRight - m_fMirrorMargin;
+            if (bNear) {
+                bsl::net::message<GameMsg> msg;
+                msg.header.id = GameMsg::Shard_Mirror;
+                msg << desc;
+                m_vShards[nNeighbour]->PostMessage(std::move(msg));
+                nMirrored |= nBit;
+            } else if (nMirrored & nBit) {
+                PostUnmirror(nID, nBit);
+                nMirrored &= uint8_t(~nBit);
+            }
+        }
+
+        if (desc.vPos.x < fLeft - fHandoffMargin || desc.vPos.x >= fRight + fHandoffMargin) {
+            int32_t nTarget = ZoneOf(desc.vPos.x);
+            if (nTarget != m_nShard) HandOff(nID, nTarget);
+        }
+    }
+
+    // Start handing a local player over: the target expects it, then the client's messages are redirected to the
+    // target. The player stays here until the cut comes through, after the messages the client sent before
+    void HandOff(uint32_t nID, int32_t nTarget) {
+        auto client = m_connections.Find(nID);
+        if (!client) return;
+        GameServer &target = *m_vShards[nTarget];
+
+        bsl::net::message<GameMsg> msgExpect;
+        msgExpect.header.id = GameMsg::Shard_Expect;
+        msgExpect << nID;
+        target.PostMessage(std::move(msgExpect));
+
+        bsl::net::message<GameMsg> msgCut;
+        msgCut.header.id = GameMsg::Shard_Cut;
+        msgCut << nID;
+        RedirectClient(client, target, std::move(msgCut));
+        m_mapLeaving[nID] = nTarget;
+    }
+
+    // Send a leaving player to its new shard with the baselines of its client and the players the client knows.
+    // The player stays here as a ghost the new shard mirrors back while it is near the border
+    void ShipPlayer(uint32_t nID) {
+        auto leaving = m_mapLeaving.find(nID);
+        if (leaving == m_mapLeaving.end()) return;
+        int32_t nTarget = leaving->second;
+        GameServer &target = *m_vShards[nTarget];
+        m_mapLeaving.erase(leaving);
+
+        auto player = m_mapPlayerRoster.find(nID);
+        auto client = m_connections.Find(nID);
+        if (player == m_mapPlayerRoster.end() || !client) {
+            // It left in the meantime, the target stops waiting for it
+            PostUnmirror(nID, 0, nTarget);
+            return;
+        }
+
+        // What the client knows is handed over, so it must have been told everything queued for it
+        FlushPresence(nID);
+        bool bGhost = std::abs(nTarget - m_nShard) == 1;
+        std::vector<uint32_t> vSentIDs, vVisible(m_mapVisible[nID].begin(), m_mapVisible[nID].end());
+        std::vector<sPlayerDescription> vSent;
+        for (auto &sent : m_mapSent[nID]) {
+            vSentIDs.push_back(sent.first);
+            vSent.push_back(sent.second);
+        }
+        bsl::net::message<GameMsg> msgHandoff;
+        msgHandoff.header.id = GameMsg::Shard_Handoff;
+        bsl::net::message_writer<GameMsg>(msgHandoff)
+                .Write(nID).Write(m_nShard).Write(uint8_t(bGhost))
+                .Write(player->second).Write(m_mapReceived[nID]).Write(m_mapCombat[nID])
+                .WriteArray(vSentIDs).WriteArray(vSent).WriteArray(vVisible);
+        TransferClient(client, target);
+        target.PostMessage(std::move(msgHandoff));
+
+        // The other neighbour, if it mirrors the player, lets go of it
+        auto mirrored = m_mapMirrored.find(nID);
+        if (mirrored != m_mapMirrored.end()) {
+            for (int32_t nSide = 0; nSide < 2; nSide++)
+                if (Neighbour(nSide) == nTarget) mirrored->second &= uint8_t(~(1 << nSide));
+            PostUnmirror(nID, mirrored->second);
+            m_mapMirrored.erase(mirrored);
+        }
+
+        m_vClientIDs.erase(std::remove(m_vClientIDs.begin(), m_vClientIDs.end(), nID), m_vClientIDs.end());
+        m_mapReceived.erase(nID);
+        m_mapSent.erase(nID);
+        m_mapCombat.erase(nID);
+        if (bGhost) {
+            m_setGhostIDs.insert(nID);
+        } else {
+            m_mapPlayerRoster.erase(player);
+            m_vGarbageIDs.push_back(nID);
+        }
+    }
+
+    // Take a player handed over by another shard. Its client is told about the players it should see here and no
+    // longer about the ones it shouldn't, then the messages it sent on the way are handled
+    void ArrivePlayer(const bsl::net::message<GameMsg> &msg) {
+        uint32_t nID = 0;
+        int32_t nFrom = 0;
+        uint8_t bGhost = 0;
+        sPlayerDescription desc, received;
+        combat_state combat;
+        std::vector<uint32_t> vSentIDs, vKnown;
+        std::vector<sPlayerDescription> vSent;
+        bsl::net::message_reader<GameMsg> reader(msg);
+        reader.Read(nID);
+        reader.Read(nFrom);
+        reader.Read(bGhost);
+        reader.Read(desc);
+        reader.Read(received);
+        reader.Read(combat);
+        reader.ReadArray(vSentIDs);
+        reader.ReadArray(vSent, vSentIDs.size());
+        reader.ReadArray(vKnown);
+
+        std::vector<bsl::net::message<GameMsg>> vHeld;
+        auto arriving = m_mapArriving.find(nID);
+        if (arriving != m_mapArriving.end()) {
+            vHeld = std::move(arriving->second);
+            m_mapArriving.erase(arriving);
+        }
+        if (!reader.Good() || vSent.size() != vSentIDs.size()) return;
+
+        // A ghost of the player becomes the player, moved in the area of interest before its client is here so the
+        // client isn't told anything twice
+        m_setGhostIDs.erase(nID);
+        m_mapPlayerRoster.insert_or_assign(nID, desc);
+        UpdateInterest(desc);
+        auto client = AcceptTransfer(nID);
+        if (!client) {
+            m_mapPlayerRoster.erase(nID);
+            m_vGarbageIDs.push_back(nID);
+            return;
+        }
+        m_vClientIDs.push_back(nID);
+        m_mapReceived.insert_or_assign(nID, received);
+        m_mapCombat[nID] = combat;
+        auto &mapSent = m_mapSent[nID];
+        mapSent.clear();
+        for (size_t i = 0; i < vSent.size(); i++) mapSent[vSentIDs[i]] = vSent[i];
+        if (bGhost) m_mapMirrored[nID] = uint8_t(1 << (nFrom < m_nShard ? 0 : 1));
+
+        // What moving it in the area of interest queued for it is replaced by the difference with what it knows
+        m_mapPresence.erase(nID);
+        std::unordered_set<uint32_t> setKnown(vKnown.begin(), vKnown.end());
+        std::vector<uint32_t> vVisible(m_mapVisible[nID].begin(), m_mapVisible[nID].end());
+        for (uint32_t other : vKnown)
+            if (m_mapVisible[nID].count(other) == 0) QueuePresence(nID, GameMsg::Game_RemovePlayer, other);
+        for (uint32_t other : vVisible)
+            if (setKnown.count(other) == 0) QueuePresence(nID, GameMsg::Game_AddPlayer, other);
+
+        for (auto &msgHeld : vHeld) OnMessage(client, msgHeld);
+    }
+
+    // Update the ghost of a player a neighbour simulates, its state reaches the clients here like a local one's
+    void MirrorPlayer(const sPlayerDescription &desc) {
+        auto player = m_mapPlayerRoster.find(desc.nUniqueID);
+        if (player == m_mapPlayerRoster.end()) {
+            player = m_mapPlayerRoster.emplace(desc.nUniqueID, desc).first;
+            m_setGhostIDs.insert(desc.nUniqueID);
+        } else if (m_setGhostIDs.count(desc.nUniqueID) > 0) {
+            player->second = desc;
+        } else {
+            return;
+        }
+        PublishState(player->second);
+    }
+
+    // Tell the neighbours on nSides, and shard nAlso, that player nID is no longer mirrored to them
+    void PostUnmirror(uint32_t nID, uint8_t nSides, int32_t nAlso = nLobby) {
+        for (int32_t nSide = 0; nSide < 2; nSide++) {
+            if ((nSides & (1 << nSide)) == 0 || Neighbour(nSide) == nAlso) continue;
+            bsl::net::message<GameMsg> msg;
+            msg.header.id = GameMsg::Shard_Unmirror;
+            msg << nID;
+            m_vShards[Neighbour(nSide)]->PostMessage(std::move(msg));
+        }
+        if (nAlso != nLobby) {
+            bsl::net::message<GameMsg> msg;
+            msg.header.id = GameMsg::Shard_Unmirror;
+            msg << nID;
+            m_vShards[nAlso]->PostMessage(std::move(msg));
+        }
+    }
+
+    float m_fTickRate = 0.0f;
+    bool m_bReplaying = false;
+
+    // Thresholds of the BUSY status, load in percent and messages queued
+    static constexpr float fBusyLoad = 50.0f;
+    static constexpr size_t nBusyQueueDepth = 1000;
+
+    // Messages queued for a client before its player states are coalesced
+    static constexpr size_t nBackloggedQueue = 64;
+
+    // Load of the last full second, and the window being measured
+    sServerMetrics m_metrics;
+    struct load_window {
+        std::chrono::steady_clock::time_point tpStart = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration tpTick{0};
+        uint64_t nOverruns = 0;
+        uint64_t nLastOverruns = 0;
+        // Message counters when the window started
+        bsl::net::message_stats statsStart;
+    } m_windowLoad;
+
+    // Periodic metrics dump, counters of every message type at the last one
+    static constexpr size_t nReportConnections = 5;
+    float m_fMetricsInterval = 5.0f;
+    std::ofstream m_fileMetrics;
+    std::chrono::steady_clock::time_point m_tpMetricsReport = std::chrono::steady_clock::now();
+    std::vector<bsl::net::message_stats> m_vMetricsReported;
+
+    // Bullets in flight, moved in fixed steps of fBulletStep seconds and dropped after fBulletLifetime seconds,
+    // the map doesn't stop them past its edges
+    static constexpr float fBulletStep = 1.0f / 60.0f;
+    static constexpr int nMaxBulletSteps = 4;
+    static constexpr float fBulletLifetime = 3.0f;
+    static constexpr float fBulletRadius = 0.2f;
+    static constexpr uint32_t nBulletDamage = 5;
+    // What a player's bullets are held to: how far from it they leave, how fast, how often and how many walls
+    // they bounce off, whatever its client says
+    static constexpr float fBulletReach = 1.5f;
+    static constexpr float fBulletSpeed = 20.0f;
+    static constexpr float fMaxPlayerRadius = 0.5f;
+    static constexpr float fMaxPlayerSpeed = 10.0f;
+    static constexpr uint8_t nMaxRof = 5;
+    static constexpr int nBulletBurst = 2;
+    static constexpr int nMaxBulletBounces = 1;
+    // Health a player (re)spawns with
+    static constexpr uint32_t nSpawnHealth = 100;
+    BulletPool m_poolBullets;
+    std::chrono::steady_clock::time_point m_tpBulletStep;
+    // Players the bullets can hit, bucketed for each step
+    SpatialHash m_gridTargets{2.0f};
+
+    // Health of the local players, and whether they are dead until their client counts nDeaths deaths
+    struct combat_state {
+        uint32_t nHealth = 0;
+        uint32_t nDeaths = 0;
+        bool bDead = false;
+        // Earliest the next shot is due at the rate of fire of the player
+        std::chrono::steady_clock::time_point tpNextShot{};
+    };
+    std::unordered_map<uint32_t, combat_state> m_mapCombat;
+
+    struct bullet_stats {
+        uint64_t nFired = 0;
+        uint64_t nHits = 0;
+        uint64_t nDeaths = 0;
+        std::chrono::steady_clock::time_point tpReport = std::chrono::steady_clock::now();
+    } m_statsBullets;
+
+    // World map, with the chunks around the players streamed in
+    CollisionMap m_mapCollision;
+    std::vector<olc::vf2d> m_vStreamCenters;
+    std::chrono::steady_clock::time_point m_tpStreamed;
+    std::chrono::steady_clock::time_point m_tpMapReport;
+
+    // Area of interest, players are bucketed by position and each player sees the players in the cells around it
+    float m_fInterestRadius = 0.0f;
+    SpatialHash m_gridInterest;
+    std::unordered_map<uint32_t, std::unordered_set<uint32_t>> m_mapVisible;
+    std::unordered_set<uint32_t> m_setInView;
+
+    // Sharding. The lobby owns the listener and hands every player to the shard of its zone, a shard simulates its
+    // strip of the world and mirrors the players near a border to the neighbour behind it, where they are ghosts
+    static constexpr int32_t nLobby = -1;
+    // World width split into zones when there is no map, the default area of MMO_Bot
+    static constexpr float fDefaultWorldWidth = 64.0f;
+    // A player is handed over once this many tiles into another zone
+    static constexpr float fHandoffMargin = 1.0f;
+    int32_t m_nShard = nLobby;
+    std::vector<GameServer *> m_vShards;
+    float m_fZoneWidth = 0.0f;
+    float m_fMirrorMargin = 0.0f;
+    std::unordered_set<uint32_t> m_setGhostIDs;
+    // Neighbours each local player is mirrored to, bit 0 is the left one and bit 1 the right one
+    std::unordered_map<uint32_t, uint8_t> m_mapMirrored;
+    // Players on their way to another shard and where to, players on their way here and what they sent meanwhile
+    std::unordered_map<uint32_t, int32_t> m_mapLeaving;
+    std::unordered_map<uint32_t, std::vector<bsl::net::message<GameMsg>>> m_mapArriving;
+    // Put in front of the reports, empty unless sharded
+    std::string m_sTag;
+
+    // IDs of the registered players, which are also the handles of their connections in the registry
+    std::vector<uint32_t> m_vClientIDs;
+
+    // Player state codec baselines, the last state received from each client and, per client, the last state it
+    // was sent for every player it knows about
+    PlayerStateCodec m_codec;
+    std::unordered_map<uint32_t, sPlayerDescription> m_mapReceived;
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, sPlayerDescription>> m_mapSent;
+
+    // Presence changes waiting for FlushPresence: the players that joined without an area of interest, the players
+    // that left, and per client the players that came into view, true, or went out of it, false. The last change of
+    // a player wins
+    std::vector<uint32_t> m_vJoinedIDs;
+    std::vector<uint32_t> m_vLeftIDs;
+    std::unordered_map<uint32_t, std::unordered_map<uint32_t, bool>> m_mapPresence;
+
+    struct codec_stats {
+        uint64_t nStatesIn = 0;
+        uint64_t nBytesIn = 0;
+        uint64_t nStatesOut = 0;
+        uint64_t nBytesOut = 0;
+        std::chrono::steady_clock::time_point tpReport = std::chrono::steady_clock::now();
+    } m_statsCodec;
+
+    // Players whose state changed since the last tick
+    std::unordered_set<uint32_t> m_setDirtyIDs;
+
+    struct tick_stats {
+        uint64_t nTicks = 0;
+        uint64_t nOverruns = 0;
+        uint64_t nSnapshotPlayers = 0;
+        std::chrono::steady_clock::duration tpTotal{0};
+        std::chrono::steady_clock::duration tpMax{0};
+        std::chrono::steady_clock::time_point tpReport = std::chrono::steady_clock::now();
+    } m_statsTick;
+
 protected:
     bool OnClientConnect(std::shared_ptr<bsl::net::connection<GameMsg>> client) override {
         // Just allow all
@@ -26,7 +1287,7 @@ protected:
         // Client passed the validation check, so send the accept message
         bsl::net::message<GameMsg> msg;
         msg.header.id = GameMsg::Client_Accept;
-        client->Send(msg);
+        client->Send(std::move(msg));
     }
 
     void OnClientDisconnect(std::shared_ptr<bsl::net::connection<GameMsg>> client) override {
@@ -45,61 +1306,66 @@ protected:
 
     void OnMessage(std::shared_ptr<bsl::net::connection<GameMsg>> client, bsl::net::message<GameMsg>& msg) override {
         // Before do anything on message handle, clear the garbage first
-        if (!m_vGarbageIDs.empty()) {
-            for (auto pid : m_vGarbageIDs) {
-                bsl::net::message<GameMsg> m;
-                m.header.id = GameMsg::Game_RemovePlayer;
-                m << pid;
-                std::cout << "[Remove]: " << pid << "\n";
-                // Send remove player message to every client
-                MessageAllClients(m);
+        FlushGarbage();
+
+        // Posted by the lobby or another shard
+        if (!client) {
+            OnShardMessage(msg);
+            return;
+        }
+
+        if (IsSharded()) {
+            // The player is on its way here, its messages wait for it
+            auto arriving = m_mapArriving.find(client->GetID());
+            if (arriving != m_mapArriving.end()) {
+                arriving->second.push_back(std::move(msg));
+                return;
             }
-            m_vGarbageIDs.clear();
+            // The player moved on to another shard, this is a datagram that was already on its way
+            if (m_setGhostIDs.count(client->GetID()) > 0) return;
         }
 
         // Now we can handle different message
         switch (msg.header.id) {
             // When Client send ping message, just bounce back the message
             case GameMsg::Server_GetPing: {
-                MessageClient(client, msg);
+                MessageClient(client, std::move(msg));
                 break;
             }
 
             // When Client send get status message, return the status of the message
             case GameMsg::Server_GetStatus: {
+                // The status goes first, a client that only reads the status ignores the metrics after it
+                // A replay answers with empty metrics, they would describe the machine replaying, not the session,
+                // and make two replays differ
+                sServerMetrics metrics;
+                ServerStatus status = ServerStatus::IDLE;
+                if (!m_bReplaying) {
+                    metrics = m_metrics;
+                    metrics.nIncomingDepth = uint32_t(GetIncomingDepth());
+                    metrics.nOutgoingDepth = uint32_t(OutgoingDepth());
+                    status = getServerStatus();
+                }
                 bsl::net::message<GameMsg> msgStatus;
                 msgStatus.header.id = GameMsg::Server_GetStatus;
-                msgStatus << getServerStatus();
-                MessageClient(client, msgStatus);
+                bsl::net::message_writer<GameMsg>(msgStatus, sizeof(ServerStatus) + sizeof(metrics))
+                        .Write(status)
+                        .Write(metrics);
+                MessageClient(client, std::move(msgStatus));
                 break;
             }
 
             // When Client want to register to the server
             case GameMsg::Client_RegisterWithServer: {
+                // A message that isn't exactly a description is dropped
                 sPlayerDescription desc;
-                msg >> desc;
-                desc.nUniqueID = client->GetID();
-                m_mapPlayerRoster.insert_or_assign(desc.nUniqueID, desc);
-
-                // Message that return to the client the uniqueid
-                bsl::net::message<GameMsg> msgSendID;
-                msgSendID.header.id = GameMsg::Client_AssignID;
-                msgSendID << desc.nUniqueID;
-                MessageClient(client, msgSendID);
-
-                // Send the player description to all the client
-                bsl::net::message<GameMsg> msgAddPlayer;
-                msgAddPlayer.header.id = GameMsg::Game_AddPlayer;
-                msgAddPlayer << desc;
-                MessageAllClients(msgAddPlayer);
-
-                // Send other players' description to eh new client
-                for (const auto& player : m_mapPlayerRoster) {
-                    bsl::net::message<GameMsg> msgAddOtherPlayers;
-                    msgAddOtherPlayers.header.id = GameMsg::Game_AddPlayer;
-                    msgAddOtherPlayers << player.second;
-                    MessageClient(client, msgAddOtherPlayers);
+                if (msg.body.size() != sizeof(desc) || !bsl::net::message_reader<GameMsg>(msg).Read(desc)) break;
+                if (m_nShard == nLobby && IsSharded()) {
+                    // Once only, the client belongs to a shard after that
+                    if (m_connections.Find(client->GetID()) == client) JoinShard(client, desc);
+                    break;
                 }
+                RegisterPlayer(client, desc);
                 break;
             }
 
@@ -110,37 +1376,199 @@ protected:
 
             // When Player updated
             case GameMsg::Game_UpdatePlayer: {
-                MessageAllClients(msg, client);
+                // Keep the roster current, the id is always the sender's
+                auto player = m_mapPlayerRoster.find(client->GetID());
+                if (player == m_mapPlayerRoster.end()) break;
+                // Keyframes come over the datagram channel and leave the baseline of the TCP stream alone
+                const uint8_t *p = msg.body.data();
+                uint32_t nID = 0;
+                bool bKeyframe = false;
+                if (!PlayerStateCodec::Peek(p, p + msg.body.size(), nID, bKeyframe)) break;
+                sPlayerDescription keyframe;
+                auto &received = bKeyframe ? keyframe : m_mapReceived[client->GetID()];
+                if (!m_codec.Decode(p, p + msg.body.size(), received)) break;
+                m_statsCodec.nStatesIn++;
+                m_statsCodec.nBytesIn += msg.body.size();
+                // Datagrams may come late or twice, a keyframe not newer than the state held is dropped
+                if (bKeyframe && int32_t(received.nSequence - player->second.nSequence) <= 0) break;
+                player->second = received;
+                player->second.nUniqueID = client->GetID();
+                ApplyCombat(player->second);
+
+                PublishState(player->second);
+                if (IsSharded()) CrossBorders(player->second);
                 break;
             }
 
-            // When Player Fire a bullet
+            // When Player Fire a bullet, the server simulates it and decides who it hits
             case GameMsg::Game_FireBullet: {
-                MessageAllClients(msg, client);
+                if (m_mapPlayerRoster.count(client->GetID()) == 0) break;
+                if (LaunchBullet(client->GetID(), msg)) RelayEvent(client->GetID(), std::move(msg));
                 break;
             }
 
-            // When Player hit someone
-            // msg is shooter, sufferer, damage
-            case GameMsg::Game_HitPlayer: {
-                MessageAllClients(msg, client);
+            // Hits and deaths are resolved by the server, the ones clients report are ignored
+            case GameMsg::Game_HitPlayer:
+            case GameMsg::Game_Dead: {
+                break;
+            }
+        }
+    }
+
+    // Messages between the lobby and the shards
+    void OnShardMessage(bsl::net::message<GameMsg> &msg) {
+        switch (msg.header.id) {
+            case GameMsg::Shard_Join: {
+                uint32_t nID = 0;
+                sPlayerDescription desc;
+                msg >> nID >> desc;
+                auto client = AcceptTransfer(nID);
+                if (client) RegisterPlayer(client, desc);
                 break;
             }
 
+            case GameMsg::Shard_Expect: {
+                uint32_t nID = 0;
+                msg >> nID;
+                m_mapArriving[nID];
+                break;
+            }
+
+            case GameMsg::Shard_Cut: {
+                uint32_t nID = 0;
+                msg >> nID;
+                ShipPlayer(nID);
+                break;
+            }
+
+            case GameMsg::Shard_Handoff: {
+                ArrivePlayer(msg);
+                break;
+            }
+
+            case GameMsg::Shard_Mirror: {
+                sPlayerDescription desc;
+                msg >> desc;
+                MirrorPlayer(desc);
+                break;
+            }
+
+            case GameMsg::Shard_Unmirror: {
+                uint32_t nID = 0;
+                msg >> nID;
+                // A player that left on its way here isn't coming
+                m_mapArriving.erase(nID);
+                if (m_setGhostIDs.count(nID) > 0) {
+                    m_mapPlayerRoster.erase(nID);
+                    m_vGarbageIDs.push_back(nID);
+                }
+                break;
+            }
+
+            // Events of a mirrored player, followed by its ID. Its bullets are simulated here too, to hit the local
+            // players
+            case GameMsg::Game_FireBullet:
+            case GameMsg::Game_HitPlayer:
             case GameMsg::Game_Dead: {
-                MessageAllClients(msg, client);
+                uint32_t nSenderID = 0;
+                msg >> nSenderID;
+                if (m_setGhostIDs.count(nSenderID) == 0) break;
+                if (msg.header.id == GameMsg::Game_FireBullet && !LaunchBullet(nSenderID, msg)) break;
+                RelayEvent(nSenderID, std::move(msg));
                 break;
             }
+
+            default:
+                break;
         }
     }
 };
 
-int main() {
+int main(int argc, char *argv[]) {
+    // Options are given as "--name value" pairs
+    size_t nIOThreads = 1;
+    float fTickRate = 0.0f;
+    float fInterestRadius = 0.0f;
+    bool bDatagrams = false;
+    std::string sMap;
+    float fMetricsInterval = 5.0f;
+    std::string sMetricsFile;
+    size_t nOutMaxMessages = 4096;
+    size_t nOutMaxKB = 4096;
+    size_t nMaxMessageKB = bsl::net::nDefaultMaxMessageSize / 1024;
+    size_t nShards = 1;
+    float fZoneWidth = 0.0f;
+    std::string sRecord, sReplay;
+    float fReplaySpeed = 0.0f;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string sOption = argv[i];
+        if (sOption == "--io-threads") nIOThreads = std::stoul(argv[i + 1]);
+        if (sOption == "--tick-rate") fTickRate = std::stof(argv[i + 1]);
+        if (sOption == "--aoi-radius") fInterestRadius = std::stof(argv[i + 1]);
+        if (sOption == "--udp") bDatagrams = std::stoi(argv[i + 1]) != 0;
+        if (sOption == "--map") sMap = argv[i + 1];
+        if (sOption == "--metrics-interval") fMetricsInterval = std::stof(argv[i + 1]);
+        if (sOption == "--metrics-file") sMetricsFile = argv[i + 1];
+        if (sOption == "--out-max-messages") nOutMaxMessages = std::stoul(argv[i + 1]);
+        if (sOption == "--out-max-kb") nOutMaxKB = std::stoul(argv[i + 1]);
+        if (sOption == "--max-message-kb") nMaxMessageKB = std::stoul(argv[i + 1]);
+        if (sOption == "--shards") nShards = std::stoul(argv[i + 1]);
+        if (sOption == "--zone-width") fZoneWidth = std::stof(argv[i + 1]);
+        if (sOption == "--record") sRecord = argv[i + 1];
+        if (sOption == "--replay") sReplay = argv[i + 1];
+        if (sOption == "--replay-speed") fReplaySpeed = std::stof(argv[i + 1]);
+    }
+    if (nShards > 1 && fInterestRadius <= 0.0f) {
+        std::cout << "[Shards] sharding needs an area of interest, give --aoi-radius\n";
+        return 1;
+    }
+    if (nShards > 1 && (!sRecord.empty() || !sReplay.empty())) {
+        std::cout << "[Shards] sessions are recorded and replayed on a single zone\n";
+        return 1;
+    }
+
+    // Replay a recorded session instead of serving, with the settings of the server that recorded it
+    if (!sReplay.empty()) {
+        GameServer replay;
+        replay.SetTickRate(fTickRate);
+        replay.SetInterestRadius(fInterestRadius);
+        replay.SetMetricsReport(fMetricsInterval, sMetricsFile);
+        if (!sMap.empty() && !replay.LoadMap(sMap)) return 1;
+        return replay.Replay(sReplay, fReplaySpeed) ? 0 : 1;
+    }
+
     GameServer server(2696);
-    server.Start();
+    server.SetMetricsReport(fMetricsInterval, sMetricsFile);
+    server.SetOutgoingLimits(nOutMaxMessages, nOutMaxKB * 1024);
+    server.SetMaxMessageSize(uint32_t(nMaxMessageKB * 1024));
+    if (bDatagrams) server.EnableDatagrams();
+    if (!sRecord.empty() && !server.RecordSession(sRecord)) {
+        std::cout << "[Record] can't write " << sRecord << "\n";
+        return 1;
+    }
 
-    while (1) {
-        server.Update(-1, true);
+    // Sharded, the server is the lobby and every shard simulates its zone on a thread of its own
+    std::vector<std::unique_ptr<GameServer>> vShards;
+    std::vector<std::thread> vShardThreads;
+    if (nShards > 1) {
+        std::vector<GameServer *> vShardPointers;
+        for (size_t i = 0; i < nShards; i++) {
+            vShards.push_back(std::make_unique<GameServer>(server, int32_t(i)));
+            vShards.back()->SetTickRate(fTickRate);
+            vShards.back()->SetInterestRadius(fInterestRadius);
+            vShards.back()->SetMetricsReport(fMetricsInterval, sMetricsFile);
+            if (!sMap.empty() && !vShards.back()->LoadMap(sMap)) return 1;
+            vShardPointers.push_back(vShards.back().get());
+        }
+        server.SetShards(vShardPointers, fZoneWidth);
+    } else {
+        server.SetTickRate(fTickRate);
+        server.SetInterestRadius(fInterestRadius);
+        if (!sMap.empty() && !server.LoadMap(sMap)) return 1;
     }
+    server.Start(nIOThreads);
+
+    for (auto &pShard : vShards) vShardThreads.emplace_back([&shard = *pShard]() { shard.Run(); });
+    server.Run();
     return 0;
 }
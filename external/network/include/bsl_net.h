@@ -1,8 +1,13 @@
 #pragma once
 
 #include "net_common.h"
+#include "net_pool.h"
 #include "net_tsqueue.h"
+#include "net_mpscqueue.h"
 #include "net_message.h"
+#include "net_datagram.h"
 #include "net_client.h"
+#include "net_registry.h"
+#include "net_recorder.h"
 #include "net_server.h"
 #include "net_connection.h"
\ No newline at end of file
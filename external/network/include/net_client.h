@@ -1,13 +1,18 @@
 #pragma once
 
 #include "net_common.h"
+#include "net_datagram.h"
 
 namespace bsl {
     namespace net {
         template<typename T>
         class client_interface {
         public:
-            client_interface() {}
+            client_interface() : m_contextOwned(std::make_unique<asio::io_context>()), m_context(*m_contextOwned) {}
+
+            // Run the connection on a context shared with other clients, whoever owns it runs it. Many clients then
+            // share a few threads, the context must be stopped before the clients are destroyed
+            explicit client_interface(asio::io_context &context) : m_context(context) {}
 
             virtual ~client_interface() {
                 // If the client is destroyed, disconnect from server
@@ -27,10 +32,21 @@ namespace bsl {
                                                                    asio::ip::tcp::socket(m_context), m_qMessagesIn);
 
                     // Tell the connection object to connect to server
+                    m_connection->SetMaxMessageSize(m_nMaxMessageSize);
                     m_connection->ConnectToServer(endpoints);
 
+                    if (m_bDatagrams) {
+                        // The server listens for datagrams on the same port
+                        m_endpointDatagrams = asio::ip::udp::endpoint(endpoints.begin()->endpoint().address(), port);
+                        m_datagrams = std::make_unique<datagram_socket<T>>(
+                                m_context, asio::ip::udp::endpoint(m_endpointDatagrams.protocol(), 0));
+                        WaitForDatagrams();
+                        m_timerBind = std::make_unique<asio::steady_timer>(m_context);
+                        BindDatagrams();
+                    }
+
                     // Start Context Thread
-                    thrContext = std::thread([this]() { m_context.run(); });
+                    if (m_contextOwned) thrContext = std::thread([this]() { m_context.run(); });
                 }
                 catch (std::exception &e) {
                     std::cerr << "Client Exception: " << e.what() << "\n";
@@ -46,13 +62,15 @@ namespace bsl {
                     m_connection->Disconnect();
                 }
 
-                // Stop the asio context and it's thread
-                m_context.stop();
+                // Stop the asio context and it's thread, a shared context is left to its owner
+                if (m_contextOwned) m_context.stop();
                 if (thrContext.joinable())
                     thrContext.join();
 
                 // Destroy the connection object
                 m_connection.release();
+                m_timerBind.reset();
+                m_datagrams.reset();
             }
 
             // Check if client is actually connected to a server
@@ -70,21 +88,113 @@ namespace bsl {
                     m_connection->Send(msg);
             }
 
+            void Send(message <T> &&msg) {
+                if (IsConnected())
+                    m_connection->Send(std::move(msg));
+            }
+
+            // Send a shared frame to server
+            void Send(const shared_message <T> &msg) {
+                if (IsConnected())
+                    m_connection->Send(msg);
+            }
+
+            // Largest message body accepted from the server, call before Connect
+            void SetMaxMessageSize(uint32_t nMaxBytes) {
+                m_nMaxMessageSize = nMaxBytes;
+            }
+
+            // Ask for an unreliable UDP channel next to the connection, call before Connect.
+            // It is used once the server has answered, if it never does everything keeps going over TCP
+            void EnableDatagrams() {
+                m_bDatagrams = true;
+            }
+
+            // True once a datagram from the server got through
+            bool IsDatagramBound() {
+                return IsConnected() && m_connection->GetDatagramPeer().bBound.load(std::memory_order_acquire);
+            }
+
+            // Send a message that only matters until a newer one is sent, over UDP when the channel is bound and
+            // the message fits, over TCP otherwise
+            void SendUnreliable(const message <T> &msg) {
+                if (!SendDatagram(msg)) Send(msg);
+            }
+
+            void SendUnreliable(message <T> &&msg) {
+                if (!SendDatagram(msg)) Send(std::move(msg));
+            }
+
             // Retrieve queue of messages from server
-            tsqueue <owned_message<T>> &Incoming() {
+            mpscqueue<owned_message<T>> &Incoming() {
                 return m_qMessagesIn;
             }
 
         protected:
-            // asio context handles the data transfer and a thread to run asio context
-            asio::io_context m_context;
+            // asio context handles the data transfer and a thread to run asio context, unless the context is shared
+            std::unique_ptr<asio::io_context> m_contextOwned;
+            asio::io_context &m_context;
             std::thread thrContext;
             // The client has a single instance of a "connection" object, which handles data transfer
             std::unique_ptr<connection < T>> m_connection;
 
         private:
-            // This is the thread safe queue of incoming messages from server
-            tsqueue <owned_message<T>> m_qMessagesIn;
+            bool SendDatagram(const message <T> &msg) {
+                if (!IsDatagramBound()) return false;
+                auto &peer = m_connection->GetDatagramPeer();
+                datagram_header header;
+                header.nToken = peer.nToken;
+                header.nSequence = peer.nSequenceOut++;
+                return m_datagrams->Send(m_endpointDatagrams, header, &msg);
+            }
+
+            // ASYNC - Receive datagrams from the server, the first one also confirms the channel works
+            void WaitForDatagrams() {
+                m_datagrams->StartReceive([this](const asio::ip::udp::endpoint &endpoint, const datagram_header &header,
+                                                 message <T> *msg) {
+                    if (!m_connection || endpoint != m_endpointDatagrams) return;
+                    auto &peer = m_connection->GetDatagramPeer();
+                    if (header.nToken == 0 || header.nToken != peer.nToken) return;
+                    peer.bBound.store(true, std::memory_order_release);
+
+                    if (msg && peer.Accept(header.nSequence))
+                        m_qMessagesIn.push_back({nullptr, std::move(*msg), std::chrono::steady_clock::now()});
+                });
+            }
+
+            // ASYNC - Send bind requests a few times a second until the server answers or the connection ends.
+            // Requests wait for the handshake, the token is its answer
+            void BindDatagrams() {
+                m_timerBind->expires_after(std::chrono::milliseconds(250));
+                m_timerBind->async_wait([this](std::error_code ec) {
+                    if (ec || !m_connection) return;
+                    auto &peer = m_connection->GetDatagramPeer();
+                    if (peer.bBound.load(std::memory_order_acquire)) return;
+
+                    uint64_t nToken = peer.nToken.load();
+                    if (nToken != 0) {
+                        datagram_header header;
+                        header.nToken = nToken;
+                        header.nSequence = peer.nSequenceOut++;
+                        header.nFlags = datagram_bind;
+                        m_datagrams->Send(m_endpointDatagrams, header, nullptr);
+                    } else if (!m_connection->IsConnected()) {
+                        return;
+                    }
+                    BindDatagrams();
+                });
+            }
+
+            uint32_t m_nMaxMessageSize = nDefaultMaxMessageSize;
+
+            // Unreliable channel to the server
+            bool m_bDatagrams = false;
+            asio::ip::udp::endpoint m_endpointDatagrams;
+            std::unique_ptr<datagram_socket<T>> m_datagrams;
+            std::unique_ptr<asio::steady_timer> m_timerBind;
+
+            // This is the lock free queue of incoming messages from server, the game loop is its only consumer
+            mpscqueue<owned_message<T>> m_qMessagesIn;
         };
     }
 }
\ No newline at end of file
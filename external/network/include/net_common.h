@@ -3,6 +3,7 @@
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <deque>
 #include <optional>
 #include <vector>
@@ -10,6 +11,8 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <atomic>
+#include <array>
 
 #ifdef _WIN32
 #define _WIN32_WINNT 0x0A00
@@ -2,14 +2,49 @@
 
 #include "net_common.h"
 #include "net_tsqueue.h"
+#include "net_mpscqueue.h"
 #include "net_message.h"
+#include "net_datagram.h"
 
+#include <unordered_map>
 
 namespace bsl {
     namespace net {
         // TODO: Forward declare
         template<typename T>
         class server_interface;
+
+        // Counters for the coalesced write path
+        struct write_stats {
+            // Number of flushes, and the messages and bytes they carried in total
+            std::atomic<uint64_t> nFlushes{0};
+            std::atomic<uint64_t> nMessages{0};
+            std::atomic<uint64_t> nBytes{0};
+            std::atomic<uint64_t> nLargestFlush{0};
+            // Latest state messages that replaced a queued one instead of being sent
+            std::atomic<uint64_t> nReplaced{0};
+
+            // Messages per flush, bucket i counts flushes that carried [2^i, 2^(i+1)) messages
+            std::array<std::atomic<uint64_t>, 8> nFlushHistogram{};
+
+            void Record(size_t nFlushMessages, size_t nFlushBytes) {
+                nFlushes++;
+                nMessages += nFlushMessages;
+                nBytes += nFlushBytes;
+                if (nFlushMessages > nLargestFlush) nLargestFlush = nFlushMessages;
+
+                size_t nBucket = 0;
+                while ((nFlushMessages >> (nBucket + 1)) > 0 && nBucket + 1 < nFlushHistogram.size()) nBucket++;
+                nFlushHistogram[nBucket]++;
+            }
+        };
+
+        // Counters for the messages read from the socket
+        struct read_stats {
+            std::atomic<uint64_t> nMessages{0};
+            std::atomic<uint64_t> nBytes{0};
+        };
+
         template<typename T>
         class connection : public std::enable_shared_from_this<connection<T>> {
         public:
@@ -22,9 +57,11 @@ namespace bsl {
         public:
             // Constructor: Specify Owner, connect to context, transfer the socket, incoming message queue
             connection(owner parent, asio::io_context &asioContext, asio::ip::tcp::socket socket,
-                       tsqueue <owned_message<T>> &qIn)
-                    : m_asioContext(asioContext), m_socket(std::move(socket)), m_qMessagesIn(qIn) {
+                       mpscqueue<owned_message<T>> &qIn)
+                    : m_socket(std::move(socket)), m_asioContext(asioContext), m_strand(asioContext),
+                      m_pMessagesIn(&qIn) {
                 m_nOwnerType = parent;
+                m_bConnected = m_socket.is_open();
 
                 // Construct validation check data
                 if (m_nOwnerType == owner::server) {
@@ -40,6 +77,15 @@ namespace bsl {
                 }
             }
 
+            // A server connection without a remote, standing in for a recorded client while its session is replayed.
+            // It stays connected until Disconnect, and what is sent to it is counted, digested and dropped at once
+            connection(asio::io_context &asioContext, mpscqueue<owned_message<T>> &qIn, uint32_t nID)
+                    : m_socket(asioContext), m_asioContext(asioContext), m_strand(asioContext), m_pMessagesIn(&qIn) {
+                m_bSink = true;
+                m_bConnected = true;
+                id = nID;
+            }
+
             virtual ~connection() {}
 
             // This ID is used system wide
@@ -52,6 +98,7 @@ namespace bsl {
                 if (m_nOwnerType == owner::server) {
                     if (m_socket.is_open()) {
                         id = uid;
+                        m_pServer = server;
                         // Was: ReadHeader
                         // Only Server can call this function, so we need to write validation message to client
                         WriteValidation();
@@ -67,26 +114,32 @@ namespace bsl {
                 // Only clients can connect to servers
                 if (m_nOwnerType == owner::client) {
                     // Request asio attempts to connect to an endpoint
+                    m_bConnected = true;
                     asio::async_connect(m_socket, endpoints,
-                                        [this](std::error_code ec, asio::ip::tcp::endpoint endpoint) {
-                                            if (!ec) {
+                                        OnStrand([this](std::error_code ec, asio::ip::tcp::endpoint endpoint) {
+                                            if (ec) {
+                                                m_bConnected = false;
+                                            } else {
                                                 // Before read header, we need to do the validation
                                                 // Client only need to read the validation message
                                                 // Was: ReadHeader
                                                 ReadValidation();
                                             }
-                                        });
+                                        }));
                 }
             }
 
 
             void Disconnect() {
-                if (IsConnected())
-                    asio::post(m_asioContext, [this]() { m_socket.close(); });
+                if (m_bSink)
+                    m_bConnected = false;
+                else if (IsConnected())
+                    asio::post(m_strand, [this]() { Close(); });
             }
 
+            // Safe from any thread, the socket itself belongs to the strand
             bool IsConnected() const {
-                return m_socket.is_open();
+                return m_bConnected.load(std::memory_order_acquire);
             }
 
             // Prime the connection to wait for incoming messages
@@ -98,70 +151,281 @@ namespace bsl {
             // ASYNC - Send a message, connections are one-to-one so no need to specifiy
             // the target, for a client, the target is the server and vice versa
             void Send(const message <T> &msg) {
-                asio::post(m_asioContext,
-                           [this, msg]() {
-                               bool bWritingMessage = !m_qMessagesOut.empty();
-                               m_qMessagesOut.push_back(msg);
-                               if (!bWritingMessage) {
-                                   WriteHeader();
-                               }
-                           });
+                Send(make_shared_message(msg));
+            }
+
+            // ASYNC - Send a message that is no longer needed, its body is moved into the frame
+            void Send(message <T> &&msg) {
+                Send(make_shared_message(std::move(msg)));
+            }
+
+            // ASYNC - Send a shared frame, the frame is queued by reference so many connections can send the same one
+            void Send(shared_message <T> msg) {
+                if (m_bSink) return Sink(*msg);
+                // Game threads are not asio threads, so asio can't recycle the memory of this operation for them
+                asio::post(m_strand,
+                           make_pooled_handler([this, self = this->weak_from_this().lock(),
+                                                msg = std::move(msg)]() mutable {
+                               QueueMessage(std::move(msg), 0);
+                           }));
+            }
+
+            // ASYNC - Send the latest state of something named by nKey, like the position of one player. A message
+            // with the same key still waiting in the queue is replaced instead of sent, so a slow link gets the
+            // newest state rather than every state in between. The message must not depend on the one it replaces
+            void SendLatest(shared_message <T> msg, uint64_t nKey) {
+                if (m_bSink) return Sink(*msg);
+                asio::post(m_strand,
+                           make_pooled_handler([this, self = this->weak_from_this().lock(), msg = std::move(msg),
+                                                nKey]() mutable {
+                               QueueMessage(std::move(msg), nKey);
+                           }));
+            }
+
+            // Bound the outgoing queue, a remote that lets it grow past either limit is disconnected. 0 is no limit
+            void SetOutgoingLimits(size_t nMaxMessages, size_t nMaxBytes) {
+                m_nMaxQueuedMessages = nMaxMessages;
+                m_nMaxQueuedBytes = nMaxBytes;
+            }
+
+            // Largest message body accepted from the remote, a header announcing more closes the connection before
+            // anything is allocated for it
+            void SetMaxMessageSize(uint32_t nMaxBytes) {
+                m_nMaxMessageSize = nMaxBytes;
+            }
+
+            // Limit how much of the outgoing queue a single flush may gather, at least one message is always sent
+            void SetWriteCoalescing(size_t nMaxMessages, size_t nMaxBytes) {
+                m_nMaxFlushMessages = std::max<size_t>(nMaxMessages, 1);
+                m_nMaxFlushBytes = nMaxBytes;
+            }
+
+            // ASYNC - Queue the messages read from now on to qIn. msgCut is queued to the previous queue, without a
+            // remote, behind every message read before the switch, so its consumer knows it has seen all of them
+            void Redirect(mpscqueue<owned_message<T>> &qIn, message <T> &&msgCut) {
+                asio::post(m_strand,
+                           make_pooled_handler([this, self = this->weak_from_this().lock(), pQueue = &qIn,
+                                                msgCut = std::move(msgCut)]() mutable {
+                               m_pMessagesIn.load(std::memory_order_relaxed)->push_back(
+                                       {nullptr, std::move(msgCut), std::chrono::steady_clock::now()});
+                               m_pMessagesIn.store(pQueue, std::memory_order_release);
+                           }));
+            }
+
+            // The queue messages from the remote currently go to, for the ones arriving another way like datagrams
+            mpscqueue<owned_message<T>> &GetIncomingQueue() {
+                return *m_pMessagesIn.load(std::memory_order_acquire);
             }
 
+            // Counters of the coalesced write path, safe to read from any thread
+            const write_stats &GetWriteStats() const {
+                return m_statsWrite;
+            }
+
+            // Counters of the read path, safe to read from any thread
+            const read_stats &GetReadStats() const {
+                return m_statsRead;
+            }
+
+            // Messages waiting to be written, a snapshot safe to read from any thread
+            size_t GetQueuedMessages() const {
+                return m_nQueuedOut.load(std::memory_order_relaxed);
+            }
+
+            // State of the unreliable channel bound to this connection
+            datagram_peer &GetDatagramPeer() {
+                return m_peerDatagram;
+            }
+
+            // FNV-1a over every message sent to a replay connection, headers and bodies in the order they were sent
+            uint64_t GetSinkDigest() const {
+                return m_nSinkDigest;
+            }
 
         private:
-            // ASYNC - Prime context to write a message header
-            void WriteHeader() {
-                asio::async_write(m_socket, asio::buffer(&m_qMessagesOut.front().header, sizeof(message_header<T>)),
-                                  [this](std::error_code ec, std::size_t length) {
-                                      if (!ec) {
-                                          // Check if the message also have a message body
-                                          if (m_qMessagesOut.front().body.size() > 0) {
-                                              // If it is, then write the body too.
-                                              WriteBody();
-                                          } else {
-                                              // It didnt, so we are done with this message. Remove it from th out message queue
-                                              m_qMessagesOut.pop_front();
-
-                                              // If the queue is not empty, there are more messages to send
-                                              if (!m_qMessagesOut.empty()) {
-                                                  WriteHeader();
-                                              }
-                                          }
-                                      } else {
-                                          std::cout << "[" << id << "] Write Header Fail.\n" << ec.message() << std::endl;
-                                          m_socket.close();
-                                      }
-                                  });
+            // What a replay connection does with a message sent to it, on the thread sending it
+            void Sink(const message <T> &msg) {
+                auto Digest = [this](const void *pData, size_t nBytes) {
+                    const uint8_t *p = static_cast<const uint8_t *>(pData);
+                    for (size_t i = 0; i < nBytes; i++) m_nSinkDigest = (m_nSinkDigest ^ p[i]) * 0x100000001b3ULL;
+                };
+                Digest(&msg.header, sizeof(message_header<T>));
+                Digest(msg.body.data(), msg.body.size());
+                m_statsWrite.Record(1, sizeof(message_header<T>) + msg.body.size());
             }
 
-            // ASYNC - Prime context to write a message body
-            void WriteBody() {
-                // If this function is called, a header has just been sent
-                asio::async_write(m_socket,
-                                  asio::buffer(m_qMessagesOut.front().body.data(), m_qMessagesOut.front().body.size()),
-                                  [this](std::error_code ec, std::size_t length) {
-                                      if (!ec) {
-                                          // Sending was successful, so we are done with the message
-                                          m_qMessagesOut.pop_front();
+            // Close the socket, on the strand. The flag is released after the close so a thread that sees it cleared
+            // may destroy the connection
+            void Close() {
+                m_socket.close();
+                m_bConnected.store(false, std::memory_order_release);
+            }
 
-                                          // If the queue is not empty, there are more messages to send
-                                          if (!m_qMessagesOut.empty()) {
-                                              WriteHeader();
-                                          }
-                                      } else {
-                                          std::cout << "[" << id << "] Write Body Fail.\n" << ec.message() << std::endl;
-                                          m_socket.close();
-                                      }
-                                  });
+            // Add a message to the out message queue and start writing if nothing is being written, on the strand
+            void QueueMessage(shared_message <T> msg, uint64_t nKey) {
+                if (m_bOverflowed) return;
+                bool bWritingMessage = !m_qMessagesOut.empty();
+                size_t nBytes = sizeof(message_header<T>) + msg->body.size();
+
+                if (nKey == 0 || !ReplaceQueued(msg, nKey, nBytes)) {
+                    if (nKey != 0) m_mapQueuedKeys[nKey] = m_nQueuedBase + m_qMessagesOut.size();
+                    m_qMessagesOut.push_back({std::move(msg), nKey});
+                    m_nQueuedBytes += nBytes;
+                }
+                m_nQueuedOut.store(m_qMessagesOut.size(), std::memory_order_relaxed);
+
+                // Too far behind, stop feeding it before it costs the server all its memory
+                if ((m_nMaxQueuedMessages > 0 && m_qMessagesOut.size() > m_nMaxQueuedMessages) ||
+                    (m_nMaxQueuedBytes > 0 && m_nQueuedBytes > m_nMaxQueuedBytes)) {
+                    m_bOverflowed = true;
+                    std::cout << "[" << id << "] Outgoing queue over the limit (" << m_qMessagesOut.size()
+                              << " messages, " << m_nQueuedBytes << " bytes), disconnecting\n";
+                    if (m_pServer) m_pServer->ClientOverflowed(this->shared_from_this());
+                    Close();
+                    return;
+                }
+
+                if (!bWritingMessage) {
+                    WriteMessages();
+                }
+            }
+
+            // Put msg in place of the queued message with the same key, if that one isn't part of the flush on the wire
+            bool ReplaceQueued(shared_message <T> &msg, uint64_t nKey, size_t nBytes) {
+                auto queued = m_mapQueuedKeys.find(nKey);
+                if (queued == m_mapQueuedKeys.end() || queued->second < m_nQueuedBase) return false;
+                size_t nIndex = size_t(queued->second - m_nQueuedBase);
+                if (nIndex < m_nFlushMessages || nIndex >= m_qMessagesOut.size()) return false;
+
+                auto &entry = m_qMessagesOut[nIndex];
+                m_nQueuedBytes += nBytes;
+                m_nQueuedBytes -= sizeof(message_header<T>) + entry.msg->body.size();
+                entry.msg = std::move(msg);
+                m_statsWrite.nReplaced++;
+                return true;
+            }
+
+            // Remove the messages of a completed flush from the front of the out message queue
+            void PopFlushed() {
+                for (size_t i = 0; i < m_nFlushMessages; i++) {
+                    auto &entry = m_qMessagesOut[i];
+                    m_nQueuedBytes -= sizeof(message_header<T>) + entry.msg->body.size();
+                    if (entry.nKey == 0) continue;
+                    auto queued = m_mapQueuedKeys.find(entry.nKey);
+                    if (queued != m_mapQueuedKeys.end() && queued->second == m_nQueuedBase + i)
+                        m_mapQueuedKeys.erase(queued);
+                }
+                m_qMessagesOut.erase(m_qMessagesOut.begin(), m_qMessagesOut.begin() + m_nFlushMessages);
+                m_nQueuedBase += m_nFlushMessages;
+                m_nQueuedOut.store(m_qMessagesOut.size(), std::memory_order_relaxed);
+            }
+
+            // Every handler of this connection runs on its strand, so reads and writes of one connection never overlap
+            // while different connections progress in parallel on the I/O threads. Handler memory comes from the block pool.
+            // A server connection is shared, its handlers hold it so it outlives the operations pending when it closes
+            template<typename Handler>
+            auto OnStrand(Handler &&handler) {
+                return asio::bind_executor(m_strand, make_pooled_handler(
+                        [self = this->weak_from_this().lock(), handler = std::forward<Handler>(handler)](
+                                auto &&... args) mutable {
+                            handler(std::forward<decltype(args)>(args)...);
+                        }));
+            }
+
+            // Buffer sequence over the gather buffers, the socket operation holds its buffer sequence by value and
+            // passing the vector itself would copy it on every write
+            struct gather_view {
+                using value_type = asio::const_buffer;
+                using const_iterator = const asio::const_buffer *;
+
+                const_iterator begin() const { return pBegin; }
+
+                const_iterator end() const { return pEnd; }
+
+                const asio::const_buffer *pBegin;
+                const asio::const_buffer *pEnd;
+            };
+
+            // ASYNC - Gather as many queued messages as the flush limits allow, header and body together
+            void WriteMessages() {
+                m_vWriteBuffers.clear();
+                m_nFlushMessages = 0;
+                m_nFlushBytes = 0;
+
+                for (const auto &entry : m_qMessagesOut) {
+                    const auto &msg = entry.msg;
+                    size_t nMessageBytes = sizeof(message_header<T>) + msg->body.size();
+                    if (m_nFlushMessages > 0 &&
+                        (m_nFlushMessages >= m_nMaxFlushMessages || m_nFlushBytes + nMessageBytes > m_nMaxFlushBytes))
+                        break;
+
+                    m_vWriteBuffers.push_back(asio::buffer(&msg->header, sizeof(message_header<T>)));
+                    if (!msg->body.empty())
+                        m_vWriteBuffers.push_back(asio::buffer(msg->body.data(), msg->body.size()));
+
+                    m_nFlushMessages++;
+                    m_nFlushBytes += nMessageBytes;
+                }
+
+                WriteGather();
+            }
+
+            // ASYNC - Write the gathered buffers, asio::async_write would split a long sequence into 16 buffer chunks,
+            // so drive async_write_some directly to let each writev carry up to 64 buffers
+            void WriteGather() {
+                m_socket.async_write_some(gather_view{m_vWriteBuffers.data(), m_vWriteBuffers.data() + m_vWriteBuffers.size()},
+                                          OnStrand([this](std::error_code ec, std::size_t length) {
+                                              if (!ec) {
+                                                  ConsumeWriteBuffers(length);
+
+                                                  // Short write, keep sending the rest of this flush
+                                                  if (!m_vWriteBuffers.empty()) {
+                                                      WriteGather();
+                                                      return;
+                                                  }
+
+                                                  // The whole flush is on the wire, remove its messages from the out message queue
+                                                  m_statsWrite.Record(m_nFlushMessages, m_nFlushBytes);
+                                                  PopFlushed();
+                                                  m_nFlushMessages = 0;
+
+                                                  // If the queue is not empty, messages arrived during the flush
+                                                  if (!m_qMessagesOut.empty()) {
+                                                      WriteMessages();
+                                                  }
+                                              } else {
+                                                  std::cout << "[" << id << "] Write Fail.\n" << ec.message() << std::endl;
+                                                  Close();
+                                              }
+                                          }));
+            }
+
+            // Drop the written bytes from the front of the gather buffers
+            void ConsumeWriteBuffers(std::size_t length) {
+                size_t nWritten = 0;
+                while (nWritten < m_vWriteBuffers.size() && length >= m_vWriteBuffers[nWritten].size()) {
+                    length -= m_vWriteBuffers[nWritten].size();
+                    nWritten++;
+                }
+                if (nWritten < m_vWriteBuffers.size())
+                    m_vWriteBuffers[nWritten] += length;
+                m_vWriteBuffers.erase(m_vWriteBuffers.begin(), m_vWriteBuffers.begin() + nWritten);
             }
 
             // ASYNC - Prime context ready to read a message header
             void ReadHeader() {
                 // Because this function is asynchronized, so we need a temporary message to get full of the message
                 asio::async_read(m_socket, asio::buffer(&m_msgTemporaryIn.header, sizeof(message_header<T>)),
-                                 [this](std::error_code ec, std::size_t length) {
+                                 OnStrand([this](std::error_code ec, std::size_t length) {
                                      if (!ec) {
+                                         // The size comes from the remote, don't let it decide how much we allocate
+                                         if (m_msgTemporaryIn.header.size > m_nMaxMessageSize) {
+                                             std::cout << "[" << id << "] Message too large ("
+                                                       << m_msgTemporaryIn.header.size << " bytes), disconnecting\n";
+                                             Close();
+                                             return;
+                                         }
+
                                          // A complete message header has been read, check if this message has a body
                                          if (m_msgTemporaryIn.header.size > 0) {
                                              // If it does, so allocate enough space in the messages' body, and tell asio context to read body
@@ -173,33 +437,38 @@ namespace bsl {
                                          }
                                      } else {
                                          std::cout << "[" << id << "] Read Header Fail.\n" << ec.message() << std::endl;
-                                         m_socket.close();
+                                         Close();
                                      }
-                                 });
+                                 }));
             }
 
             // ASYNC - Prime context ready to read a message body
             void ReadBody() {
                 // If this function is called, a header has already been read, and allocate enough space to store the body
                 asio::async_read(m_socket, asio::buffer(m_msgTemporaryIn.body.data(), m_msgTemporaryIn.body.size()),
-                                 [this](std::error_code ec, std::size_t length) {
+                                 OnStrand([this](std::error_code ec, std::size_t length) {
                                      if (!ec) {
                                          // The message is complete now, just add it to the incoming message queue
                                          AddToIncomingMessageQueue();
                                      } else {
                                          std::cout << "[" << id << "] Read Body Fail.\n" << ec.message() << std::endl;
-                                         m_socket.close();
+                                         Close();
                                      }
-                                 });
+                                 }));
             }
 
             // When a full message is arrived, call this function
             void AddToIncomingMessageQueue() {
                 // Push the temporary message to the message queue and add owner information to the message
+                // The body is moved into the queue, the next ReadHeader takes a fresh body from the block pool
+                m_statsRead.nMessages++;
+                m_statsRead.nBytes += sizeof(message_header<T>) + m_msgTemporaryIn.body.size();
+                auto &qMessagesIn = *m_pMessagesIn.load(std::memory_order_relaxed);
+                auto tpArrived = std::chrono::steady_clock::now();
                 if (m_nOwnerType == owner::server)
-                    m_qMessagesIn.push_back({this->shared_from_this(), m_msgTemporaryIn});
+                    qMessagesIn.push_back({this->shared_from_this(), std::move(m_msgTemporaryIn), tpArrived});
                 else
-                    m_qMessagesIn.push_back({nullptr, m_msgTemporaryIn});
+                    qMessagesIn.push_back({nullptr, std::move(m_msgTemporaryIn), tpArrived});
 
                 // Prime the asio context to read another header
                 ReadHeader();
@@ -215,27 +484,29 @@ namespace bsl {
             // ASYNC - Used by both client and server to write validation packet
             void WriteValidation() {
                 asio::async_write(m_socket, asio::buffer(&m_nHandshakeOut, sizeof(uint64_t)),
-                                  [this](std::error_code ec, std::size_t length) {
+                                  OnStrand([this](std::error_code ec, std::size_t length) {
                                       if (!ec) {
                                           // After validation data sent, client should wait for respond
                                           if (m_nOwnerType == owner::client)
                                               ReadHeader();
                                       } else {
-                                          m_socket.close();
+                                          Close();
                                       }
-                                  }
+                                  })
                 );
             }
 
             // ASYNC - Used by both client and server to write validation packet
             void ReadValidation(server_interface<T> *server = nullptr) {
                 asio::async_read(m_socket, asio::buffer(&m_nHandshakeIn, sizeof(uint64_t)),
-                                 [this, server](std::error_code ec, std::size_t length) {
+                                 OnStrand([this, server](std::error_code ec, std::size_t length) {
                                      if (!ec) {
                                          if (m_nOwnerType == owner::server) {
                                              if (m_nHandshakeIn == m_nHandshakeCheck) {
                                                  // Client has provided valid solution, allow it to connect
                                                  std::cout << "Client Validated\n";
+                                                 m_peerDatagram.nToken = m_nHandshakeCheck;
+                                                 server->AdmitDatagrams(this->shared_from_this());
                                                  server->OnClientValidated(this->shared_from_this());
 
                                                  // Waiting to receive data now
@@ -243,19 +514,22 @@ namespace bsl {
                                              } else {
                                                  // Client gave incorrect data, disconnect it
                                                  std::cout << "Client Disconnected (Fail Validation)\n";
-                                                 m_socket.close();
+                                                 Close();
                                              }
                                          } else {
                                              // Connection is a client, so solve puzzle
                                              m_nHandshakeOut = scramble(m_nHandshakeIn);
 
+                                             // The answer also identifies this connection on the unreliable channel
+                                             m_peerDatagram.nToken = m_nHandshakeOut;
+
                                              // Write the result
                                              WriteValidation();
                                          }
                                      } else {
                                          std::cout << "Client Disconnected (ReadValidation)\n" << ec.message() << std::endl;
                                      }
-                                 }
+                                 })
                 );
             }
 
@@ -266,11 +540,50 @@ namespace bsl {
             // This context is shared with the whole asio instance
             asio::io_context &m_asioContext;
 
-            // This queue holds all messages to be sent to the remote side
-            tsqueue <message<T>> m_qMessagesOut;
+            // Serializes the handlers of this connection when the context is run by several threads. The io_context strand
+            // reschedules itself without allocating, where asio::strand allocates from a one slot per thread cache
+            asio::io_context::strand m_strand;
+
+            // This queue holds all messages to be sent to the remote side, it is only touched on the asio thread.
+            // Entries are shared frames, so a broadcast message is held once no matter how many queues reference it.
+            // A latest state message also carries its key
+            struct queued_message {
+                shared_message<T> msg;
+                uint64_t nKey = 0;
+            };
+            std::deque<queued_message, pool_allocator<queued_message>> m_qMessagesOut;
+
+            // Position of the queued message of every key, counted from the first message ever queued
+            std::unordered_map<uint64_t, uint64_t> m_mapQueuedKeys;
+            uint64_t m_nQueuedBase = 0;
+
+            // Outgoing queue limits and the bytes it holds
+            size_t m_nMaxQueuedMessages = 0;
+            size_t m_nMaxQueuedBytes = 0;
+            size_t m_nQueuedBytes = 0;
+            bool m_bOverflowed = false;
+            server_interface<T> *m_pServer = nullptr;
+
+            // Gather buffers of the flush in progress and how much of the queue it covers
+            std::vector<asio::const_buffer> m_vWriteBuffers;
+            size_t m_nFlushMessages = 0;
+            size_t m_nFlushBytes = 0;
+
+            // Flush limits, 32 messages fill the 64 buffers asio hands to one writev
+            size_t m_nMaxFlushMessages = 32;
+            size_t m_nMaxFlushBytes = 64 * 1024;
+
+            write_stats m_statsWrite;
+            read_stats m_statsRead;
 
-            // This references the incoming queue
-            tsqueue <owned_message<T>> &m_qMessagesIn;
+            // Largest message body accepted from the remote
+            uint32_t m_nMaxMessageSize = nDefaultMaxMessageSize;
+
+            // Size of the out message queue, mirrored for other threads
+            std::atomic<size_t> m_nQueuedOut{0};
+
+            // The incoming queue, only switched on the strand so a redirect cuts the stream between two messages
+            std::atomic<mpscqueue<owned_message<T>> *> m_pMessagesIn;
 
             // Incoming messages are constructed asynchronously, so we will store the part assembled message here, until it is ready
             message <T> m_msgTemporaryIn;
@@ -278,6 +591,13 @@ namespace bsl {
             // The owner of the connetion
             owner m_nOwnerType = owner::server;
 
+            // Mirrors whether the socket is open, so other threads can check without touching the socket
+            std::atomic<bool> m_bConnected{false};
+
+            // Replay connection, with no socket
+            bool m_bSink = false;
+            uint64_t m_nSinkDigest = 0xcbf29ce484222325ULL;
+
             uint32_t id = 0;
 
             // Handshake Validation
@@ -285,6 +605,8 @@ namespace bsl {
             uint64_t m_nHandshakeIn = 0;
             uint64_t m_nHandshakeCheck = 0;
 
+            datagram_peer m_peerDatagram;
+
         };
     }
 }
\ No newline at end of file
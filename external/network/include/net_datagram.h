@@ -0,0 +1,138 @@
+#pragma once
+
+#include "net_common.h"
+#include "net_pool.h"
+#include "net_message.h"
+
+namespace bsl {
+    namespace net {
+        // Largest datagram the unreliable channel sends, small enough to avoid IP fragmentation on common paths.
+        // Messages that don't fit go over the TCP connection instead
+        constexpr size_t nMaxDatagramBytes = 1200;
+
+        // Header of a datagram on the unreliable channel, followed by a message header and body
+        struct datagram_header {
+            // Handshake answer of the connection, ties the datagram to a validated TCP connection
+            uint64_t nToken = 0;
+            // Increases with every datagram sent on the channel, older datagrams than the newest received are dropped
+            uint32_t nSequence = 0;
+            uint32_t nFlags = 0;
+        };
+
+        enum datagram_flags : uint32_t {
+            // No message, asks the server to bind the sender's endpoint to the connection, the server answers in kind
+            datagram_bind = 1 << 0,
+        };
+
+        // Unreliable channel state of one connection
+        struct datagram_peer {
+            // Set once the connection is validated, 0 before
+            std::atomic<uint64_t> nToken{0};
+
+            // Set once a datagram got through from the remote side, the endpoint is written before and never after
+            std::atomic<bool> bBound{false};
+            asio::ip::udp::endpoint endpoint;
+
+            // Sequence of the next datagram sent, any thread may send
+            std::atomic<uint32_t> nSequenceOut{0};
+
+            // Newest sequence received, only touched by the channel's receive handler
+            uint32_t nSequenceIn = 0;
+            bool bReceived = false;
+
+            // Accept a datagram if it is newer than every one received before, wrap around safe
+            bool Accept(uint32_t nSequence) {
+                if (bReceived && int32_t(nSequence - nSequenceIn) <= 0) return false;
+                nSequenceIn = nSequence;
+                bReceived = true;
+                return true;
+            }
+        };
+
+        // UDP socket shared by every connection of a server, or owned by a client.
+        // Sends may come from any thread, they are posted to the socket's strand along with the receive handlers
+        template<typename T>
+        class datagram_socket {
+        public:
+            datagram_socket(asio::io_context &asioContext, const asio::ip::udp::endpoint &local)
+                    : m_strand(asioContext), m_socket(asioContext, local) {}
+
+            // Handler is called on the strand with the sender, the datagram header and the message if it carries one
+            template<typename Handler>
+            void StartReceive(Handler handler) {
+                m_socket.async_receive_from(asio::buffer(m_vReceiveBuffer), m_endpointFrom,
+                                            OnStrand([this, handler](std::error_code ec, std::size_t length) mutable {
+                                                if (ec == asio::error::operation_aborted) return;
+                                                if (!ec) Dispatch(length, handler);
+                                                StartReceive(std::move(handler));
+                                            }));
+            }
+
+            // ASYNC - Send a message, or only a header when msg is empty, returns false if the message is too big
+            bool Send(const asio::ip::udp::endpoint &endpoint, const datagram_header &header, const message<T> *msg) {
+                size_t nBytes = sizeof(datagram_header) + (msg ? sizeof(message_header<T>) + msg->body.size() : 0);
+                if (nBytes > nMaxDatagramBytes) return false;
+
+                // The datagram is assembled in a pooled buffer owned by the operation
+                message_buffer vData(nBytes);
+                std::memcpy(vData.data(), &header, sizeof(datagram_header));
+                if (msg) {
+                    message_header<T> msgHeader = msg->header;
+                    msgHeader.size = uint32_t(msg->body.size());
+                    std::memcpy(vData.data() + sizeof(datagram_header), &msgHeader, sizeof(message_header<T>));
+                    if (!msg->body.empty())
+                        std::memcpy(vData.data() + sizeof(datagram_header) + sizeof(message_header<T>),
+                                    msg->body.data(), msg->body.size());
+                }
+
+                asio::post(m_strand, make_pooled_handler([this, endpoint, vData = std::move(vData)]() mutable {
+                    auto buffer = asio::buffer(vData.data(), vData.size());
+                    m_socket.async_send_to(buffer, endpoint,
+                                           OnStrand([vData = std::move(vData)](std::error_code, std::size_t) {
+                                               // Lost datagrams are expected on this channel, nothing to do
+                                           }));
+                }));
+                return true;
+            }
+
+            void Close() {
+                asio::post(m_strand, [this]() { m_socket.close(); });
+            }
+
+        private:
+            template<typename Handler>
+            auto OnStrand(Handler &&handler) {
+                return asio::bind_executor(m_strand, make_pooled_handler(std::forward<Handler>(handler)));
+            }
+
+            // Check the datagram is well formed and hand it over
+            template<typename Handler>
+            void Dispatch(std::size_t length, Handler &handler) {
+                if (length < sizeof(datagram_header)) return;
+                datagram_header header;
+                std::memcpy(&header, m_vReceiveBuffer.data(), sizeof(datagram_header));
+
+                message<T> msg;
+                size_t nPayload = length - sizeof(datagram_header);
+                if (nPayload == 0) {
+                    handler(m_endpointFrom, header, nullptr);
+                    return;
+                }
+
+                if (nPayload < sizeof(message_header<T>)) return;
+                std::memcpy(&msg.header, m_vReceiveBuffer.data() + sizeof(datagram_header), sizeof(message_header<T>));
+                if (msg.header.size != nPayload - sizeof(message_header<T>)) return;
+                const uint8_t *pBody = m_vReceiveBuffer.data() + sizeof(datagram_header) + sizeof(message_header<T>);
+                msg.body.assign(pBody, pBody + msg.header.size);
+                handler(m_endpointFrom, header, &msg);
+            }
+
+            asio::io_context::strand m_strand;
+            asio::ip::udp::socket m_socket;
+
+            // One receive is outstanding at a time, so the buffer and the sender endpoint are reused
+            std::array<uint8_t, nMaxDatagramBytes> m_vReceiveBuffer{};
+            asio::ip::udp::endpoint m_endpointFrom;
+        };
+    }
+}
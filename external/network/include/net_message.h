@@ -1,9 +1,16 @@
 #pragma once
 
 #include "net_common.h"
+#include "net_pool.h"
+
+#include <cstring>
+#include <string>
 
 namespace bsl {
     namespace net {
+        // Largest message body a connection accepts unless it is given another limit
+        constexpr uint32_t nDefaultMaxMessageSize = 1024 * 1024;
+
         // Message Header is sent at start of all messages. It has fixed size
         template<typename T>
         struct message_header {
@@ -11,12 +18,15 @@ namespace bsl {
             uint32_t size = 0;
         };
 
+        // Message bodies draw their storage from the block pool, so a released body is recycled for the next message
+        using message_buffer = std::vector<uint8_t, pool_allocator<uint8_t>>;
+
         // Message Body contains a header and a std::vector, containing raw bytes of infomation.
         template<typename T>
         struct message {
             // Header & Body vector
             message_header<T> header{};
-            std::vector<uint8_t> body;
+            message_buffer body;
 
             // returns body size of the message
             size_t size() const {
@@ -75,6 +85,162 @@ namespace bsl {
             }
         };
 
+        // Writes fields front to back at a cursor, so they are read back in the order they were written. The body is
+        // grown geometrically instead of once per field, and trimmed to what was written by Finish or the destructor.
+        // Arrays and strings are written as a uint32_t count followed by their elements.
+        template<typename T>
+        class message_writer {
+        public:
+            // Append to whatever msg already holds, nReserve is the number of bytes expected to be written
+            explicit message_writer(message<T> &msg, size_t nReserve = 0) : m_msg(msg), m_nCursor(msg.body.size()) {
+                if (nReserve > 0) m_msg.body.resize(m_nCursor + nReserve);
+            }
+
+            message_writer(const message_writer<T> &) = delete;
+
+            ~message_writer() {
+                Finish();
+            }
+
+            template<typename DataType>
+            message_writer<T> &Write(const DataType &data) {
+                static_assert(std::is_standard_layout<DataType>::value, "Data is too complex to be pushed into vector");
+                std::memcpy(Grow(sizeof(DataType)), &data, sizeof(DataType));
+                return *this;
+            }
+
+            template<typename DataType>
+            message_writer<T> &WriteArray(const DataType *pData, size_t nCount) {
+                static_assert(std::is_standard_layout<DataType>::value, "Data is too complex to be pushed into vector");
+                Write(uint32_t(nCount));
+                if (nCount > 0) std::memcpy(Grow(sizeof(DataType) * nCount), pData, sizeof(DataType) * nCount);
+                return *this;
+            }
+
+            template<typename DataType, typename Allocator>
+            message_writer<T> &WriteArray(const std::vector<DataType, Allocator> &vData) {
+                return WriteArray(vData.data(), vData.size());
+            }
+
+            message_writer<T> &WriteString(const std::string &sData) {
+                return WriteArray(sData.data(), sData.size());
+            }
+
+            // Bytes written so far, including what the message held before
+            size_t Size() const {
+                return m_nCursor;
+            }
+
+            // Drop the unused reserve and set the header size, the message is complete
+            void Finish() {
+                m_msg.body.resize(m_nCursor);
+                m_msg.header.size = uint32_t(m_nCursor);
+            }
+
+        private:
+            // Make room for nBytes at the cursor and return where they go
+            uint8_t *Grow(size_t nBytes) {
+                size_t nNeeded = m_nCursor + nBytes;
+                if (nNeeded > m_msg.body.size()) m_msg.body.resize(std::max(nNeeded, m_msg.body.size() * 2));
+                uint8_t *pData = m_msg.body.data() + m_nCursor;
+                m_nCursor = nNeeded;
+                return pData;
+            }
+
+            message<T> &m_msg;
+            size_t m_nCursor;
+        };
+
+        // Reads fields front to back at a cursor without touching the message, so a shared frame can be read too.
+        // Every read checks that the body holds the data; a read past the end, or an array longer than the body or
+        // than nMaxCount, fails and leaves the reader failed, so a run of reads can be checked once with Good
+        template<typename T>
+        class message_reader {
+        public:
+            explicit message_reader(const message<T> &msg) : m_pData(msg.body.data()), m_nSize(msg.body.size()) {}
+
+            template<typename DataType>
+            bool Read(DataType &data) {
+                static_assert(std::is_standard_layout<DataType>::value, "Data is too complex to be pulled from vector");
+                // Checked here rather than in Take, so the optimizer sees the copy never runs past an empty body
+                if (m_bFailed || Remaining() < sizeof(DataType)) return Fail();
+                std::memcpy(static_cast<void *>(&data), m_pData + m_nCursor, sizeof(DataType));
+                m_nCursor += sizeof(DataType);
+                return true;
+            }
+
+            template<typename DataType, typename Allocator>
+            bool ReadArray(std::vector<DataType, Allocator> &vData, size_t nMaxCount = size_t(-1)) {
+                static_assert(std::is_standard_layout<DataType>::value, "Data is too complex to be pulled from vector");
+                uint32_t nCount = 0;
+                if (!Read(nCount)) return false;
+                if (nCount > nMaxCount || nCount > Remaining() / sizeof(DataType)) return Fail();
+                vData.resize(nCount);
+                if (nCount > 0)
+                    std::memcpy(static_cast<void *>(vData.data()), Take(sizeof(DataType) * nCount),
+                                sizeof(DataType) * nCount);
+                return true;
+            }
+
+            bool ReadString(std::string &sData, size_t nMaxLength = size_t(-1)) {
+                uint32_t nLength = 0;
+                if (!Read(nLength)) return false;
+                if (nLength > nMaxLength || nLength > Remaining()) return Fail();
+                sData.assign(reinterpret_cast<const char *>(Take(nLength)), nLength);
+                return true;
+            }
+
+            // Unread bytes, for data decoded by other means like the player state codec. Skip advances past them
+            const uint8_t *Data() const {
+                return m_pData + m_nCursor;
+            }
+
+            bool Skip(size_t nBytes) {
+                return Take(nBytes) != nullptr;
+            }
+
+            size_t Remaining() const {
+                return m_nSize - m_nCursor;
+            }
+
+            // False once any read failed
+            bool Good() const {
+                return !m_bFailed;
+            }
+
+        private:
+            const uint8_t *Take(size_t nBytes) {
+                if (m_bFailed || nBytes > Remaining()) {
+                    Fail();
+                    return nullptr;
+                }
+                const uint8_t *pData = m_pData + m_nCursor;
+                m_nCursor += nBytes;
+                return pData;
+            }
+
+            bool Fail() {
+                m_bFailed = true;
+                return false;
+            }
+
+            const uint8_t *m_pData;
+            size_t m_nSize;
+            size_t m_nCursor = 0;
+            bool m_bFailed = false;
+        };
+
+        // Shared message is an immutable, reference counted frame. It is serialized once and every outgoing queue it is
+        // sent to holds the same header and body, so a broadcast doesn't copy the body per client
+        template<typename T>
+        using shared_message = std::shared_ptr<const message<T>>;
+
+        // Freeze a message into a shared frame, pass an rvalue to move the body in instead of copying it
+        template<typename T>
+        shared_message<T> make_shared_message(message<T> msg) {
+            msg.header.size = uint32_t(msg.size());
+            return std::allocate_shared<const message<T>>(pool_allocator<message<T>>(), std::move(msg));
+        }
 
         // Owned message add a shared_ptr of connection, the owner is the one who sent the message
         // Forward declare the connection
@@ -85,6 +251,8 @@ namespace bsl {
         struct owned_message {
             std::shared_ptr<connection<T>> remote = nullptr;
             message<T> msg;
+            // When it was queued, stamped by whoever queues it
+            std::chrono::steady_clock::time_point tpArrived;
 
             friend std::ostream &operator<<(std::ostream &os, const owned_message<T> &msg) {
                 os << msg.msg;
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "net_common.h"
+#include "net_pool.h"
+
+namespace bsl {
+    namespace net {
+        // Lock free multi-producer / single-consumer queue
+        // Any thread may push_back, but only one thread may take items out (empty, pop_front, drain, wait, clear).
+        // Producers link nodes with a single atomic exchange (Vyukov's intrusive MPSC queue), the consumer walks the
+        // list without any lock and is only signalled through the condition variable when it is parked in wait()
+        template<typename T>
+        class mpscqueue {
+        public:
+            mpscqueue() {
+                m_pFront = &m_nodeStub;
+                m_pBack.store(&m_nodeStub);
+            }
+
+            mpscqueue(const mpscqueue<T> &) = delete;
+
+            virtual ~mpscqueue() {
+                clear();
+                if (m_pFront != &m_nodeStub) delete m_pFront;
+            }
+
+        public:
+            // Adds an item to back of Queue, safe from any thread
+            void push_back(const T &item) {
+                link(new node(item));
+            }
+
+            void push_back(T &&item) {
+                link(new node(std::move(item)));
+            }
+
+            // Removes and returns item from front of Queue, the queue must not be empty
+            T pop_front() {
+                node *pNext = m_pFront->next.load(std::memory_order_acquire);
+                T t = std::move(*pNext->value);
+                advance(pNext);
+                return t;
+            }
+
+            // Moves up to nMax items into the back of batch in one pass, returns the number of items moved
+            template<typename Container>
+            size_t drain(Container &batch, size_t nMax = size_t(-1)) {
+                size_t nDrained = 0;
+                while (nDrained < nMax) {
+                    node *pNext = m_pFront->next.load(std::memory_order_acquire);
+                    if (pNext == nullptr) break;
+                    batch.push_back(std::move(*pNext->value));
+                    advance(pNext);
+                    nDrained++;
+                }
+                return nDrained;
+            }
+
+            // Returns true if Queue has no items visible to the consumer
+            bool empty() const {
+                return m_pFront->next.load(std::memory_order_acquire) == nullptr;
+            }
+
+            // Returns number of items in Queue, a snapshot which may be stale by the time it is read
+            size_t count() const {
+                return size_t(m_nPushed.load(std::memory_order_relaxed) - m_nPopped.load(std::memory_order_relaxed));
+            }
+
+            // Clears Queue
+            void clear() {
+                while (!empty()) pop_front();
+            }
+
+            void wait() {
+                // Block the consumer until an item is available. The parked flag is raised before the final check,
+                // so a producer that links an item after that check is guaranteed to see the flag and notify. Each
+                // side stores then loads what the other stores, the fences keep those in order, see link
+                while (empty()) {
+                    std::unique_lock<std::mutex> ul(muxBlocking);
+                    m_bParked.store(true);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (empty()) cvBlocking.wait(ul);
+                    m_bParked.store(false);
+                }
+            }
+
+            // Block the consumer until an item is available or the deadline passes, returns true if an item is available
+            template<typename Clock, typename Duration>
+            bool wait_until(const std::chrono::time_point<Clock, Duration> &tpDeadline) {
+                while (empty()) {
+                    std::unique_lock<std::mutex> ul(muxBlocking);
+                    m_bParked.store(true);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    bool bTimeout = empty() && cvBlocking.wait_until(ul, tpDeadline) == std::cv_status::timeout;
+                    m_bParked.store(false);
+                    if (bTimeout) return !empty();
+                }
+                return true;
+            }
+
+        private:
+            struct node {
+                node() = default;
+
+                template<typename U>
+                explicit node(U &&item) : value(std::forward<U>(item)) {}
+
+                // Nodes are recycled through the block pool rather than the heap
+                static void *operator new(size_t nBytes) {
+                    return block_pool::instance().allocate(nBytes);
+                }
+
+                static void operator delete(void *p, size_t nBytes) {
+                    block_pool::instance().deallocate(p, nBytes);
+                }
+
+                std::atomic<node *> next{nullptr};
+                std::optional<T> value;
+            };
+
+            void link(node *pNode) {
+                m_nPushed.fetch_add(1, std::memory_order_relaxed);
+
+                // Swing the back to the new node, then publish it to the consumer through the previous node
+                node *pPrev = m_pBack.exchange(pNode, std::memory_order_acq_rel);
+                pPrev->next.store(pNode);
+
+                // Only pay for the mutex and the signal when the consumer is actually asleep. The fence pairs with
+                // the one in wait: either the consumer sees the node or this sees the flag
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (m_bParked.load()) {
+                    std::unique_lock<std::mutex> ul(muxBlocking);
+                    cvBlocking.notify_one();
+                }
+            }
+
+            // The consumed node becomes the new stub, the old front is released
+            void advance(node *pNext) {
+                pNext->value.reset();
+                node *pOld = m_pFront;
+                m_pFront = pNext;
+                if (pOld != &m_nodeStub) delete pOld;
+                m_nPopped.store(m_nPopped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+        protected:
+            // Producers contend on the back, keep it away from the consumer's front
+            alignas(64) std::atomic<node *> m_pBack{nullptr};
+            std::atomic<uint64_t> m_nPushed{0};
+
+            alignas(64) node *m_pFront = nullptr;
+            std::atomic<uint64_t> m_nPopped{0};
+            node m_nodeStub;
+
+            std::atomic<bool> m_bParked{false};
+            std::condition_variable cvBlocking;
+            std::mutex muxBlocking;
+        };
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "net_common.h"
+
+namespace bsl {
+    namespace net {
+        // Process wide pool of recycled memory blocks
+        // Requests are rounded up to a power of two size class between 16 bytes and 64KB. A freed block goes back on the
+        // free list of its class instead of the heap, so after warm up the message path stops calling operator new.
+        // Blocks may be freed on a different thread than the one that allocated them, each class has its own lock.
+        // Larger requests fall through to the heap.
+        class block_pool {
+        public:
+            static block_pool &instance() {
+                // Intentionally leaked, messages may still be released while static objects are destroyed
+                static block_pool *pPool = new block_pool();
+                return *pPool;
+            }
+
+            void *allocate(size_t nBytes) {
+                size_t nClass = size_class(nBytes);
+                if (nClass >= nClasses) return ::operator new(nBytes);
+
+                free_list &list = m_lists[nClass];
+                {
+                    std::scoped_lock lock(list.mux);
+                    if (list.pHead) {
+                        free_block *pBlock = list.pHead;
+                        list.pHead = pBlock->pNext;
+                        list.nCached--;
+                        return pBlock;
+                    }
+                }
+                m_nHeapAllocations++;
+                return ::operator new(class_bytes(nClass));
+            }
+
+            void deallocate(void *p, size_t nBytes) {
+                size_t nClass = size_class(nBytes);
+                if (nClass >= nClasses) {
+                    ::operator delete(p);
+                    return;
+                }
+
+                free_list &list = m_lists[nClass];
+                std::scoped_lock lock(list.mux);
+                auto *pBlock = static_cast<free_block *>(p);
+                pBlock->pNext = list.pHead;
+                list.pHead = pBlock;
+                list.nCached++;
+            }
+
+            // Number of times the pool had to grow from the heap
+            uint64_t heap_allocations() const {
+                return m_nHeapAllocations.load();
+            }
+
+        private:
+            block_pool() = default;
+
+            static constexpr size_t nMinBlockShift = 4;
+            static constexpr size_t nClasses = 13;
+
+            static size_t size_class(size_t nBytes) {
+                size_t nClass = 0;
+                while ((size_t(1) << (nClass + nMinBlockShift)) < nBytes) nClass++;
+                return nClass;
+            }
+
+            static size_t class_bytes(size_t nClass) {
+                return size_t(1) << (nClass + nMinBlockShift);
+            }
+
+            struct free_block {
+                free_block *pNext;
+            };
+
+            struct free_list {
+                std::mutex mux;
+                free_block *pHead = nullptr;
+                size_t nCached = 0;
+            };
+
+            std::array<free_list, nClasses> m_lists;
+            std::atomic<uint64_t> m_nHeapAllocations{0};
+        };
+
+        // Standard allocator over the block pool, used for message bodies, shared frames and queue storage
+        template<typename T>
+        struct pool_allocator {
+            using value_type = T;
+
+            pool_allocator() noexcept = default;
+
+            template<typename U>
+            pool_allocator(const pool_allocator<U> &) noexcept {}
+
+            T *allocate(size_t n) {
+                return static_cast<T *>(block_pool::instance().allocate(n * sizeof(T)));
+            }
+
+            void deallocate(T *p, size_t n) noexcept {
+                block_pool::instance().deallocate(p, n * sizeof(T));
+            }
+
+            template<typename U>
+            bool operator==(const pool_allocator<U> &) const noexcept { return true; }
+
+            template<typename U>
+            bool operator!=(const pool_allocator<U> &) const noexcept { return false; }
+        };
+
+        // Completion handler wrapper whose associated allocator is the block pool. asio only recycles operation memory
+        // on its own threads and only a couple of blocks at a time, so every handler on the message path is wrapped
+        template<typename Handler>
+        struct pooled_handler {
+            using allocator_type = pool_allocator<void>;
+
+            allocator_type get_allocator() const noexcept { return {}; }
+
+            template<typename... Args>
+            void operator()(Args &&... args) {
+                handler(std::forward<Args>(args)...);
+            }
+
+            Handler handler;
+        };
+
+        template<typename Handler>
+        pooled_handler<typename std::decay<Handler>::type> make_pooled_handler(Handler &&handler) {
+            return {std::forward<Handler>(handler)};
+        }
+    }
+}
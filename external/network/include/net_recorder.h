@@ -0,0 +1,155 @@
+#pragma once
+
+#include "net_common.h"
+#include "net_message.h"
+
+#include <fstream>
+#include <string>
+
+namespace bsl {
+    namespace net {
+        // Session log, the messages a server handled in the order it handled them and at the time they arrived, to be
+        // replayed without clients.
+        // The file starts with the 8 bytes of session_magic, then holds one record after another:
+        //     uint32_t  microseconds since the previous record, the first one since recording started
+        //     uint8_t   record_kind
+        //     uint32_t  ID of the connection, 0 for a message posted from inside the process
+        //     a message_header and its body, message records only
+        // Fields are packed and in the byte order of the machine that recorded them
+        constexpr char session_magic[8] = {'B', 'S', 'L', 'R', 'E', 'C', '0', '1'};
+
+        enum class record_kind : uint8_t {
+            // A message taken from the incoming queue
+            message,
+            // The server found the connection gone, after every message it handled from it
+            disconnect,
+        };
+
+        template<typename T>
+        struct session_record {
+            // Microseconds since recording started
+            uint64_t nTime = 0;
+            record_kind kind = record_kind::message;
+            uint32_t nConnectionID = 0;
+            message<T> msg;
+        };
+
+        // Appends records to a session log, from the thread calling the server's Update
+        template<typename T>
+        class session_recorder {
+        public:
+            // Start a new log at sPath, replacing any file there
+            bool Open(const std::string &sPath) {
+                m_file.open(sPath, std::ios::binary | std::ios::trunc);
+                m_file.write(session_magic, sizeof(session_magic));
+                m_tpLast = std::chrono::steady_clock::now();
+                return bool(m_file);
+            }
+
+            bool IsOpen() const {
+                return m_file.is_open();
+            }
+
+            // A message handled, that arrived at tpAt
+            void WriteMessage(uint32_t nConnectionID, const message<T> &msg,
+                              std::chrono::steady_clock::time_point tpAt) {
+                WriteRecord(record_kind::message, nConnectionID, tpAt);
+                Write(msg.header);
+                if (!msg.body.empty())
+                    m_file.write(reinterpret_cast<const char *>(msg.body.data()), std::streamsize(msg.body.size()));
+                m_nRecords++;
+            }
+
+            // A connection found gone at tpAt
+            void WriteDisconnect(uint32_t nConnectionID, std::chrono::steady_clock::time_point tpAt) {
+                WriteRecord(record_kind::disconnect, nConnectionID, tpAt);
+                m_nRecords++;
+            }
+
+            // Hand what was written to the OS, so a server that is killed leaves a log that ends on a whole batch
+            void Flush() {
+                m_file.flush();
+            }
+
+            uint64_t Records() const {
+                return m_nRecords;
+            }
+
+        private:
+            template<typename DataType>
+            void Write(const DataType &data) {
+                m_file.write(reinterpret_cast<const char *>(&data), sizeof(DataType));
+            }
+
+            // Gaps longer than a uint32_t of microseconds, over an hour, are shortened to that. Records are written in
+            // the order they were handled, which may not be the order of tpAt across connections: one earlier than the
+            // record before it is put at the same time
+            void WriteRecord(record_kind kind, uint32_t nConnectionID, std::chrono::steady_clock::time_point tpAt) {
+                auto nDelta = std::chrono::duration_cast<std::chrono::microseconds>(tpAt - m_tpLast).count();
+                uint32_t nDeltaOut = uint32_t(std::clamp<int64_t>(nDelta, 0, UINT32_MAX));
+                // Keep the remainder, so rounding doesn't make the log drift from the clock
+                m_tpLast += std::chrono::microseconds(nDeltaOut);
+                Write(nDeltaOut);
+                Write(kind);
+                Write(nConnectionID);
+            }
+
+            std::ofstream m_file;
+            std::chrono::steady_clock::time_point m_tpLast;
+            uint64_t m_nRecords = 0;
+        };
+
+        // Reads the records of a session log back in order
+        template<typename T>
+        class session_reader {
+        public:
+            // Open the log at sPath, false if it can't be read or isn't a session log
+            bool Open(const std::string &sPath) {
+                m_file.open(sPath, std::ios::binary);
+                char magic[sizeof(session_magic)] = {};
+                m_file.read(magic, sizeof(magic));
+                return bool(m_file) && std::equal(magic, magic + sizeof(magic), session_magic);
+            }
+
+            // Read the next record, false at the end of the log. Records with a body larger than nMaxBody end the
+            // log like a cut off one, see Truncated
+            bool Next(session_record<T> &record, uint32_t nMaxBody = nDefaultMaxMessageSize) {
+                uint32_t nDelta = 0;
+                if (!Read(nDelta)) {
+                    m_bTruncated = m_file.gcount() > 0;
+                    return false;
+                }
+                m_bTruncated = true;
+                if (!Read(record.kind) || !Read(record.nConnectionID)) return false;
+                if (record.kind == record_kind::message) {
+                    if (!Read(record.msg.header) || record.msg.header.size > nMaxBody) return false;
+                    record.msg.body.resize(record.msg.header.size);
+                    if (record.msg.header.size > 0 &&
+                        !m_file.read(reinterpret_cast<char *>(record.msg.body.data()), record.msg.header.size))
+                        return false;
+                } else if (record.kind != record_kind::disconnect) {
+                    return false;
+                }
+                m_bTruncated = false;
+                m_nTime += nDelta;
+                record.nTime = m_nTime;
+                return true;
+            }
+
+            // True if the log ended inside a record, or on one that doesn't make sense
+            bool Truncated() const {
+                return m_bTruncated;
+            }
+
+        private:
+            template<typename DataType>
+            bool Read(DataType &data) {
+                return bool(m_file.read(reinterpret_cast<char *>(&data), sizeof(DataType)));
+            }
+
+            std::ifstream m_file;
+            uint64_t m_nTime = 0;
+            bool m_bTruncated = false;
+        };
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "net_common.h"
+#include "net_connection.h"
+
+namespace bsl {
+    namespace net {
+        // Slot map of the validated connections of a server
+        // The ID of a connection is its handle: the slot it occupies in the low bits and the generation of that slot in
+        // the high bits. Finding a connection by ID is an array access, and the ID of a connection that left doesn't
+        // find the one which took its slot after it. The connections are also kept dense, so a broadcast walks a
+        // plain array. Slots are reserved on the I/O threads when a connection is accepted, everything else belongs to
+        // the thread calling Update. Registries of servers sharing a listener share the slots of the listener's one, so
+        // a connection keeps its ID when it moves between them.
+        template<typename T>
+        class connection_registry {
+        public:
+            using connection_ptr = std::shared_ptr<connection<T>>;
+
+            static constexpr uint32_t nIndexBits = 20;
+            static constexpr uint32_t nIndexMask = (uint32_t(1) << nIndexBits) - 1;
+            static constexpr uint32_t nGenerationMask = uint32_t(-1) >> nIndexBits;
+
+            connection_registry() = default;
+
+            // A registry taking its slots from another, which must outlive it
+            explicit connection_registry(connection_registry<T> &slots) : m_pSlots(&slots) {}
+
+            connection_registry(const connection_registry<T> &) = delete;
+
+        public:
+            // Any thread. Take a free slot and return the ID of the connection which will occupy it, 0 if all are taken.
+            // Freed slots are reused oldest first, which keeps the IDs of departed connections from coming back soon
+            uint32_t Reserve() {
+                if (m_pSlots != this) return m_pSlots->Reserve();
+                std::scoped_lock lock(m_muxSlots);
+                uint32_t nIndex = 0;
+                if (!m_deqFree.empty()) {
+                    nIndex = m_deqFree.front();
+                    m_deqFree.pop_front();
+                } else if (m_vGenerations.size() <= nIndexMask) {
+                    nIndex = uint32_t(m_vGenerations.size());
+                    m_vGenerations.push_back(0);
+                } else {
+                    return 0;
+                }
+
+                // Generation 0 is never used, so no ID is 0
+                uint32_t &nGeneration = m_vGenerations[nIndex];
+                nGeneration = (nGeneration + 1) & nGenerationMask;
+                if (nGeneration == 0) nGeneration = 1;
+                return (nGeneration << nIndexBits) | nIndex;
+            }
+
+            // Any thread. Give back the slot of a connection which was never inserted
+            void Release(uint32_t nID) {
+                if (m_pSlots != this) return m_pSlots->Release(nID);
+                std::scoped_lock lock(m_muxSlots);
+                m_deqFree.push_back(nID & nIndexMask);
+            }
+
+            // Put a connection in the slot reserved for its ID
+            void Insert(connection_ptr client) {
+                uint32_t nIndex = client->GetID() & nIndexMask;
+                if (nIndex >= m_vSlots.size()) m_vSlots.resize(nIndex + 1);
+                m_vSlots[nIndex] = {client->GetID(), uint32_t(m_vConnections.size())};
+                m_vDenseSlots.push_back(nIndex);
+                m_vConnections.push_back(std::move(client));
+            }
+
+            // Remove the connection of nID and free its slot, the last connection moves into its dense position.
+            // Returns false if that connection already left
+            bool Remove(uint32_t nID) {
+                if (!Detach(nID)) return false;
+                Release(nID);
+                return true;
+            }
+
+            // Remove the connection of nID but keep its slot, it is being moved to a registry sharing the slots
+            bool Detach(uint32_t nID) {
+                uint32_t nIndex = nID & nIndexMask;
+                if (nIndex >= m_vSlots.size() || m_vSlots[nIndex].nID != nID) return false;
+
+                uint32_t nDense = m_vSlots[nIndex].nDense;
+                m_vSlots[m_vDenseSlots.back()].nDense = nDense;
+                m_vConnections[nDense] = std::move(m_vConnections.back());
+                m_vDenseSlots[nDense] = m_vDenseSlots.back();
+                m_vConnections.pop_back();
+                m_vDenseSlots.pop_back();
+                m_vSlots[nIndex] = slot();
+                return true;
+            }
+
+            // The connection of nID, an empty pointer if it left. A copy, removing a connection moves the others
+            connection_ptr Find(uint32_t nID) const {
+                uint32_t nIndex = nID & nIndexMask;
+                if (nIndex >= m_vSlots.size() || m_vSlots[nIndex].nID != nID || nID == 0) return nullptr;
+                return m_vConnections[m_vSlots[nIndex].nDense];
+            }
+
+            size_t Size() const {
+                return m_vConnections.size();
+            }
+
+            bool Empty() const {
+                return m_vConnections.empty();
+            }
+
+            // Dense walk over the connections. Removing one moves another, so collect them and remove after the walk
+            typename std::vector<connection_ptr>::const_iterator begin() const {
+                return m_vConnections.begin();
+            }
+
+            typename std::vector<connection_ptr>::const_iterator end() const {
+                return m_vConnections.end();
+            }
+
+            // Drop every connection, their slots are not reused
+            void Clear() {
+                m_vConnections.clear();
+                m_vDenseSlots.clear();
+                m_vSlots.clear();
+            }
+
+        private:
+            // The ID of the connection in a slot, 0 if empty, and where the connection is in the dense array
+            struct slot {
+                uint32_t nID = 0;
+                uint32_t nDense = 0;
+            };
+            std::vector<slot> m_vSlots;
+
+            // Connections and the slot of each, in the same order
+            std::vector<connection_ptr> m_vConnections;
+            std::vector<uint32_t> m_vDenseSlots;
+
+            // Generation of every slot ever handed out and the free slots, shared with the I/O threads, or the
+            // registry that keeps them
+            connection_registry<T> *m_pSlots = this;
+            std::mutex m_muxSlots;
+            std::vector<uint32_t> m_vGenerations;
+            std::deque<uint32_t> m_deqFree;
+        };
+    }
+}
@@ -2,32 +2,91 @@
 
 #include "net_common.h"
 #include "net_tsqueue.h"
+#include "net_mpscqueue.h"
 #include "net_message.h"
 #include "net_connection.h"
+#include "net_registry.h"
+#include "net_datagram.h"
+#include "net_recorder.h"
+
+#include <map>
+#include <unordered_map>
 
 namespace bsl {
     namespace net {
+        // Counters of one message type, only touched by the thread calling Update
+        struct message_stats {
+            uint64_t nMessagesIn = 0;
+            uint64_t nBytesIn = 0;
+            uint64_t nMessagesOut = 0;
+            uint64_t nBytesOut = 0;
+
+            // Time spent in OnMessage, in total and as a histogram where bucket i counts messages handled in
+            // [2^i, 2^(i+1)) microseconds, the first bucket also holds the faster ones and the last the slower ones
+            std::chrono::steady_clock::duration tpHandle{0};
+            std::array<uint64_t, 16> nHandleHistogram{};
+
+            void RecordHandle(std::chrono::steady_clock::duration tpDuration) {
+                tpHandle += tpDuration;
+                auto nMicroseconds = uint64_t(
+                        std::chrono::duration_cast<std::chrono::microseconds>(tpDuration).count());
+                size_t nBucket = 0;
+                while ((nMicroseconds >> (nBucket + 1)) > 0 && nBucket + 1 < nHandleHistogram.size()) nBucket++;
+                nHandleHistogram[nBucket]++;
+            }
+        };
+
         template<typename T>
         class server_interface {
         public:
             // Create a server, ready to listen on specific port
             server_interface(uint16_t port)
-                    : m_asioAcceptor(m_asioContext, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)) {
+                    : m_asioAcceptor(m_asioContext, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)), m_nPort(port) {
+
+            }
+
+            // Create a server behind the listener of front, which must outlive it. It isn't started, front accepts the
+            // clients and runs their I/O and datagrams, and hands clients over with RedirectClient and TransferClient.
+            // It has its own incoming queue and connections, so its Update can run on a thread of its own
+            explicit server_interface(server_interface<T> &front)
+                    : m_connections(front.m_connections), m_asioAcceptor(m_asioContext), m_pFront(&front),
+                      m_nPort(front.m_nPort) {
+
+            }
+
+            // Create a server without a listener, to replay a recorded session into with ReplayMessage
+            server_interface() : m_asioAcceptor(m_asioContext) {
 
             }
 
             virtual ~server_interface() {
                 Stop();
+
+                // Connections hold sockets of the asio context, release them before the context is destroyed
+                m_qMessagesIn.clear();
+                m_vMessageBatch.clear();
+                m_qNewConnections.clear();
+                m_qTransfers.clear();
+                m_mapTransfers.clear();
+                m_mapReplayClients.clear();
+                m_connections.Clear();
             }
 
-            // Starts the server
-            bool Start() {
+            // Starts the server, the asio context is run by nIOThreads threads
+            bool Start(size_t nIOThreads = 1) {
                 try {
                     // Prime the asio context to do some work, because this is a server, so it should wait client connection
                     WaitForClientConnection();
 
-                    // Run context in it's thread
-                    m_threadContext = std::thread([this]() { m_asioContext.run(); });
+                    if (m_bDatagrams) {
+                        m_datagrams = std::make_unique<datagram_socket<T>>(
+                                m_asioContext, asio::ip::udp::endpoint(asio::ip::udp::v4(), m_nPort));
+                        WaitForDatagrams();
+                    }
+
+                    // Run context in it's threads, each connection serializes its own handlers on a strand
+                    for (size_t i = 0; i < std::max<size_t>(nIOThreads, 1); i++)
+                        m_vThreadContext.emplace_back([this]() { m_asioContext.run(); });
                 }
                 catch (std::exception &e) {
                     std::cerr << "[SERVER] Exception: " << e.what() << "\n";
@@ -43,12 +102,55 @@ namespace bsl {
                 // Request the context to close
                 m_asioContext.stop();
 
-                // Clean up the context thread
-                if (m_threadContext.joinable()) m_threadContext.join();
+                // Clean up the context threads
+                for (auto &thread : m_vThreadContext)
+                    if (thread.joinable()) thread.join();
+                m_vThreadContext.clear();
 
                 std::cout << "[SERVER] Stopped!\n";
             }
 
+            // Record every message Update hands to OnMessage, and every client found gone, to a session log at sPath
+            bool RecordSession(const std::string &sPath) {
+                return m_recorder.Open(sPath);
+            }
+
+            // Flush limits applied to every new connection's coalesced write path
+            void SetWriteCoalescing(size_t nMaxMessages, size_t nMaxBytes) {
+                m_nMaxFlushMessages = nMaxMessages;
+                m_nMaxFlushBytes = nMaxBytes;
+            }
+
+            // Largest message body accepted from a client, applied to every new connection
+            void SetMaxMessageSize(uint32_t nMaxBytes) {
+                m_nMaxMessageSize = nMaxBytes;
+            }
+
+            // Outgoing queue limits applied to every new connection, a client falling further behind is disconnected.
+            // 0 is no limit
+            void SetOutgoingLimits(size_t nMaxMessages, size_t nMaxBytes) {
+                m_nMaxQueuedMessages = nMaxMessages;
+                m_nMaxQueuedBytes = nMaxBytes;
+            }
+
+            // Open an unreliable UDP channel on the same port as the listener, call before Start
+            // Clients that enable it too bind their datagrams to their validated connection
+            void EnableDatagrams() {
+                m_bDatagrams = true;
+            }
+
+            // Called when a connection is validated, from then on datagrams carrying its token are accepted
+            void AdmitDatagrams(std::shared_ptr<connection<T>> client) {
+                if (!m_bDatagrams) return;
+                std::scoped_lock lock(m_muxDatagramPeers);
+                m_mapDatagramPeers[client->GetDatagramPeer().nToken.load()] = client;
+            }
+
+            // True once a datagram from the client got through, messages sent unreliably then travel over UDP
+            bool HasDatagramChannel(const std::shared_ptr<connection<T>> &client) const {
+                return client && client->GetDatagramPeer().bBound.load(std::memory_order_acquire);
+            }
+
             // ASYNC - Instruct asio to wait for connection
             void WaitForClientConnection() {
                 // Prime context with an instruction to wait until a socket connects. It will provide a unique socket for each incoming connection
@@ -63,15 +165,21 @@ namespace bsl {
                                                                         m_asioContext, std::move(socket),
                                                                         m_qMessagesIn);
 
-                                // OnClientConnect function will return bool
-                                if (OnClientConnect(newconn)) {
-                                    // Connection allowed, so add to connection container
-                                    m_deqConnections.push_back(std::move(newconn));
+                                newconn->SetWriteCoalescing(m_nMaxFlushMessages, m_nMaxFlushBytes);
+                                newconn->SetOutgoingLimits(m_nMaxQueuedMessages, m_nMaxQueuedBytes);
+                                newconn->SetMaxMessageSize(m_nMaxMessageSize);
 
+                                // OnClientConnect function will return bool
+                                // The ID is the slot the connection will take in the registry
+                                uint32_t nID = 0;
+                                if (OnClientConnect(newconn) && (nID = m_connections.Reserve()) != 0) {
                                     // Set the asio context to read of the header from the client
-                                    m_deqConnections.back()->ConnectToClient(this, nIDCounter++);
+                                    newconn->ConnectToClient(this, nID);
+
+                                    std::cout << "[" << newconn->GetID() << "] Connection Approved\n";
 
-                                    std::cout << "[" << m_deqConnections.back()->GetID() << "] Connection Approved\n";
+                                    // Connection allowed, hand it to the Update thread which owns the connection container
+                                    m_qNewConnections.push_back(std::move(newconn));
                                 } else {
                                     std::cout << "[-----] Connection Denied\n";
                                 }
@@ -86,63 +194,287 @@ namespace bsl {
 
             // Send a message to a specific client
             void MessageClient(std::shared_ptr<connection<T>> client, const message<T> &msg) {
+                MessageClient(std::move(client), make_shared_message(msg));
+            }
+
+            // Send a message the caller is done with to a specific client, the body is moved instead of copied
+            void MessageClient(std::shared_ptr<connection<T>> client, message<T> &&msg) {
+                MessageClient(std::move(client), make_shared_message(std::move(msg)));
+            }
+
+            // Send a shared frame to a specific client
+            void MessageClient(std::shared_ptr<connection<T>> client, const shared_message<T> &msg) {
                 // Check client is valid
                 if (client && client->IsConnected()) {
+                    CountOutgoing(*msg);
                     client->Send(msg);
                 } else {
                     // If the client is invalid, means that we can't communicate with it, so we need to disconnect it
-                    OnClientDisconnect(client);
-                    client.reset();
+                    // and remove it from the container, once
+                    if (client && m_connections.Remove(client->GetID()))
+                        DropClient(client);
+                }
+            }
 
-                    // Then remove it from the container
-                    m_deqConnections.erase(
-                            std::remove(m_deqConnections.begin(), m_deqConnections.end(), client),
-                            m_deqConnections.end());
+            // Send the latest state of something named by nKey over TCP, replacing the message with the same key if it
+            // is still queued for the client. nKey must not be 0
+            void MessageClientLatest(std::shared_ptr<connection<T>> client, message<T> &&msg, uint64_t nKey) {
+                if (client && client->IsConnected()) {
+                    auto frame = make_shared_message(std::move(msg));
+                    CountOutgoing(*frame);
+                    client->SendLatest(std::move(frame), nKey);
+                } else {
+                    MessageClient(std::move(client), std::move(msg));
                 }
             }
 
-            // Send message to all clients
+            // Send a message that only matters until a newer one is sent, like the latest state of a player.
+            // It goes over UDP when the client has a datagram channel and the message fits, over TCP otherwise.
+            // Datagrams may be lost, and one older than a datagram already received is dropped
+            void MessageClientUnreliable(std::shared_ptr<connection<T>> client, const message<T> &msg) {
+                if (!SendDatagram(client, msg))
+                    MessageClient(std::move(client), msg);
+            }
+
+            void MessageClientUnreliable(std::shared_ptr<connection<T>> client, message<T> &&msg) {
+                if (!SendDatagram(client, msg))
+                    MessageClient(std::move(client), std::move(msg));
+            }
+
+            // Send message to all clients, the message is frozen into one shared frame for all of them
             void MessageAllClients(const message<T> &msg, std::shared_ptr<connection<T>> pIgnoreClient = nullptr) {
-                bool bInvalidClientExists = false;
+                MessageAllClients(make_shared_message(msg), pIgnoreClient);
+            }
+
+            // Send a message the caller is done with to all clients, the body is moved into the shared frame
+            void MessageAllClients(message<T> &&msg, std::shared_ptr<connection<T>> pIgnoreClient = nullptr) {
+                MessageAllClients(make_shared_message(std::move(msg)), pIgnoreClient);
+            }
+
+            // Send a shared frame to all clients, every outgoing queue references the same header and body
+            void MessageAllClients(const shared_message<T> &msg, std::shared_ptr<connection<T>> pIgnoreClient = nullptr) {
+                std::vector<std::shared_ptr<connection<T>>> vInvalidClients;
 
                 // Iterate through all clients in container
-                for (auto &client : m_deqConnections) {
+                for (auto &client : m_connections) {
                     // Check client is connected
-                    if (client && client->IsConnected()) {
-                        if (client != pIgnoreClient)
+                    if (client->IsConnected()) {
+                        if (client != pIgnoreClient) {
+                            CountOutgoing(*msg);
                             client->Send(msg);
+                        }
                     } else {
-                        // We can't communicate with the client, disconnect it
-                        OnClientDisconnect(client);
-                        client.reset();
-
-                        bInvalidClientExists = true;
+                        vInvalidClients.push_back(client);
                     }
                 }
 
-                // Because remove item from queue cost too much resources, so we deleted dead clients at once
-                // The connection in connection queue is shared pointer, if it is invalid means it is nullptr, so we just need to remove nullptr item from queue
-                if (bInvalidClientExists)
-                    m_deqConnections.erase(
-                            std::remove(m_deqConnections.begin(), m_deqConnections.end(), nullptr),
-                            m_deqConnections.end());
+                // We can't communicate with these clients, disconnect them. Removing one moves another client in the
+                // container, so it is done after the walk
+                for (auto &client : vInvalidClients) {
+                    m_connections.Remove(client->GetID());
+                    DropClient(client);
+                }
             }
 
             // Force server to respond to incoming messages
             void Update(size_t nMaxMessages = -1, bool bWait = false) {
                 if (bWait) m_qMessagesIn.wait();
 
-                // Process as many messages
-                size_t nMessageCount = 0;
-                while (nMessageCount < nMaxMessages && !m_qMessagesIn.empty()) {
-                    // Grab the front message
-                    auto msg = m_qMessagesIn.pop_front();
+                AdoptConnections();
+
+                // Pull every pending message in one pass, then dispatch them without touching the queue again
+                m_qMessagesIn.drain(m_vMessageBatch, nMaxMessages);
 
-                    // Pass to message handler
+                for (auto &msg : m_vMessageBatch) {
+                    T id = msg.msg.header.id;
+                    message_stats &stats = MessageStats(id);
+                    stats.nMessagesIn++;
+                    stats.nBytesIn += sizeof(message_header<T>) + msg.msg.size();
+
+                    // Recorded at the time it arrived, before the handler, which may move the body out to relay it
+                    if (m_recorder.IsOpen())
+                        m_recorder.WriteMessage(msg.remote ? msg.remote->GetID() : 0, msg.msg, msg.tpArrived);
+
+                    // Pass to message handler. Counting what it sends may grow the stats, so they are looked up again
+                    m_tpMessageArrived = msg.tpArrived;
+                    auto tpStart = std::chrono::steady_clock::now();
                     OnMessage(msg.remote, msg.msg);
+                    MessageStats(id).RecordHandle(std::chrono::steady_clock::now() - tpStart);
+                }
 
-                    nMessageCount++;
+                // Release the bodies back to the block pool, the batch keeps its capacity
+                m_vMessageBatch.clear();
+                if (m_recorder.IsOpen()) m_recorder.Flush();
+            }
+
+            // Respond to incoming messages, waiting for the first one no longer than tpWaitUntil
+            void Update(size_t nMaxMessages, std::chrono::steady_clock::time_point tpWaitUntil) {
+                if (m_qMessagesIn.wait_until(tpWaitUntil))
+                    Update(nMaxMessages, false);
+                else
+                    AdoptConnections();
+            }
+
+            // Adopt connections accepted on the I/O threads since the last update
+            void AdoptConnections() {
+                m_qNewConnections.drain(m_vNewConnections);
+                for (auto &client : m_vNewConnections) m_connections.Insert(std::move(client));
+                m_vNewConnections.clear();
+            }
+
+            // Queue a message from inside the process, Update hands it to OnMessage without a client. Safe from any thread
+            void PostMessage(message<T> &&msg) {
+                m_qMessagesIn.push_back({nullptr, std::move(msg), std::chrono::steady_clock::now()});
+            }
+
+            // Queue what the client sends from now on to target, a server sharing this one's listener. msgCut is posted
+            // here behind everything the client sent before, see connection::Redirect
+            void RedirectClient(const std::shared_ptr<connection<T>> &client, server_interface<T> &target,
+                                message<T> &&msgCut) {
+                client->Redirect(target.m_qMessagesIn, std::move(msgCut));
+            }
+
+            // Hand a client to target, a server sharing this one's listener, without disconnecting it. Target takes it
+            // with AcceptTransfer, once it sees a message posted to it after this call
+            void TransferClient(const std::shared_ptr<connection<T>> &client, server_interface<T> &target) {
+                m_connections.Detach(client->GetID());
+                target.m_qTransfers.push_back(client);
+            }
+
+            // Take a client transferred to this server into the connections, an empty pointer if it wasn't
+            std::shared_ptr<connection<T>> AcceptTransfer(uint32_t nID) {
+                m_qTransfers.drain(m_vTransfers);
+                for (auto &client : m_vTransfers) m_mapTransfers[client->GetID()] = std::move(client);
+                m_vTransfers.clear();
+
+                auto transfer = m_mapTransfers.find(nID);
+                if (transfer == m_mapTransfers.end()) return nullptr;
+                auto client = std::move(transfer->second);
+                m_mapTransfers.erase(transfer);
+                m_connections.Insert(client);
+                return client;
+            }
+
+            // Queue a recorded message for the next Update, from the replay connection standing in for its client,
+            // created the first time the client shows up, as arrived at the recorded tpArrived. nConnectionID 0 is a
+            // message posted from inside the process
+            void ReplayMessage(uint32_t nConnectionID, message<T> &&msg,
+                               std::chrono::steady_clock::time_point tpArrived) {
+                if (nConnectionID == 0) {
+                    m_qMessagesIn.push_back({nullptr, std::move(msg), tpArrived});
+                    return;
                 }
+                auto &client = m_mapReplayClients[nConnectionID];
+                if (!client) {
+                    client = std::make_shared<connection<T>>(m_asioContext, m_qMessagesIn, nConnectionID);
+                    m_connections.Insert(client);
+                }
+                m_qMessagesIn.push_back({client, std::move(msg), tpArrived});
+            }
+
+            // The server found the recorded client gone at this point of the session
+            void ReplayDisconnect(uint32_t nConnectionID) {
+                auto client = m_mapReplayClients.find(nConnectionID);
+                if (client == m_mapReplayClients.end()) return;
+                client->second->Disconnect();
+                if (m_connections.Remove(nConnectionID)) DropClient(client->second);
+            }
+
+            // Digest of everything sent to the replay connections, equal for two replays of a log that handled it
+            // the same way. Each connection's digest is in send order, the connections are folded by ID
+            uint64_t GetReplayDigest() const {
+                uint64_t nDigest = 0xcbf29ce484222325ULL;
+                for (auto &client : m_mapReplayClients)
+                    nDigest = (nDigest ^ client.first ^ client.second->GetSinkDigest()) * 0x100000001b3ULL;
+                return nDigest;
+            }
+
+            // Counters of every message type seen so far, indexed by message id
+            const std::vector<message_stats> &GetMessageStats() const {
+                return m_vMessageStats;
+            }
+
+            // Messages received and not handled yet, a snapshot
+            size_t GetIncomingDepth() const {
+                return m_qMessagesIn.count();
+            }
+
+        private:
+            // A client found gone while sending to it, already out of the registry
+            void DropClient(const std::shared_ptr<connection<T>> &client) {
+                // Flushed at once, it may be found outside of Update
+                if (m_recorder.IsOpen()) {
+                    m_recorder.WriteDisconnect(client->GetID(), std::chrono::steady_clock::now());
+                    m_recorder.Flush();
+                }
+                OnClientDisconnect(client);
+            }
+
+            // ASYNC - Send a message on the client's datagram channel, false if it has none or the message is too big
+            bool SendDatagram(const std::shared_ptr<connection<T>> &client, const message<T> &msg) {
+                if (!HasDatagramChannel(client) || !client->IsConnected()) return false;
+                auto &peer = client->GetDatagramPeer();
+                datagram_header header;
+                header.nToken = peer.nToken;
+                header.nSequence = peer.nSequenceOut++;
+                if (!m_pFront->m_datagrams->Send(peer.endpoint, header, &msg)) return false;
+                CountOutgoing(msg);
+                return true;
+            }
+
+            message_stats &MessageStats(T id) {
+                size_t nIndex = size_t(id);
+                if (nIndex >= m_vMessageStats.size()) m_vMessageStats.resize(nIndex + 1);
+                return m_vMessageStats[nIndex];
+            }
+
+            void CountOutgoing(const message<T> &msg) {
+                message_stats &stats = MessageStats(msg.header.id);
+                stats.nMessagesOut++;
+                stats.nBytesOut += sizeof(message_header<T>) + msg.size();
+            }
+
+            // ASYNC - Receive datagrams, bind them to the connection of their token and queue their messages
+            void WaitForDatagrams() {
+                m_datagrams->StartReceive([this](const asio::ip::udp::endpoint &endpoint, const datagram_header &header,
+                                                 message<T> *msg) {
+                    std::shared_ptr<connection<T>> client;
+                    {
+                        std::scoped_lock lock(m_muxDatagramPeers);
+                        auto peer = m_mapDatagramPeers.find(header.nToken);
+                        if (peer == m_mapDatagramPeers.end()) return;
+                        client = peer->second.lock();
+                        if (!client || !client->IsConnected()) {
+                            m_mapDatagramPeers.erase(peer);
+                            return;
+                        }
+                    }
+
+                    // The first datagram binds the endpoint, datagrams from anywhere else are ignored after that
+                    auto &peer = client->GetDatagramPeer();
+                    if (!peer.bBound.load(std::memory_order_acquire)) {
+                        peer.endpoint = endpoint;
+                        peer.bBound.store(true, std::memory_order_release);
+                    } else if (peer.endpoint != endpoint) {
+                        return;
+                    }
+
+                    if (header.nFlags & datagram_bind) {
+                        // Answer so the client knows datagrams get through both ways
+                        datagram_header reply;
+                        reply.nToken = header.nToken;
+                        reply.nSequence = peer.nSequenceOut++;
+                        reply.nFlags = datagram_bind;
+                        m_datagrams->Send(endpoint, reply, nullptr);
+                        return;
+                    }
+
+                    // To whichever server the client's messages go to now
+                    if (msg && peer.Accept(header.nSequence)) {
+                        auto &qMessagesIn = client->GetIncomingQueue();
+                        qMessagesIn.push_back({std::move(client), std::move(*msg), std::chrono::steady_clock::now()});
+                    }
+                });
             }
 
         protected:
@@ -161,28 +493,84 @@ namespace bsl {
 
             }
 
+            // When the message OnMessage is handling arrived, the recorded time when replaying
+            std::chrono::steady_clock::time_point MessageArrived() const {
+                return m_tpMessageArrived;
+            }
+
         public:
-            // Called when a client is validated
+            // Called when a client is validated, this runs on an I/O thread
             virtual void OnClientValidated(std::shared_ptr<connection<T>> client) {
 
             }
 
+            // Called when a client's outgoing queue went over the limits and it is being disconnected, this runs on an
+            // I/O thread. The disconnect itself is seen by the next message sent to the client
+            virtual void ClientOverflowed(std::shared_ptr<connection<T>> client) {
+                m_nOverflowDisconnects.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Clients disconnected for not keeping up with what was sent to them, counted by the listener
+            uint64_t GetOverflowDisconnects() const {
+                return m_pFront->m_nOverflowDisconnects.load(std::memory_order_relaxed);
+            }
+
         protected:
-            // Thread Safe Queue for incoming message packets
-            tsqueue<owned_message<T>> m_qMessagesIn;
+            // Lock free queue for incoming message packets, every connection produces and Update is the only consumer
+            mpscqueue<owned_message<T>> m_qMessagesIn;
+
+            // Messages drained by the current Update, kept to reuse its capacity, and when the one handled arrived
+            std::vector<owned_message<T>> m_vMessageBatch;
+            std::chrono::steady_clock::time_point m_tpMessageArrived;
+
+            // Container of active validated connections, looked up by client ID. Only the thread calling Update
+            // touches it, except for the I/O threads reserving the IDs of new connections
+            connection_registry<T> m_connections;
+
+            // Connections accepted on an I/O thread, waiting for the next Update to move them into the container
+            mpscqueue<std::shared_ptr<connection<T>>> m_qNewConnections;
+            std::vector<std::shared_ptr<connection<T>>> m_vNewConnections;
 
-            // Container of active validated connections
-            std::deque<std::shared_ptr<connection<T>>> m_deqConnections;
+            // Clients handed over by another server sharing the listener, until AcceptTransfer takes them
+            mpscqueue<std::shared_ptr<connection<T>>> m_qTransfers;
+            std::vector<std::shared_ptr<connection<T>>> m_vTransfers;
+            std::unordered_map<uint32_t, std::shared_ptr<connection<T>>> m_mapTransfers;
 
-            // Asio context and thread that run the context
+            // Asio context and the threads that run the context
             asio::io_context m_asioContext;
-            std::thread m_threadContext;
+            std::vector<std::thread> m_vThreadContext;
 
             // Acceptor handles new incoming connection
             asio::ip::tcp::acceptor m_asioAcceptor;
 
-            // Clients will be identified by this ID
-            uint32_t nIDCounter = 10000;
+            // The server owning the listener, this one unless it was created behind another
+            server_interface<T> *m_pFront = this;
+
+            // Unreliable channel, connections are found by the token their datagrams carry
+            uint16_t m_nPort = 0;
+            bool m_bDatagrams = false;
+            std::unique_ptr<datagram_socket<T>> m_datagrams;
+            std::mutex m_muxDatagramPeers;
+            std::unordered_map<uint64_t, std::weak_ptr<connection<T>>> m_mapDatagramPeers;
+
+            // Session log being recorded, and the connections standing in for the clients of one being replayed
+            session_recorder<T> m_recorder;
+            std::map<uint32_t, std::shared_ptr<connection<T>>> m_mapReplayClients;
+
+            // Traffic and handling time per message type
+            std::vector<message_stats> m_vMessageStats;
+
+            // Write coalescing limits handed to new connections
+            size_t m_nMaxFlushMessages = 32;
+            size_t m_nMaxFlushBytes = 64 * 1024;
+
+            // Largest message body accepted from a client
+            uint32_t m_nMaxMessageSize = nDefaultMaxMessageSize;
+
+            // Outgoing queue limits handed to new connections, and the clients disconnected for going over them
+            size_t m_nMaxQueuedMessages = 0;
+            size_t m_nMaxQueuedBytes = 0;
+            std::atomic<uint64_t> m_nOverflowDisconnects{0};
         };
     }
 }
\ No newline at end of file
@@ -44,6 +44,10 @@ namespace bsl {
 
             // Adds an item to back of Queue
             void push_back(const T &item) {
+                push_back(T(item));
+            }
+
+            void push_back(T &&item) {
                 std::scoped_lock lock(muxQueue);
                 deqQueue.emplace_back(std::move(item));
 
@@ -53,6 +57,10 @@ namespace bsl {
 
             // Adds an item to front of Queue
             void push_front(const T &item) {
+                push_front(T(item));
+            }
+
+            void push_front(T &&item) {
                 std::scoped_lock lock(muxQueue);
                 deqQueue.emplace_front(std::move(item));
 
@@ -0,0 +1,246 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define MMO_BULLETS_SSE2
+#endif
+
+#include "olcPixelGameEngine.h"
+#include "MMO_Common.h"
+#include "MMO_CollisionMap.h"
+
+// Every bullet in flight, one contiguous array per field so the per frame passes stream through memory and can work
+// on 8 (AVX) or 4 (SSE2) bullets at a time, with a scalar loop for the rest and for other targets.
+// Removal swaps the last bullet into the freed slot, so bullets move around and indices are only good for a frame.
+class BulletPool {
+public:
+    size_t Size() const {
+        return m_vPosX.size();
+    }
+
+    bool Empty() const {
+        return m_vPosX.empty();
+    }
+
+    void Add(const sBulletDescription &bullet) {
+        m_vPosX.push_back(bullet.vPos.x);
+        m_vPosY.push_back(bullet.vPos.y);
+        m_vVelX.push_back(bullet.vVel.x);
+        m_vVelY.push_back(bullet.vVel.y);
+        m_vRadius.push_back(bullet.fRadius);
+        m_vBounce.push_back(bullet.nBounce);
+        m_vOwner.push_back(bullet.nOwnerID);
+        m_vDamage.push_back(bullet.nDamage);
+        m_vColor.push_back(bullet.pColor.n);
+        m_vAge.push_back(0.0f);
+    }
+
+    void Clear() {
+        m_vPosX.clear();
+        m_vPosY.clear();
+        m_vVelX.clear();
+        m_vVelY.clear();
+        m_vRadius.clear();
+        m_vBounce.clear();
+        m_vOwner.clear();
+        m_vDamage.clear();
+        m_vColor.clear();
+        m_vAge.clear();
+    }
+
+    olc::vf2d Pos(size_t i) const {
+        return {m_vPosX[i], m_vPosY[i]};
+    }
+
+    olc::vf2d Vel(size_t i) const {
+        return {m_vVelX[i], m_vVelY[i]};
+    }
+
+    float Radius(size_t i) const {
+        return m_vRadius[i];
+    }
+
+    int32_t Bounce(size_t i) const {
+        return m_vBounce[i];
+    }
+
+    uint32_t Owner(size_t i) const {
+        return m_vOwner[i];
+    }
+
+    uint32_t Damage(size_t i) const {
+        return m_vDamage[i];
+    }
+
+    olc::Pixel Color(size_t i) const {
+        return olc::Pixel(m_vColor[i]);
+    }
+
+    // Seconds the bullet has been flying
+    float Age(size_t i) const {
+        return m_vAge[i];
+    }
+
+    // Mark a bullet for removal by the next RemoveDead
+    void Kill(size_t i) {
+        m_vBounce[i] = -1;
+    }
+
+    // Move every bullet by its velocity. A bullet running into a solid tile stops there and bounces off, losing
+    // a bounce, the ones with none left are marked dead
+    void Update(const CollisionMap &map, float fElapsedTime) {
+        size_t nBullets = Size();
+        m_vNextX.resize(nBullets);
+        m_vNextY.resize(nBullets);
+        m_vTileX.resize(nBullets);
+        m_vTileY.resize(nBullets);
+        m_vReach.resize(nBullets);
+        m_vCandidates.resize(nBullets);
+
+        Integrate(fElapsedTime);
+        for (float &fAge : m_vAge) fAge += fElapsedTime;
+
+        // Keep the bullets which could reach a solid tile during the frame, the others are further from any than
+        // they travel. Written unconditionally to stay free of branches
+        size_t nCandidates = 0;
+        for (size_t i = 0; i < nBullets; i++) {
+            m_vCandidates[nCandidates] = uint32_t(i);
+            nCandidates += float(map.Clearance(m_vTileX[i], m_vTileY[i])) - 1.0f <= m_vReach[i];
+        }
+        for (size_t n = 0; n < nCandidates; n++) CollideTiles(map, m_vCandidates[n], fElapsedTime);
+
+        std::swap(m_vPosX, m_vNextX);
+        std::swap(m_vPosY, m_vNextY);
+    }
+
+    // Remove the bullets which can't bounce anymore
+    void RemoveDead() {
+        size_t nBullets = Size();
+        for (size_t i = 0; i < nBullets;) {
+            if (m_vBounce[i] >= 0) {
+                i++;
+                continue;
+            }
+            nBullets--;
+            m_vPosX[i] = m_vPosX[nBullets];
+            m_vPosY[i] = m_vPosY[nBullets];
+            m_vVelX[i] = m_vVelX[nBullets];
+            m_vVelY[i] = m_vVelY[nBullets];
+            m_vRadius[i] = m_vRadius[nBullets];
+            m_vBounce[i] = m_vBounce[nBullets];
+            m_vOwner[i] = m_vOwner[nBullets];
+            m_vDamage[i] = m_vDamage[nBullets];
+            m_vColor[i] = m_vColor[nBullets];
+            m_vAge[i] = m_vAge[nBullets];
+        }
+        m_vPosX.resize(nBullets);
+        m_vPosY.resize(nBullets);
+        m_vVelX.resize(nBullets);
+        m_vVelY.resize(nBullets);
+        m_vRadius.resize(nBullets);
+        m_vBounce.resize(nBullets);
+        m_vOwner.resize(nBullets);
+        m_vDamage.resize(nBullets);
+        m_vColor.resize(nBullets);
+        m_vAge.resize(nBullets);
+    }
+
+private:
+    // Potential position of every bullet, the tile it starts in, and how far from its centre it can touch something
+    // during the frame
+    void Integrate(float fElapsedTime) {
+        const size_t nBullets = Size();
+        const float *pPosX = m_vPosX.data(), *pPosY = m_vPosY.data();
+        const float *pVelX = m_vVelX.data(), *pVelY = m_vVelY.data();
+        const float *pRadius = m_vRadius.data();
+        float *pNextX = m_vNextX.data(), *pNextY = m_vNextY.data(), *pReach = m_vReach.data();
+        int32_t *pTileX = m_vTileX.data(), *pTileY = m_vTileY.data();
+        size_t i = 0;
+
+#if defined(__AVX__)
+        const __m256 dt8 = _mm256_set1_ps(fElapsedTime);
+        for (; i + 8 <= nBullets; i += 8) {
+            __m256 x = _mm256_loadu_ps(pPosX + i), y = _mm256_loadu_ps(pPosY + i);
+            __m256 vx = _mm256_loadu_ps(pVelX + i), vy = _mm256_loadu_ps(pVelY + i);
+            _mm256_storeu_ps(pNextX + i, _mm256_add_ps(x, _mm256_mul_ps(vx, dt8)));
+            _mm256_storeu_ps(pNextY + i, _mm256_add_ps(y, _mm256_mul_ps(vy, dt8)));
+            __m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+            _mm256_storeu_ps(pReach + i, _mm256_add_ps(_mm256_mul_ps(speed, dt8), _mm256_loadu_ps(pRadius + i)));
+
+            // Positions too big to convert come back as INT_MIN, off the map
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pTileX + i), _mm256_cvttps_epi32(_mm256_floor_ps(x)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(pTileY + i), _mm256_cvttps_epi32(_mm256_floor_ps(y)));
+        }
+#endif
+
+#if defined(MMO_BULLETS_SSE2)
+        const __m128 dt4 = _mm_set1_ps(fElapsedTime);
+        const __m128i one4 = _mm_set1_epi32(1);
+        for (; i + 4 <= nBullets; i += 4) {
+            __m128 x = _mm_loadu_ps(pPosX + i), y = _mm_loadu_ps(pPosY + i);
+            __m128 vx = _mm_loadu_ps(pVelX + i), vy = _mm_loadu_ps(pVelY + i);
+            _mm_storeu_ps(pNextX + i, _mm_add_ps(x, _mm_mul_ps(vx, dt4)));
+            _mm_storeu_ps(pNextY + i, _mm_add_ps(y, _mm_mul_ps(vy, dt4)));
+            __m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+            _mm_storeu_ps(pReach + i, _mm_add_ps(_mm_mul_ps(speed, dt4), _mm_loadu_ps(pRadius + i)));
+
+            // SSE2 has no floor, truncate and step down where that rounded up. Positions too big to convert come
+            // back as INT_MIN, off the map
+            __m128i tx = _mm_cvttps_epi32(x), ty = _mm_cvttps_epi32(y);
+            __m128i upx = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(tx), x));
+            __m128i upy = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(ty), y));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pTileX + i), _mm_sub_epi32(tx, _mm_and_si128(upx, one4)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(pTileY + i), _mm_sub_epi32(ty, _mm_and_si128(upy, one4)));
+        }
+#endif
+
+        for (; i < nBullets; i++) {
+            pNextX[i] = pPosX[i] + pVelX[i] * fElapsedTime;
+            pNextY[i] = pPosY[i] + pVelY[i] * fElapsedTime;
+            pReach[i] = std::sqrt(pVelX[i] * pVelX[i] + pVelY[i] * pVelY[i]) * fElapsedTime + pRadius[i];
+            // Negative, too far to convert or NaN are all off the map
+            float x = std::floor(pPosX[i]), y = std::floor(pPosY[i]);
+            pTileX[i] = x >= 0.0f && x < 1e9f ? int32_t(x) : -1;
+            pTileY[i] = y >= 0.0f && y < 1e9f ? int32_t(y) : -1;
+        }
+    }
+
+    // Sweep one bullet along its move, a bullet hitting a wall stops just off it and bounces
+    void CollideTiles(const CollisionMap &map, size_t i, float fElapsedTime) {
+        olc::vf2d vPos = {m_vPosX[i], m_vPosY[i]};
+        olc::vf2d vVel = {m_vVelX[i], m_vVelY[i]};
+        sSweepHit hit = map.Sweep(vPos, vVel * fElapsedTime, m_vRadius[i]);
+        if (!hit.bHit) return;
+
+        vPos += vVel * fElapsedTime * hit.fTime + hit.vNormal * CollisionMap::fSkin;
+        m_vNextX[i] = vPos.x;
+        m_vNextY[i] = vPos.y;
+
+        // Reflect the velocity on the surface, keeping the speed
+        if (m_vBounce[i] > 0) {
+            vVel -= 2.0f * vVel.dot(hit.vNormal) * hit.vNormal;
+            m_vVelX[i] = vVel.x;
+            m_vVelY[i] = vVel.y;
+        }
+        m_vBounce[i]--;
+    }
+
+    std::vector<float> m_vPosX, m_vPosY;
+    std::vector<float> m_vVelX, m_vVelY;
+    std::vector<float> m_vRadius;
+    std::vector<int32_t> m_vBounce;
+    std::vector<uint32_t> m_vOwner;
+    std::vector<uint32_t> m_vDamage;
+    std::vector<uint32_t> m_vColor;
+    std::vector<float> m_vAge;
+
+    // Scratch of Update, kept between frames so a steady stream of bullets doesn't allocate
+    std::vector<float> m_vNextX, m_vNextY;
+    std::vector<int32_t> m_vTileX, m_vTileY;
+    std::vector<float> m_vReach;
+    std::vector<uint32_t> m_vCandidates;
+};
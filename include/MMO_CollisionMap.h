@@ -0,0 +1,374 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "olcPixelGameEngine.h"
+#include "MMO_MapFile.h"
+
+// Result of sweeping a circle through the map
+struct sSweepHit {
+    bool bHit = false;
+    // Fraction of the move done when the circle touches a solid tile, 1 without a hit
+    float fTime = 1.0f;
+    // Normal of the surface touched, pointing out of the tile
+    olc::vf2d vNormal = {0.0f, 0.0f};
+};
+
+// Solid tiles of the world map, read from the packed bits of a MapFile so the solid tiles of a region are found a
+// 64 tile word at a time. Tiles also know how far away the nearest solid tile is, so a mover far from any wall can
+// skip the tile tests altogether. That is worked out per chunk for the chunks streamed in around the players, the
+// others answer as if a wall was next to every tile, which is only slower. Tiles outside the map are not solid.
+class CollisionMap {
+public:
+    // Distance kept from a surface after a hit, so the next sweep doesn't start touching it
+    static constexpr float fSkin = 1e-3f;
+
+    // Clearance is only counted this far, tiles further from any solid tile answer this
+    static constexpr uint8_t nMaxClearance = 16;
+
+    CollisionMap() = default;
+
+    // Map held in a string, row by row ('#' is solid), with every chunk streamed in
+    CollisionMap(const std::string &sMap, const olc::vi2d &vSize) {
+        Build(sMap, vSize);
+    }
+
+    explicit CollisionMap(MapFile map) {
+        Load(std::move(map));
+    }
+
+    void Build(const std::string &sMap, const olc::vi2d &vSize) {
+        MapFile map;
+        map.FromText(sMap, vSize);
+        Load(std::move(map));
+        StreamAll();
+    }
+
+    // Use a map with no chunk streamed in
+    void Load(MapFile map) {
+        m_map = std::move(map);
+        m_vSize = m_map.Size();
+        size_t nChunks = size_t(m_map.ChunksX()) * m_map.ChunksY();
+        m_vClearance.clear();
+        m_vClearance.resize(nChunks);
+        m_vClearanceChunks.assign(nChunks, NoClearance());
+        m_nResidentChunks = 0;
+    }
+
+    const MapFile &Map() const {
+        return m_map;
+    }
+
+    const olc::vi2d &Size() const {
+        return m_vSize;
+    }
+
+    // Keep the chunks within nRadius chunks of the centres streamed in, and let the others go
+    void Stream(const std::vector<olc::vf2d> &vCenters, int32_t nRadius) {
+        const int32_t nChunksX = m_map.ChunksX(), nChunksY = m_map.ChunksY();
+        m_vWanted.assign(m_vClearance.size(), 0);
+        for (auto &vCenter : vCenters) {
+            if (std::isnan(vCenter.x) || std::isnan(vCenter.y)) continue;
+            float fChunk = float(MapFile::nChunkSize);
+            int32_t cx = int32_t(std::max(-1.0f, std::min(std::floor(vCenter.x / fChunk), float(nChunksX))));
+            int32_t cy = int32_t(std::max(-1.0f, std::min(std::floor(vCenter.y / fChunk), float(nChunksY))));
+            for (int32_t y = std::max(cy - nRadius, 0); y <= std::min(cy + nRadius, nChunksY - 1); y++)
+                for (int32_t x = std::max(cx - nRadius, 0); x <= std::min(cx + nRadius, nChunksX - 1); x++)
+                    m_vWanted[size_t(y) * nChunksX + x] = 1;
+        }
+
+        for (int32_t cy = 0; cy < nChunksY; cy++) {
+            for (int32_t cx = 0; cx < nChunksX; cx++) {
+                size_t nChunk = size_t(cy) * nChunksX + cx;
+                bool bResident = m_vClearance[nChunk] != nullptr;
+                if (m_vWanted[nChunk] && !bResident) StreamIn(cx, cy);
+                else if (!m_vWanted[nChunk] && bResident) StreamOut(cx, cy);
+            }
+        }
+    }
+
+    void StreamAll() {
+        for (int32_t cy = 0; cy < m_map.ChunksY(); cy++)
+            for (int32_t cx = 0; cx < m_map.ChunksX(); cx++)
+                if (!m_vClearance[size_t(cy) * m_map.ChunksX() + cx]) StreamIn(cx, cy);
+    }
+
+    size_t ResidentChunks() const {
+        return m_nResidentChunks;
+    }
+
+    size_t Chunks() const {
+        return m_vClearance.size();
+    }
+
+    bool IsSolid(int32_t x, int32_t y) const {
+        return m_map.IsSolid(x, y);
+    }
+
+    // Tiles to the nearest solid tile, counting diagonal steps as one, so 0 on a solid tile and 1 next to one.
+    // Nothing solid is closer than Clearance - 1 to any point of the tile. Tiles outside the map or in a chunk that
+    // isn't streamed in answer 0
+    uint8_t Clearance(int32_t x, int32_t y) const {
+        if (x < 0 || y < 0 || x >= m_vSize.x || y >= m_vSize.y) return 0;
+        const int32_t n = MapFile::nChunkSize;
+        return m_vClearanceChunks[size_t(y / n) * m_map.ChunksX() + x / n][(y % n) * n + x % n];
+    }
+
+    // Clearance of the streamed in chunks, and the map itself when it isn't mapped from a file
+    size_t MemoryBytes() const {
+        size_t nChunkTiles = size_t(MapFile::nChunkSize) * MapFile::nChunkSize;
+        return m_nResidentChunks * nChunkTiles + (m_map.IsMapped() ? 0 : m_map.ImageBytes());
+    }
+
+    // Move a circle from vStart by vDelta, stopping at the first solid tile it touches on the way. A circle already
+    // overlapping a tile only stops if it moves further into it
+    sSweepHit Sweep(const olc::vf2d &vStart, const olc::vf2d &vDelta, float fRadius) const {
+        sSweepHit hit;
+        if (IsClear(vStart, vDelta.mag() + fRadius)) return hit;
+
+        olc::vf2d vEnd = vStart + vDelta;
+        olc::vi2d vTL = (vStart.min(vEnd) - olc::vf2d(fRadius, fRadius)).floor();
+        olc::vi2d vBR = (vStart.max(vEnd) + olc::vf2d(fRadius, fRadius)).floor();
+        ForEachSolid(vTL, vBR, [&](int32_t x, int32_t y) {
+            float fTime;
+            olc::vf2d vNormal;
+            if (SweepTile(vStart, vDelta, fRadius, x, y, fTime, vNormal) && (!hit.bHit || fTime < hit.fTime)) {
+                hit.bHit = true;
+                hit.fTime = fTime;
+                hit.vNormal = vNormal;
+            }
+        });
+        return hit;
+    }
+
+    // Push a circle out of the solid tiles it overlaps
+    olc::vf2d PushOut(olc::vf2d vPos, float fRadius) const {
+        if (IsClear(vPos, fRadius)) return vPos;
+        olc::vi2d vTL = (vPos - olc::vf2d(fRadius, fRadius)).floor();
+        olc::vi2d vBR = (vPos + olc::vf2d(fRadius, fRadius)).floor();
+        ForEachSolid(vTL, vBR, [&](int32_t x, int32_t y) {
+            olc::vf2d vNormal;
+            float fDepth = Penetration(vPos, fRadius, x, y, vNormal);
+            if (fDepth > 0) vPos += vNormal * (fDepth + fSkin);
+        });
+        return vPos;
+    }
+
+    // Move a circle by vDelta, sliding along the walls it runs into, returns where it ends up
+    olc::vf2d Move(olc::vf2d vPos, olc::vf2d vDelta, float fRadius) const {
+        vPos = PushOut(vPos, fRadius);
+        // Every hit removes a direction from the move, so a few passes settle even in a corner
+        for (int i = 0; i < 3 && vDelta.mag2() > 0; i++) {
+            sSweepHit hit = Sweep(vPos, vDelta, fRadius);
+            if (!hit.bHit) return vPos + vDelta;
+
+            vPos += vDelta * hit.fTime + hit.vNormal * fSkin;
+            vDelta *= 1.0f - hit.fTime;
+            vDelta -= hit.vNormal * vDelta.dot(hit.vNormal);
+        }
+        return vPos;
+    }
+
+private:
+    // True if nothing solid is within fReach of vPos, from the clearance of its tile
+    bool IsClear(const olc::vf2d &vPos, float fReach) const {
+        float x = std::floor(vPos.x), y = std::floor(vPos.y);
+        if (!(x >= 0 && y >= 0 && x < float(m_vSize.x) && y < float(m_vSize.y))) return false;
+        return float(Clearance(int32_t(x), int32_t(y))) - 1.0f > fReach;
+    }
+
+    // Clearance of the chunks not streamed in
+    static const uint8_t *NoClearance() {
+        static const uint8_t vNone[MapFile::nChunkSize * MapFile::nChunkSize] = {};
+        return vNone;
+    }
+
+    void StreamIn(int32_t cx, int32_t cy) {
+        size_t nChunk = size_t(cy) * m_map.ChunksX() + cx;
+        m_map.WillNeedChunk(cx, cy);
+        m_vClearance[nChunk] = BuildClearance(cx, cy);
+        m_vClearanceChunks[nChunk] = m_vClearance[nChunk].get();
+        m_nResidentChunks++;
+    }
+
+    void StreamOut(int32_t cx, int32_t cy) {
+        size_t nChunk = size_t(cy) * m_map.ChunksX() + cx;
+        m_vClearanceChunks[nChunk] = NoClearance();
+        m_vClearance[nChunk].reset();
+        m_map.DontNeedChunk(cx, cy);
+        m_nResidentChunks--;
+    }
+
+    static int CountTrailingZeros(uint64_t n) {
+#if defined(_MSC_VER)
+        unsigned long nIndex;
+        _BitScanForward64(&nIndex, n);
+        return int(nIndex);
+#else
+        return __builtin_ctzll(n);
+#endif
+    }
+
+    // Call f(x, y) for every solid tile in the region, inclusive, skipping empty tiles a word at a time
+    template<typename Function>
+    void ForEachSolid(olc::vi2d vTL, olc::vi2d vBR, Function &&f) const {
+        vTL = vTL.max({0, 0});
+        vBR = vBR.min(m_vSize - olc::vi2d(1, 1));
+        if (vTL.x > vBR.x || vTL.y > vBR.y) return;
+
+        const int32_t n = MapFile::nChunkSize;
+        const size_t nWordsPerRow = MapFile::nWordsPerChunkRow;
+        size_t nFirstWord = size_t(vTL.x) / 64, nLastWord = size_t(vBR.x) / 64;
+        for (int32_t y = vTL.y; y <= vBR.y; y++) {
+            for (size_t w = nFirstWord; w <= nLastWord; w++) {
+                const uint64_t *pChunk = m_map.ChunkBits(int32_t(w / nWordsPerRow), y / n);
+                uint64_t nBits = pChunk[(y % n) * nWordsPerRow + w % nWordsPerRow];
+                if (w == nFirstWord) nBits &= ~uint64_t(0) << (vTL.x % 64);
+                if (w == nLastWord && vBR.x % 64 != 63) nBits &= (uint64_t(1) << (vBR.x % 64 + 1)) - 1;
+                while (nBits) {
+                    f(int32_t(w * 64 + CountTrailingZeros(nBits)), y);
+                    nBits &= nBits - 1;
+                }
+            }
+        }
+    }
+
+    // How deep a circle is in the tile at (x, y) and the way out, 0 without overlap
+    static float Penetration(const olc::vf2d &vPos, float fRadius, int32_t x, int32_t y, olc::vf2d &vNormal) {
+        olc::vf2d vNearest = {std::max(float(x), std::min(vPos.x, float(x + 1))),
+                              std::max(float(y), std::min(vPos.y, float(y + 1)))};
+        olc::vf2d vAway = vPos - vNearest;
+        float fDistance2 = vAway.mag2();
+        if (fDistance2 >= fRadius * fRadius) return 0.0f;
+        if (fDistance2 > 0) {
+            float fDistance = std::sqrt(fDistance2);
+            vNormal = vAway / fDistance;
+            return fRadius - fDistance;
+        }
+
+        // The centre is inside the tile, leave by the closest side
+        float fLeft = vPos.x - float(x), fRight = float(x + 1) - vPos.x;
+        float fTop = vPos.y - float(y), fBottom = float(y + 1) - vPos.y;
+        float fSide = std::min(std::min(fLeft, fRight), std::min(fTop, fBottom));
+        if (fSide == fLeft) vNormal = {-1.0f, 0.0f};
+        else if (fSide == fRight) vNormal = {1.0f, 0.0f};
+        else if (fSide == fTop) vNormal = {0.0f, -1.0f};
+        else vNormal = {0.0f, 1.0f};
+        return fRadius + fSide;
+    }
+
+    // Time of impact of a moving circle with the tile at (x, y): a ray against the tile grown by the radius, with
+    // rounded corners
+    static bool SweepTile(const olc::vf2d &vStart, const olc::vf2d &vDelta, float fRadius, int32_t x, int32_t y,
+                          float &fTime, olc::vf2d &vNormal) {
+        // Slabs of the grown tile
+        olc::vf2d vMin = olc::vf2d(float(x), float(y)) - olc::vf2d(fRadius, fRadius);
+        olc::vf2d vMax = olc::vf2d(float(x + 1), float(y + 1)) + olc::vf2d(fRadius, fRadius);
+        float fEnter = -INFINITY, fExit = INFINITY;
+        for (int nAxis = 0; nAxis < 2; nAxis++) {
+            float fStart = nAxis ? vStart.y : vStart.x, fMove = nAxis ? vDelta.y : vDelta.x;
+            float fLow = nAxis ? vMin.y : vMin.x, fHigh = nAxis ? vMax.y : vMax.x;
+            if (fMove == 0) {
+                if (fStart < fLow || fStart > fHigh) return false;
+                continue;
+            }
+            float t0 = (fLow - fStart) / fMove, t1 = (fHigh - fStart) / fMove;
+            if (t0 > t1) std::swap(t0, t1);
+            fEnter = std::max(fEnter, t0);
+            fExit = std::min(fExit, t1);
+        }
+        if (fEnter > fExit || fExit < 0 || fEnter > 1) return false;
+
+        // Starting in the grown tile, if already touching it only counts when moving further in
+        if (fEnter <= 0 && Penetration(vStart, fRadius, x, y, vNormal) > 0) {
+            if (vDelta.dot(vNormal) >= 0) return false;
+            fTime = 0.0f;
+            return true;
+        }
+
+        // Entering through a side of the tile
+        olc::vf2d vEntry = vStart + vDelta * std::max(fEnter, 0.0f);
+        bool bInX = vEntry.x >= float(x) && vEntry.x <= float(x + 1);
+        bool bInY = vEntry.y >= float(y) && vEntry.y <= float(y + 1);
+        if (bInX || bInY) {
+            fTime = std::max(fEnter, 0.0f);
+            if (bInX) vNormal = {0.0f, vEntry.y < float(y) + 0.5f ? -1.0f : 1.0f};
+            else vNormal = {vEntry.x < float(x) + 0.5f ? -1.0f : 1.0f, 0.0f};
+            // Grazing the side or leaving it
+            return vDelta.dot(vNormal) < 0;
+        }
+
+        // Entering the rounded part of a corner, a ray against the circle around the corner
+        olc::vf2d vCorner = {vEntry.x < float(x) ? float(x) : float(x + 1),
+                             vEntry.y < float(y) ? float(y) : float(y + 1)};
+        olc::vf2d m = vStart - vCorner;
+        float a = vDelta.mag2();
+        float b = m.dot(vDelta);
+        float c = m.mag2() - fRadius * fRadius;
+        float fDiscriminant = b * b - a * c;
+        if (a == 0 || fDiscriminant < 0) return false;
+        float t = (-b - std::sqrt(fDiscriminant)) / a;
+        if (t < 0 || t > 1) return false;
+        fTime = t;
+        vNormal = (vStart + vDelta * t - vCorner).norm();
+        return true;
+    }
+
+    // Chebyshev distance to the nearest solid tile for the tiles of a chunk, in two passes over the chunk and a border
+    // wide enough for every distance up to nMaxClearance
+    std::unique_ptr<uint8_t[]> BuildClearance(int32_t cx, int32_t cy) const {
+        const int32_t n = MapFile::nChunkSize, nBorder = nMaxClearance, w = n + 2 * nBorder;
+        const int32_t x0 = cx * n - nBorder, y0 = cy * n - nBorder;
+        std::vector<uint8_t> vDistance(size_t(w) * w);
+        for (int32_t y = 0; y < w; y++)
+            for (int32_t x = 0; x < w; x++)
+                vDistance[size_t(y) * w + x] = m_map.IsSolid(x0 + x, y0 + y) ? 0 : nMaxClearance;
+
+        auto relax = [&](int32_t x, int32_t y, int32_t nx, int32_t ny) {
+            if (nx < 0 || ny < 0 || nx >= w || ny >= w) return;
+            uint8_t &d = vDistance[size_t(y) * w + x];
+            d = std::min<uint8_t>(d, vDistance[size_t(ny) * w + nx] + 1);
+        };
+        for (int32_t y = 0; y < w; y++) {
+            for (int32_t x = 0; x < w; x++) {
+                relax(x, y, x - 1, y);
+                relax(x, y, x - 1, y - 1);
+                relax(x, y, x, y - 1);
+                relax(x, y, x + 1, y - 1);
+            }
+        }
+        for (int32_t y = w - 1; y >= 0; y--) {
+            for (int32_t x = w - 1; x >= 0; x--) {
+                relax(x, y, x + 1, y);
+                relax(x, y, x + 1, y + 1);
+                relax(x, y, x, y + 1);
+                relax(x, y, x - 1, y + 1);
+            }
+        }
+
+        std::unique_ptr<uint8_t[]> pClearance(new uint8_t[size_t(n) * n]);
+        for (int32_t y = 0; y < n; y++)
+            std::memcpy(pClearance.get() + size_t(y) * n, vDistance.data() + size_t(y + nBorder) * w + nBorder, n);
+        return pClearance;
+    }
+
+    MapFile m_map;
+    olc::vi2d m_vSize = {0, 0};
+
+    // Clearance of the chunks streamed in, and for every chunk where to read it
+    std::vector<std::unique_ptr<uint8_t[]>> m_vClearance;
+    std::vector<const uint8_t *> m_vClearanceChunks;
+    size_t m_nResidentChunks = 0;
+
+    // Scratch of Stream
+    std::vector<uint8_t> m_vWanted;
+};
@@ -24,8 +24,37 @@ enum class GameMsg : uint32_t {
     Game_UpdatePlayer,
     Game_FireBullet,
     Game_HitPlayer,
-    Game_Dead
+    Game_Dead,
+
+    // Latest state of every player updated during a server tick
+    // msg is the states encoded one after the other by PlayerStateCodec, against the last state the client received
+    // of each player or as keyframes, followed by their count
+    Game_Snapshot,
+
+    // Between the lobby and the shards of a sharded server, posted inside the server and never taken from a client
+    // A player registered with the lobby, msg is the description it registered with followed by its ID
+    Shard_Join,
+    // A player is about to be handed over, its messages are held until it arrives, msg is its ID
+    Shard_Expect,
+    // Every message a leaving player sent before the handover is handled, msg is its ID
+    Shard_Cut,
+    // A player handed over with what its client knows, msg is written with message_writer
+    Shard_Handoff,
+    // A player near the border of a neighbouring shard, msg is its description
+    Shard_Mirror,
+    // A mirrored player went away from the border or left, msg is its ID
+    Shard_Unmirror,
+
+    // Players added and removed in bulk: a joining client gets every player at once, the others get the players
+    // that came and went since the last flush. Lists longer than nMaxPresencePerMessage are split over several
+    // messages
+    // msg is written with message_writer, an array of player descriptions
+    Game_AddPlayers,
+    // msg is written with message_writer, an array of player IDs
+    Game_RemovePlayers
 };
+// Most players in one Game_AddPlayers or Game_RemovePlayers, well under the default message size limit
+constexpr uint32_t nMaxPresencePerMessage = 4096;
 enum class PlayerStatus : uint32_t  {
     Alive,
     Dead,
@@ -61,6 +90,8 @@ struct sPlayerDescription {
 
     // Rate of fire, num of bullet per second
     uint8_t nRof = 5;
+    // Spelled out so the description goes on the wire without uninitialised bytes
+    uint8_t nPadding[3] = {};
 
     olc::Pixel pColor;
 
@@ -70,6 +101,11 @@ struct sPlayerDescription {
     olc::vf2d vVel;
     olc::vf2d vAcc;
     float fSpeed = 10.0f;
+
+    // Stamped by the client of the player on every state it sends: how many it sent before, and when, in milliseconds
+    // of its own clock. Receivers drop states older than one they have and space the ones they keep in time
+    uint32_t nSequence = 0;
+    uint32_t nTime = 0;
 };
 struct sHitDescription {
     uint32_t nShooterID;
@@ -79,4 +115,21 @@ struct sHitDescription {
 struct sDeadDescription{
     uint32_t nKillerID;
     uint32_t nSuffererID;
-};
\ No newline at end of file
+};
+
+// Load of the server over the last second, the Server_GetStatus reply carries it after the ServerStatus
+struct sServerMetrics {
+    uint32_t nConnections = 0;
+    uint32_t nPlayers = 0;
+    // Share of the time the game thread spent handling messages and ticking, in percent
+    float fLoad = 0.0f;
+    // Messages waiting to be handled, and the longest queue of messages waiting to be sent to a client
+    uint32_t nIncomingDepth = 0;
+    uint32_t nOutgoingDepth = 0;
+    float fMessagesIn = 0.0f;
+    float fMessagesOut = 0.0f;
+    float fBytesIn = 0.0f;
+    float fBytesOut = 0.0f;
+    // 99th percentile of the time to handle a message, in microseconds
+    float fHandleP99 = 0.0f;
+};
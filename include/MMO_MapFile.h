@@ -0,0 +1,391 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#endif
+
+#include "olcPixelGameEngine.h"
+
+// Read only view of a whole file through the virtual memory system, pages are read from disk the first time they
+// are touched and can be dropped again under memory pressure
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            Close();
+            std::swap(m_pData, other.m_pData);
+            std::swap(m_nSize, other.m_nSize);
+#if defined(_WIN32)
+            std::swap(m_hFile, other.m_hFile);
+            std::swap(m_hMapping, other.m_hMapping);
+#else
+            std::swap(m_nFile, other.m_nFile);
+#endif
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        Close();
+    }
+
+    bool Open(const std::string &sPath) {
+        Close();
+#if defined(_WIN32)
+        m_hFile = CreateFileA(sPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_hFile == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER nSize;
+        if (!GetFileSizeEx(m_hFile, &nSize) || nSize.QuadPart == 0) {
+            Close();
+            return false;
+        }
+        m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_hMapping) {
+            Close();
+            return false;
+        }
+        m_pData = static_cast<const uint8_t *>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+        m_nSize = size_t(nSize.QuadPart);
+#else
+        m_nFile = open(sPath.c_str(), O_RDONLY);
+        if (m_nFile < 0) return false;
+        struct stat info{};
+        if (fstat(m_nFile, &info) != 0 || info.st_size == 0) {
+            Close();
+            return false;
+        }
+        void *pData = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, m_nFile, 0);
+        m_pData = pData == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(pData);
+        m_nSize = size_t(info.st_size);
+#endif
+        if (!m_pData) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+#if defined(_WIN32)
+        if (m_pData) UnmapViewOfFile(m_pData);
+        if (m_hMapping) CloseHandle(m_hMapping);
+        if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+        m_hMapping = nullptr;
+        m_hFile = INVALID_HANDLE_VALUE;
+#else
+        if (m_pData) munmap(const_cast<uint8_t *>(m_pData), m_nSize);
+        if (m_nFile >= 0) close(m_nFile);
+        m_nFile = -1;
+#endif
+        m_pData = nullptr;
+        m_nSize = 0;
+    }
+
+    bool IsOpen() const {
+        return m_pData != nullptr;
+    }
+
+    const uint8_t *Data() const {
+        return m_pData;
+    }
+
+    size_t Size() const {
+        return m_nSize;
+    }
+
+    // Hint that a range is about to be read, so its pages are read ahead of the first touch
+    void WillNeed(size_t nOffset, size_t nLength) const {
+#if defined(_WIN32)
+#if _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range = {const_cast<uint8_t *>(m_pData) + nOffset, nLength};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+        Advise(nOffset, nLength, MADV_WILLNEED);
+#endif
+    }
+
+    // Hint that a range won't be read for a while, its pages can go and are read again if touched
+    void DontNeed(size_t nOffset, size_t nLength) const {
+#if !defined(_WIN32)
+        Advise(nOffset, nLength, MADV_DONTNEED);
+#endif
+    }
+
+private:
+#if !defined(_WIN32)
+    void Advise(size_t nOffset, size_t nLength, int nAdvice) const {
+        if (!m_pData || nOffset >= m_nSize) return;
+        size_t nPage = size_t(sysconf(_SC_PAGESIZE));
+        size_t nStart = nOffset / nPage * nPage;
+        size_t nEnd = std::min(nOffset + nLength, m_nSize);
+        madvise(const_cast<uint8_t *>(m_pData) + nStart, nEnd - nStart, nAdvice);
+    }
+#endif
+
+    const uint8_t *m_pData = nullptr;
+    size_t m_nSize = 0;
+#if defined(_WIN32)
+    HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    HANDLE m_hMapping = nullptr;
+#else
+    int m_nFile = -1;
+#endif
+};
+
+// Start of a binary map file, all fields little endian
+struct sMapFileHeader {
+    char sMagic[4] = {'M', 'M', 'O', 'M'};
+    uint32_t nVersion = 1;
+    int32_t nWidth = 0;
+    int32_t nHeight = 0;
+    uint32_t nChunkSize = 0;
+    uint32_t nChunksX = 0;
+    uint32_t nChunksY = 0;
+    // Chunks with at least one solid tile, the only ones stored
+    uint32_t nStoredChunks = 0;
+};
+
+// World map split in square chunks of tiles, one bit per tile, set for solid ('#') tiles.
+// The file is the header, then a slot per chunk row by row, 0 for a chunk without solid tiles or 1 + the index of
+// the stored chunk, then the stored chunks aligned to their size. A chunk is nChunkSize rows of nChunkSize / 64
+// words, tile x of a row is bit x % 64 of word x / 64.
+// A map opened from a binary file is memory mapped, so only the chunks that are read get loaded. Text maps are
+// converted in memory as they are read.
+class MapFile {
+public:
+    static constexpr int32_t nChunkSize = 128;
+    static constexpr size_t nWordsPerChunkRow = nChunkSize / 64;
+    static constexpr size_t nChunkWords = nWordsPerChunkRow * nChunkSize;
+    static constexpr size_t nChunkBytes = nChunkWords * sizeof(uint64_t);
+
+    // Open a binary map, or read a text map if the file doesn't start like one
+    bool Open(const std::string &sPath) {
+        MappedFile file;
+        if (!file.Open(sPath)) return false;
+        if (file.Size() < sizeof(sMapFileHeader) || std::memcmp(file.Data(), sMapFileHeader().sMagic, 4) != 0)
+            return LoadText(sPath);
+        if (!Attach(file.Data(), file.Size())) return false;
+        m_vImage.clear();
+        m_file = std::move(file);
+        return true;
+    }
+
+    // Read a text map, one line per row of tiles
+    bool LoadText(const std::string &sPath) {
+        std::ifstream file(sPath);
+        if (!file) return false;
+
+        std::string sTiles, line;
+        olc::vi2d vSize = {0, 0};
+        while (std::getline(file, line)) {
+            sTiles.append(line);
+            vSize.x = int32_t(line.length());
+            vSize.y++;
+        }
+        return FromText(sTiles, vSize);
+    }
+
+    // Convert tiles held in a string, row by row
+    bool FromText(const std::string &sTiles, const olc::vi2d &vSize) {
+        m_file.Close();
+        m_vImage = Encode(sTiles, vSize);
+        return Attach(m_vImage.data(), m_vImage.size());
+    }
+
+    // Write the map in the binary format
+    bool Save(const std::string &sPath) const {
+        std::ofstream file(sPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(m_pImage), std::streamsize(m_nImageBytes));
+        return bool(file);
+    }
+
+    static std::vector<uint8_t> Encode(const std::string &sTiles, const olc::vi2d &vSize) {
+        sMapFileHeader header;
+        header.nWidth = std::max(vSize.x, 0);
+        header.nHeight = std::max(vSize.y, 0);
+        header.nChunkSize = nChunkSize;
+        header.nChunksX = uint32_t((header.nWidth + nChunkSize - 1) / nChunkSize);
+        header.nChunksY = uint32_t((header.nHeight + nChunkSize - 1) / nChunkSize);
+
+        // Pack every chunk, keeping the ones with a solid tile
+        std::vector<uint32_t> vSlots(size_t(header.nChunksX) * header.nChunksY, 0);
+        std::vector<uint64_t> vChunks;
+        std::vector<uint64_t> vChunk(nChunkWords);
+        for (uint32_t cy = 0; cy < header.nChunksY; cy++) {
+            for (uint32_t cx = 0; cx < header.nChunksX; cx++) {
+                std::fill(vChunk.begin(), vChunk.end(), 0);
+                bool bSolid = false;
+                for (int32_t ly = 0; ly < nChunkSize; ly++) {
+                    int32_t y = int32_t(cy) * nChunkSize + ly;
+                    for (int32_t lx = 0; lx < nChunkSize && y < header.nHeight; lx++) {
+                        int32_t x = int32_t(cx) * nChunkSize + lx;
+                        size_t nTile = size_t(y) * header.nWidth + x;
+                        if (x >= header.nWidth || nTile >= sTiles.size() || sTiles[nTile] != '#') continue;
+                        vChunk[ly * nWordsPerChunkRow + lx / 64] |= uint64_t(1) << (lx % 64);
+                        bSolid = true;
+                    }
+                }
+                if (!bSolid) continue;
+                vSlots[cy * header.nChunksX + cx] = ++header.nStoredChunks;
+                vChunks.insert(vChunks.end(), vChunk.begin(), vChunk.end());
+            }
+        }
+
+        size_t nChunksOffset = ChunksOffset(vSlots.size());
+        std::vector<uint8_t> vImage(nChunksOffset + vChunks.size() * sizeof(uint64_t), 0);
+        std::memcpy(vImage.data(), &header, sizeof(header));
+        std::memcpy(vImage.data() + sizeof(header), vSlots.data(), vSlots.size() * sizeof(uint32_t));
+        if (!vChunks.empty())
+            std::memcpy(vImage.data() + nChunksOffset, vChunks.data(), vChunks.size() * sizeof(uint64_t));
+        return vImage;
+    }
+
+    const olc::vi2d &Size() const {
+        return m_vSize;
+    }
+
+    int32_t ChunksX() const {
+        return int32_t(m_header.nChunksX);
+    }
+
+    int32_t ChunksY() const {
+        return int32_t(m_header.nChunksY);
+    }
+
+    // True if the chunks are read from a mapped file rather than held in memory
+    bool IsMapped() const {
+        return m_file.IsOpen();
+    }
+
+    size_t ImageBytes() const {
+        return m_nImageBytes;
+    }
+
+    // Bits of a chunk, a chunk without solid tiles and chunks outside the map read as all clear
+    const uint64_t *ChunkBits(int32_t cx, int32_t cy) const {
+        if (cx < 0 || cy < 0 || cx >= ChunksX() || cy >= ChunksY()) return EmptyChunk();
+        uint32_t nSlot = m_pSlots[size_t(cy) * m_header.nChunksX + cx];
+        return nSlot ? m_pChunks + size_t(nSlot - 1) * nChunkWords : EmptyChunk();
+    }
+
+    bool IsSolid(int32_t x, int32_t y) const {
+        if (x < 0 || y < 0 || x >= m_vSize.x || y >= m_vSize.y) return false;
+        const uint64_t *pBits = ChunkBits(x / nChunkSize, y / nChunkSize);
+        return (pBits[(y % nChunkSize) * nWordsPerChunkRow + (x % nChunkSize) / 64] >> (x % 64)) & 1;
+    }
+
+    // Read a chunk ahead of its first use, or let it go from memory until it is used again
+    void WillNeedChunk(int32_t cx, int32_t cy) const {
+        size_t nOffset;
+        if (m_file.IsOpen() && ChunkOffset(cx, cy, nOffset)) m_file.WillNeed(nOffset, nChunkBytes);
+    }
+
+    void DontNeedChunk(int32_t cx, int32_t cy) const {
+        size_t nOffset;
+        if (m_file.IsOpen() && ChunkOffset(cx, cy, nOffset)) m_file.DontNeed(nOffset, nChunkBytes);
+    }
+
+private:
+    static const uint64_t *EmptyChunk() {
+        static const uint64_t vEmpty[nChunkWords] = {};
+        return vEmpty;
+    }
+
+    static size_t ChunksOffset(size_t nSlots) {
+        size_t nEnd = sizeof(sMapFileHeader) + nSlots * sizeof(uint32_t);
+        return (nEnd + nChunkBytes - 1) / nChunkBytes * nChunkBytes;
+    }
+
+    bool ChunkOffset(int32_t cx, int32_t cy, size_t &nOffset) const {
+        if (cx < 0 || cy < 0 || cx >= ChunksX() || cy >= ChunksY()) return false;
+        uint32_t nSlot = m_pSlots[size_t(cy) * m_header.nChunksX + cx];
+        if (nSlot == 0) return false;
+        nOffset = ChunksOffset(size_t(m_header.nChunksX) * m_header.nChunksY) + size_t(nSlot - 1) * nChunkBytes;
+        return true;
+    }
+
+    // Check the image is a whole map of this version and point into it
+    bool Attach(const uint8_t *pImage, size_t nBytes) {
+        sMapFileHeader header;
+        if (nBytes < sizeof(header)) return false;
+        std::memcpy(&header, pImage, sizeof(header));
+        if (std::memcmp(header.sMagic, sMapFileHeader().sMagic, 4) != 0 || header.nVersion != 1 ||
+            header.nChunkSize != uint32_t(nChunkSize) || header.nWidth < 0 || header.nHeight < 0 ||
+            header.nChunksX != uint32_t((header.nWidth + nChunkSize - 1) / nChunkSize) ||
+            header.nChunksY != uint32_t((header.nHeight + nChunkSize - 1) / nChunkSize))
+            return false;
+
+        size_t nSlots = size_t(header.nChunksX) * header.nChunksY;
+        if (nBytes < ChunksOffset(nSlots) + size_t(header.nStoredChunks) * nChunkBytes) return false;
+        const uint32_t *pSlots = reinterpret_cast<const uint32_t *>(pImage + sizeof(header));
+        for (size_t i = 0; i < nSlots; i++)
+            if (pSlots[i] > header.nStoredChunks) return false;
+
+        m_header = header;
+        m_vSize = {header.nWidth, header.nHeight};
+        m_pImage = pImage;
+        m_nImageBytes = nBytes;
+        m_pSlots = pSlots;
+        m_pChunks = reinterpret_cast<const uint64_t *>(pImage + ChunksOffset(nSlots));
+        return true;
+    }
+
+    MappedFile m_file;
+    // The image of a map converted in memory, empty when mapped
+    std::vector<uint8_t> m_vImage;
+
+    sMapFileHeader m_header;
+    olc::vi2d m_vSize = {0, 0};
+    const uint8_t *m_pImage = nullptr;
+    size_t m_nImageBytes = 0;
+    const uint32_t *m_pSlots = nullptr;
+    const uint64_t *m_pChunks = nullptr;
+};
+
+// Memory the process has resident, to report what loading a map costs, 0 where it can't be told
+inline size_t ResidentMemoryBytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.WorkingSetSize;
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t nCount = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, task_info_t(&info), &nCount) == KERN_SUCCESS)
+        return info.resident_size;
+    return 0;
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t nPages = 0, nResident = 0;
+    if (!(statm >> nPages >> nResident)) return 0;
+    return nResident * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <algorithm>
+
+#include "MMO_Common.h"
+
+// The last states received for a remote player, kept to draw it a little in the past between two states it really
+// had, rather than snapping to each state as it arrives. States are placed on the timeline of the client that sent
+// them by their time stamp, so the gaps the network adds or removes between them don't show. That timeline is mapped
+// onto the local clock with the smallest receive delay seen in the buffer, the states that arrived fastest.
+// Past the newest state the player keeps going at its last velocity for a bounded time, then stops.
+class SnapshotBuffer {
+public:
+    static constexpr size_t nCapacity = 16;
+
+    // Keep a state received at fReceived seconds of the local clock. States not newer than the newest one kept, by
+    // sequence number, are duplicates or came out of order and are dropped
+    bool Push(const sPlayerDescription &state, double fReceived) {
+        if (m_nCount > 0) {
+            const entry &newest = At(m_nCount - 1);
+            if (int32_t(state.nSequence - newest.state.nSequence) <= 0) return false;
+        }
+
+        entry e;
+        e.state = state;
+        e.fReceived = fReceived;
+        // Unwrapped from the milliseconds of the sender, relative to the first state kept
+        if (m_nCount > 0) {
+            const entry &newest = At(m_nCount - 1);
+            e.fTime = newest.fTime + double(int32_t(state.nTime - newest.state.nTime)) / 1000.0;
+        }
+
+        if (m_nCount == nCapacity) {
+            m_nFirst = (m_nFirst + 1) % nCapacity;
+            m_nCount--;
+        }
+        m_vEntries[(m_nFirst + m_nCount) % nCapacity] = e;
+        m_nCount++;
+        return true;
+    }
+
+    // State to draw at fNow seconds of the local clock, fDelay seconds behind the newest state that could have
+    // arrived by now. Extrapolates at most fMaxExtrapolation seconds past the newest state. False if there is none
+    bool Sample(double fNow, double fDelay, double fMaxExtrapolation, sPlayerDescription &out) const {
+        if (m_nCount == 0) return false;
+
+        double fOffset = At(0).fReceived - At(0).fTime;
+        for (size_t i = 1; i < m_nCount; i++) fOffset = std::min(fOffset, At(i).fReceived - At(i).fTime);
+        double fTime = fNow - fOffset - fDelay;
+
+        // Before the oldest state kept, it is the best there is
+        if (fTime <= At(0).fTime) {
+            out = At(0).state;
+            return true;
+        }
+
+        const entry &newest = At(m_nCount - 1);
+        if (fTime >= newest.fTime) {
+            out = newest.state;
+            if (newest.state.status != PlayerStatus::Dead)
+                out.vPos += newest.state.vVel * float(std::min(fTime - newest.fTime, fMaxExtrapolation));
+            return true;
+        }
+
+        size_t i = m_nCount - 1;
+        while (At(i - 1).fTime > fTime) i--;
+        const entry &from = At(i - 1), &to = At(i);
+        out = from.state;
+        // A player that died or spawned in between jumped there, it doesn't travel
+        if (from.state.status == to.state.status && to.fTime > from.fTime) {
+            float fAlpha = float((fTime - from.fTime) / (to.fTime - from.fTime));
+            out.vPos = from.state.vPos + (to.state.vPos - from.state.vPos) * fAlpha;
+            out.vVel = from.state.vVel + (to.state.vVel - from.state.vVel) * fAlpha;
+        }
+        return true;
+    }
+
+    size_t Size() const {
+        return m_nCount;
+    }
+
+    void Clear() {
+        m_nFirst = 0;
+        m_nCount = 0;
+    }
+
+private:
+    struct entry {
+        sPlayerDescription state;
+        // Seconds on the timeline of the sender, and of the local clock when it arrived
+        double fTime = 0.0;
+        double fReceived = 0.0;
+    };
+
+    const entry &At(size_t i) const {
+        return m_vEntries[(m_nFirst + i) % nCapacity];
+    }
+
+    std::array<entry, nCapacity> m_vEntries;
+    size_t m_nFirst = 0;
+    size_t m_nCount = 0;
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+
+#include "olcPixelGameEngine.h"
+
+// Uniform grid over the world, each cell lists the ids of the entities inside it.
+// Cells are hashed so the world can be unbounded and empty cells cost nothing. Cell vectors are kept when they
+// empty, so a grid that is cleared and refilled every frame stops allocating once it has warmed up.
+class SpatialHash {
+public:
+    explicit SpatialHash(float fCellSize = 8.0f) : m_fCellSize(fCellSize) {}
+
+    float CellSize() const {
+        return m_fCellSize;
+    }
+
+    olc::vi2d CellOf(const olc::vf2d &vPos) const {
+        return {int32_t(std::floor(vPos.x / m_fCellSize)), int32_t(std::floor(vPos.y / m_fCellSize))};
+    }
+
+    // Put an entity in the cell containing vPos, or move it there, returns true if its cell changed
+    bool Update(uint32_t id, const olc::vf2d &vPos) {
+        olc::vi2d vCell = CellOf(vPos);
+        auto entity = m_mapEntityCells.find(id);
+        if (entity != m_mapEntityCells.end()) {
+            if (entity->second == vCell) return false;
+            Erase(id, entity->second);
+            entity->second = vCell;
+        } else {
+            m_mapEntityCells.emplace(id, vCell);
+        }
+        m_mapCells[Key(vCell)].push_back(id);
+        return true;
+    }
+
+    void Remove(uint32_t id) {
+        auto entity = m_mapEntityCells.find(id);
+        if (entity == m_mapEntityCells.end()) return;
+        Erase(id, entity->second);
+        m_mapEntityCells.erase(entity);
+    }
+
+    // Forget every entity but keep the cell storage for the next fill
+    void Clear() {
+        for (auto &cell : m_mapCells) cell.second.clear();
+        m_mapEntityCells.clear();
+    }
+
+    // Cell of an entity, the entity must be in the grid
+    olc::vi2d CellOfEntity(uint32_t id) const {
+        return m_mapEntityCells.at(id);
+    }
+
+    bool Contains(uint32_t id) const {
+        return m_mapEntityCells.count(id) > 0;
+    }
+
+    // Call f(id) for every entity in the cells from vCellTL to vCellBR inclusive
+    template<typename Function>
+    void QueryCells(const olc::vi2d &vCellTL, const olc::vi2d &vCellBR, Function &&f) const {
+        olc::vi2d vCell;
+        for (vCell.y = vCellTL.y; vCell.y <= vCellBR.y; vCell.y++) {
+            for (vCell.x = vCellTL.x; vCell.x <= vCellBR.x; vCell.x++) {
+                auto cell = m_mapCells.find(Key(vCell));
+                if (cell == m_mapCells.end()) continue;
+                for (uint32_t id : cell->second) f(id);
+            }
+        }
+    }
+
+    // Call f(id) for every entity whose cell overlaps the box of half size fRadius around vPos
+    template<typename Function>
+    void QueryRadius(const olc::vf2d &vPos, float fRadius, Function &&f) const {
+        QueryCells(CellOf(vPos - olc::vf2d(fRadius, fRadius)), CellOf(vPos + olc::vf2d(fRadius, fRadius)),
+                   std::forward<Function>(f));
+    }
+
+private:
+    static int64_t Key(const olc::vi2d &vCell) {
+        return (int64_t(vCell.x) << 32) | uint32_t(vCell.y);
+    }
+
+    void Erase(uint32_t id, const olc::vi2d &vCell) {
+        auto &vIDs = m_mapCells[Key(vCell)];
+        for (size_t i = 0; i < vIDs.size(); i++) {
+            if (vIDs[i] == id) {
+                vIDs[i] = vIDs.back();
+                vIDs.pop_back();
+                break;
+            }
+        }
+    }
+
+    float m_fCellSize;
+    std::unordered_map<int64_t, std::vector<uint32_t>> m_mapCells;
+    std::unordered_map<uint32_t, olc::vi2d> m_mapEntityCells;
+};
@@ -0,0 +1,247 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+
+#include "MMO_Common.h"
+
+// Compact encoding of sPlayerDescription for Game_UpdatePlayer traffic
+// A state is written as its id, a bitmask of the fields that differ from the baseline (the last state the receiver
+// holds for that player) and then only those fields. Position, velocity and acceleration are quantized to fixed
+// point with nStepsPerUnit steps per tile, every integer is a variable length integer. The sequence number and the time
+// stamp are written as their difference from the baseline's, a byte or two at the rates clients send.
+// The encoder advances its baseline to exactly what the decoder reconstructs, so both sides stay in step as long
+// as every encoded state is delivered in order, which the TCP connection guarantees.
+// States sent on a channel that may lose them are keyframes, encoded against a default description instead.
+class PlayerStateCodec {
+public:
+    static constexpr uint32_t nDefaultStepsPerUnit = 256;
+
+    explicit PlayerStateCodec(uint32_t nStepsPerUnit = nDefaultStepsPerUnit)
+            : m_fStep(1.0f / float(nStepsPerUnit)), m_fInvStep(float(nStepsPerUnit)) {}
+
+    enum Field : uint32_t {
+        Field_Health = 1 << 0,
+        Field_Energy = 1 << 1,
+        Field_Mass = 1 << 2,
+        Field_MaxEnergy = 1 << 3,
+        Field_Ammo = 1 << 4,
+        Field_Kills = 1 << 5,
+        Field_Deaths = 1 << 6,
+        Field_Status = 1 << 7,
+        Field_Rof = 1 << 8,
+        Field_Color = 1 << 9,
+        Field_Radius = 1 << 10,
+        Field_Pos = 1 << 11,
+        Field_Vel = 1 << 12,
+        Field_Acc = 1 << 13,
+        Field_Speed = 1 << 14,
+        // Encoded against a default description, decodes without a baseline
+        Field_Keyframe = 1 << 15,
+        Field_Sequence = 1 << 16,
+        Field_Time = 1 << 17,
+    };
+
+    // Append state encoded against baseline to out, then set baseline to the state the receiver will decode
+    template<typename Buffer>
+    void Encode(const sPlayerDescription &state, sPlayerDescription &baseline, Buffer &out) const {
+        Write(state, baseline, 0, out);
+    }
+
+    // Append state encoded as a keyframe, for datagrams that may be lost or arrive out of order
+    template<typename Buffer>
+    void EncodeKeyframe(const sPlayerDescription &state, Buffer &out) const {
+        sPlayerDescription baseline;
+        Write(state, baseline, Field_Keyframe, out);
+    }
+
+    // Decode one state from [p, pEnd) on top of state, which holds the baseline. Advances p past the state
+    // A keyframe replaces state entirely, so receivers decode keyframes into a copy to keep their baseline intact
+    // Returns false if the data is truncated or malformed, state is then left unchanged
+    bool Decode(const uint8_t *&p, const uint8_t *pEnd, sPlayerDescription &state) const {
+        const uint8_t *pRead = p;
+        sPlayerDescription decoded = state;
+        uint32_t nMask = 0, nValue = 0;
+
+        if (!ReadVarint(pRead, pEnd, decoded.nUniqueID)) return false;
+        if (!ReadVarint(pRead, pEnd, nMask)) return false;
+        if (nMask & Field_Keyframe) {
+            uint32_t nUniqueID = decoded.nUniqueID;
+            decoded = sPlayerDescription();
+            decoded.nUniqueID = nUniqueID;
+        }
+        if ((nMask & Field_Health) && !ReadVarint(pRead, pEnd, decoded.nHealth)) return false;
+        if ((nMask & Field_Energy) && !ReadVarint(pRead, pEnd, decoded.nEnergy)) return false;
+        if ((nMask & Field_Mass) && !ReadVarint(pRead, pEnd, decoded.nMass)) return false;
+        if ((nMask & Field_MaxEnergy) && !ReadVarint(pRead, pEnd, decoded.nMaxEnergy)) return false;
+        if ((nMask & Field_Ammo) && !ReadVarint(pRead, pEnd, decoded.nAmmo)) return false;
+        if ((nMask & Field_Kills) && !ReadVarint(pRead, pEnd, decoded.nKills)) return false;
+        if ((nMask & Field_Deaths) && !ReadVarint(pRead, pEnd, decoded.nDeaths)) return false;
+        if (nMask & Field_Status) {
+            if (!ReadVarint(pRead, pEnd, nValue)) return false;
+            decoded.status = PlayerStatus(nValue);
+        }
+        if (nMask & Field_Rof) {
+            if (pRead >= pEnd) return false;
+            decoded.nRof = *pRead++;
+        }
+        if ((nMask & Field_Color) && !ReadRaw(pRead, pEnd, decoded.pColor.n)) return false;
+        if ((nMask & Field_Radius) && !ReadRaw(pRead, pEnd, decoded.fRadius)) return false;
+        if ((nMask & Field_Pos) && !ReadVector(pRead, pEnd, decoded.vPos)) return false;
+        if ((nMask & Field_Vel) && !ReadVector(pRead, pEnd, decoded.vVel)) return false;
+        if ((nMask & Field_Acc) && !ReadVector(pRead, pEnd, decoded.vAcc)) return false;
+        if ((nMask & Field_Speed) && !ReadRaw(pRead, pEnd, decoded.fSpeed)) return false;
+        if (nMask & Field_Sequence) {
+            if (!ReadVarint(pRead, pEnd, nValue)) return false;
+            decoded.nSequence += nValue;
+        }
+        if (nMask & Field_Time) {
+            if (!ReadVarint(pRead, pEnd, nValue)) return false;
+            decoded.nTime += nValue;
+        }
+
+        state = decoded;
+        p = pRead;
+        return true;
+    }
+
+    // Id of the encoded state at p and whether it is a keyframe, without consuming it, so the receiver can pick the
+    // baseline to decode against
+    static bool Peek(const uint8_t *p, const uint8_t *pEnd, uint32_t &id, bool &bKeyframe) {
+        uint32_t nMask = 0;
+        if (!ReadVarint(p, pEnd, id) || !ReadVarint(p, pEnd, nMask)) return false;
+        bKeyframe = (nMask & Field_Keyframe) != 0;
+        return true;
+    }
+
+    // Vector on the fixed point grid, what a receiver reconstructs
+    olc::vf2d Dequantize(const olc::vi2d &v) const {
+        return {float(v.x) * m_fStep, float(v.y) * m_fStep};
+    }
+
+    olc::vi2d Quantize(const olc::vf2d &v) const {
+        return {int32_t(std::lround(v.x * m_fInvStep)), int32_t(std::lround(v.y * m_fInvStep))};
+    }
+
+private:
+    // Write the fields of state that differ from baseline, plus nFlags, then advance baseline
+    template<typename Buffer>
+    void Write(const sPlayerDescription &state, sPlayerDescription &baseline, uint32_t nFlags, Buffer &out) const {
+        uint32_t nMask = nFlags;
+        if (state.nHealth != baseline.nHealth) nMask |= Field_Health;
+        if (state.nEnergy != baseline.nEnergy) nMask |= Field_Energy;
+        if (state.nMass != baseline.nMass) nMask |= Field_Mass;
+        if (state.nMaxEnergy != baseline.nMaxEnergy) nMask |= Field_MaxEnergy;
+        if (state.nAmmo != baseline.nAmmo) nMask |= Field_Ammo;
+        if (state.nKills != baseline.nKills) nMask |= Field_Kills;
+        if (state.nDeaths != baseline.nDeaths) nMask |= Field_Deaths;
+        if (state.status != baseline.status) nMask |= Field_Status;
+        if (state.nRof != baseline.nRof) nMask |= Field_Rof;
+        if (state.pColor.n != baseline.pColor.n) nMask |= Field_Color;
+        if (state.fRadius != baseline.fRadius) nMask |= Field_Radius;
+        if (Quantize(state.vPos) != Quantize(baseline.vPos)) nMask |= Field_Pos;
+        if (Quantize(state.vVel) != Quantize(baseline.vVel)) nMask |= Field_Vel;
+        if (Quantize(state.vAcc) != Quantize(baseline.vAcc)) nMask |= Field_Acc;
+        if (state.fSpeed != baseline.fSpeed) nMask |= Field_Speed;
+        if (state.nSequence != baseline.nSequence) nMask |= Field_Sequence;
+        if (state.nTime != baseline.nTime) nMask |= Field_Time;
+
+        WriteVarint(out, state.nUniqueID);
+        WriteVarint(out, nMask);
+        if (nMask & Field_Health) WriteVarint(out, state.nHealth);
+        if (nMask & Field_Energy) WriteVarint(out, state.nEnergy);
+        if (nMask & Field_Mass) WriteVarint(out, state.nMass);
+        if (nMask & Field_MaxEnergy) WriteVarint(out, state.nMaxEnergy);
+        if (nMask & Field_Ammo) WriteVarint(out, state.nAmmo);
+        if (nMask & Field_Kills) WriteVarint(out, state.nKills);
+        if (nMask & Field_Deaths) WriteVarint(out, state.nDeaths);
+        if (nMask & Field_Status) WriteVarint(out, uint32_t(state.status));
+        if (nMask & Field_Rof) out.push_back(state.nRof);
+        if (nMask & Field_Color) WriteRaw(out, state.pColor.n);
+        if (nMask & Field_Radius) WriteRaw(out, state.fRadius);
+        if (nMask & Field_Pos) WriteVector(out, state.vPos);
+        if (nMask & Field_Vel) WriteVector(out, state.vVel);
+        if (nMask & Field_Acc) WriteVector(out, state.vAcc);
+        if (nMask & Field_Speed) WriteRaw(out, state.fSpeed);
+        // Unsigned differences, so the counters may wrap
+        if (nMask & Field_Sequence) WriteVarint(out, state.nSequence - baseline.nSequence);
+        if (nMask & Field_Time) WriteVarint(out, state.nTime - baseline.nTime);
+
+        baseline.nUniqueID = state.nUniqueID;
+        Apply(nMask, state, baseline);
+    }
+
+    // Copy the fields in nMask from state to baseline the way the decoder sees them
+    void Apply(uint32_t nMask, const sPlayerDescription &state, sPlayerDescription &baseline) const {
+        if (nMask & Field_Health) baseline.nHealth = state.nHealth;
+        if (nMask & Field_Energy) baseline.nEnergy = state.nEnergy;
+        if (nMask & Field_Mass) baseline.nMass = state.nMass;
+        if (nMask & Field_MaxEnergy) baseline.nMaxEnergy = state.nMaxEnergy;
+        if (nMask & Field_Ammo) baseline.nAmmo = state.nAmmo;
+        if (nMask & Field_Kills) baseline.nKills = state.nKills;
+        if (nMask & Field_Deaths) baseline.nDeaths = state.nDeaths;
+        if (nMask & Field_Status) baseline.status = state.status;
+        if (nMask & Field_Rof) baseline.nRof = state.nRof;
+        if (nMask & Field_Color) baseline.pColor = state.pColor;
+        if (nMask & Field_Radius) baseline.fRadius = state.fRadius;
+        if (nMask & Field_Pos) baseline.vPos = Dequantize(Quantize(state.vPos));
+        if (nMask & Field_Vel) baseline.vVel = Dequantize(Quantize(state.vVel));
+        if (nMask & Field_Acc) baseline.vAcc = Dequantize(Quantize(state.vAcc));
+        if (nMask & Field_Speed) baseline.fSpeed = state.fSpeed;
+        if (nMask & Field_Sequence) baseline.nSequence = state.nSequence;
+        if (nMask & Field_Time) baseline.nTime = state.nTime;
+    }
+
+    template<typename Buffer>
+    static void WriteVarint(Buffer &out, uint32_t n) {
+        while (n >= 0x80) {
+            out.push_back(uint8_t(n) | 0x80);
+            n >>= 7;
+        }
+        out.push_back(uint8_t(n));
+    }
+
+    static bool ReadVarint(const uint8_t *&p, const uint8_t *pEnd, uint32_t &n) {
+        n = 0;
+        for (int nShift = 0; nShift < 35; nShift += 7) {
+            if (p >= pEnd) return false;
+            uint8_t nByte = *p++;
+            n |= uint32_t(nByte & 0x7F) << nShift;
+            if ((nByte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    // Signed values are zigzag encoded so small negative numbers stay short
+    template<typename Buffer>
+    void WriteVector(Buffer &out, const olc::vf2d &v) const {
+        olc::vi2d q = Quantize(v);
+        WriteVarint(out, (uint32_t(q.x) << 1) ^ uint32_t(q.x >> 31));
+        WriteVarint(out, (uint32_t(q.y) << 1) ^ uint32_t(q.y >> 31));
+    }
+
+    bool ReadVector(const uint8_t *&p, const uint8_t *pEnd, olc::vf2d &v) const {
+        uint32_t x = 0, y = 0;
+        if (!ReadVarint(p, pEnd, x) || !ReadVarint(p, pEnd, y)) return false;
+        v = Dequantize({int32_t(x >> 1) ^ -int32_t(x & 1), int32_t(y >> 1) ^ -int32_t(y & 1)});
+        return true;
+    }
+
+    template<typename Buffer, typename DataType>
+    static void WriteRaw(Buffer &out, const DataType &data) {
+        size_t i = out.size();
+        out.resize(i + sizeof(DataType));
+        std::memcpy(out.data() + i, &data, sizeof(DataType));
+    }
+
+    template<typename DataType>
+    static bool ReadRaw(const uint8_t *&p, const uint8_t *pEnd, DataType &data) {
+        if (size_t(pEnd - p) < sizeof(DataType)) return false;
+        std::memcpy(&data, p, sizeof(DataType));
+        p += sizeof(DataType);
+        return true;
+    }
+
+    float m_fStep;
+    float m_fInvStep;
+};
@@ -0,0 +1,179 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "olcPixelGameEngine.h"
+#include "olcPGEX_TransformedView.h"
+#include "MMO_CollisionMap.h"
+
+// The walls of the map drawn once into square chunks of nChunkPixels, which are then copied to the screen every frame
+// instead of drawing every visible tile. Chunks are drawn at a power of two number of pixels per tile, the largest not
+// above the zoom, so on screen they are scaled up less than 2x and no line is lost. Zooming past another power of two
+// draws them again, so the number of tiles in a chunk shrinks as the view zooms in and a chunk keeps its size.
+// Chunks with no wall are only remembered. With decals the chunks go to the GPU and are drawn after, so on top of,
+// everything drawn with pixels that frame. Without, they are copied into the draw target.
+class TileLayer {
+public:
+    static constexpr int32_t nChunkPixels = 512;
+    static constexpr int32_t nMinTilePixels = 1;
+    static constexpr int32_t nMaxTilePixels = 128;
+    // Chunks out of view are dropped once there are more than this, a chunk is 1MB
+    static constexpr size_t nMaxCachedChunks = 48;
+
+    void Draw(olc::PixelGameEngine &pge, const olc::TileTransformedView &tv, const CollisionMap &map, bool bDecals) {
+        const float fScale = tv.GetWorldScale().x;
+        int32_t nTilePixels = nMinTilePixels;
+        while (nTilePixels * 2 <= fScale && nTilePixels < nMaxTilePixels) nTilePixels *= 2;
+        if (nTilePixels != m_nTilePixels) {
+            m_mapChunks.clear();
+            m_nTilePixels = nTilePixels;
+        }
+        const int32_t nChunkTiles = nChunkPixels / nTilePixels;
+        const float fZoom = fScale / float(nTilePixels);
+
+        olc::vi2d vTL = tv.GetTopLeftTile().max({0, 0});
+        olc::vi2d vBR = tv.GetBottomRightTile().min(map.Size());
+        if (vTL.x >= vBR.x || vTL.y >= vBR.y) return;
+        // Up to the chunk of the tile after the last, the edges of the last walls of the map fall on its first pixels
+        olc::vi2d vChunkTL = vTL / nChunkTiles, vChunkBR = vBR / nChunkTiles;
+
+        for (int32_t cy = vChunkTL.y; cy <= vChunkBR.y; cy++) {
+            for (int32_t cx = vChunkTL.x; cx <= vChunkBR.x; cx++) {
+                chunk &c = Chunk(pge, map, {cx, cy}, nChunkTiles);
+                if (!c.sprite) continue;
+
+                // Unrounded, so neighbouring chunks meet without a gap
+                olc::vf2d vScreen = (olc::vf2d(olc::vi2d(cx, cy) * nChunkTiles) - tv.GetWorldOffset()) * fScale;
+                if (bDecals) {
+                    if (!c.decal) c.decal = std::make_unique<olc::Decal>(c.sprite.get());
+                    pge.DrawDecal(vScreen, c.decal.get(), {fZoom, fZoom});
+                } else {
+                    Blit(pge, *c.sprite, vScreen, fZoom);
+                }
+            }
+        }
+
+        if (m_mapChunks.size() > nMaxCachedChunks) {
+            for (auto it = m_mapChunks.begin(); it != m_mapChunks.end();) {
+                olc::vi2d vChunk = Unpack(it->first);
+                bool bVisible = vChunk.x >= vChunkTL.x && vChunk.x <= vChunkBR.x && vChunk.y >= vChunkTL.y &&
+                                vChunk.y <= vChunkBR.y;
+                it = bVisible ? std::next(it) : m_mapChunks.erase(it);
+            }
+        }
+    }
+
+    // Forget every chunk, the map changed
+    void Clear() {
+        m_mapChunks.clear();
+    }
+
+    size_t CachedChunks() const {
+        return m_mapChunks.size();
+    }
+
+    uint64_t ChunksDrawn() const {
+        return m_nChunksDrawn;
+    }
+
+    int32_t TilePixels() const {
+        return m_nTilePixels;
+    }
+
+private:
+    struct chunk {
+        // Empty if the chunk has no wall
+        std::unique_ptr<olc::Sprite> sprite;
+        std::unique_ptr<olc::Decal> decal;
+    };
+
+    static uint64_t Pack(const olc::vi2d &vChunk) {
+        return (uint64_t(uint32_t(vChunk.y)) << 32) | uint32_t(vChunk.x);
+    }
+
+    static olc::vi2d Unpack(uint64_t nKey) {
+        return {int32_t(uint32_t(nKey)), int32_t(uint32_t(nKey >> 32))};
+    }
+
+    chunk &Chunk(olc::PixelGameEngine &pge, const CollisionMap &map, const olc::vi2d &vChunk, int32_t nChunkTiles) {
+        auto it = m_mapChunks.find(Pack(vChunk));
+        if (it != m_mapChunks.end()) return it->second;
+
+        chunk &c = m_mapChunks[Pack(vChunk)];
+        const olc::vi2d vFirst = vChunk * nChunkTiles;
+        const float fTile = float(m_nTilePixels);
+        auto sprite = std::make_unique<olc::Sprite>(nChunkPixels, nChunkPixels);
+        olc::Sprite *pTarget = pge.GetDrawTarget();
+        olc::Pixel::Mode mode = pge.GetPixelMode();
+        pge.SetDrawTarget(sprite.get());
+        pge.SetPixelMode(olc::Pixel::NORMAL);
+        pge.Clear(olc::BLANK);
+
+        // The same rectangles as drawing tile by tile through the view, which rounds sizes to the nearest pixel.
+        // Walls just above and left of the chunk are drawn too, their right and bottom edges fall on its first pixels
+        const olc::vi2d vInnerSize = (olc::vf2d(0.8f, 0.8f) * fTile + olc::vf2d(0.5f, 0.5f)).floor();
+        bool bWalls = false;
+        olc::vi2d vTile;
+        for (vTile.y = -1; vTile.y < nChunkTiles; vTile.y++) {
+            for (vTile.x = -1; vTile.x < nChunkTiles; vTile.x++) {
+                if (!map.IsSolid(vFirst.x + vTile.x, vFirst.y + vTile.y)) continue;
+                bWalls = true;
+                olc::vf2d vInner = olc::vf2d(vFirst + vTile) + olc::vf2d(0.1f, 0.1f) - olc::vf2d(vFirst);
+                pge.DrawRect(vTile * m_nTilePixels, {m_nTilePixels, m_nTilePixels});
+                pge.DrawRect((vInner * fTile).floor(), vInnerSize);
+            }
+        }
+
+        pge.SetDrawTarget(pTarget);
+        pge.SetPixelMode(mode);
+        if (bWalls) c.sprite = std::move(sprite);
+        m_nChunksDrawn++;
+        return c;
+    }
+
+    // Nearest pixel copy of a chunk scaled by fZoom with its corner at vPos, skipping the pixels between the walls
+    void Blit(olc::PixelGameEngine &pge, olc::Sprite &sprite, const olc::vf2d &vPos, float fZoom) {
+        olc::Sprite *pTarget = pge.GetDrawTarget();
+        if (!pTarget) return;
+        const int32_t nWidth = pTarget->width, nHeight = pTarget->height;
+        const float fSize = float(nChunkPixels) * fZoom;
+        int32_t nX0 = std::max(0, int32_t(std::floor(vPos.x))), nX1 = std::min(nWidth, int32_t(std::floor(vPos.x + fSize)));
+        int32_t nY0 = std::max(0, int32_t(std::floor(vPos.y))), nY1 = std::min(nHeight, int32_t(std::floor(vPos.y + fSize)));
+        if (nX0 >= nX1 || nY0 >= nY1) return;
+
+        const olc::Pixel *pSource = sprite.GetData();
+        olc::Pixel *pDest = pTarget->GetData();
+        if (fZoom == 1.0f) {
+            const int32_t nLeft = int32_t(std::floor(vPos.x)), nTop = int32_t(std::floor(vPos.y));
+            for (int32_t y = nY0; y < nY1; y++) {
+                const olc::Pixel *pRow = pSource + size_t(y - nTop) * nChunkPixels - nLeft;
+                olc::Pixel *pOut = pDest + size_t(y) * nWidth;
+                for (int32_t x = nX0; x < nX1; x++)
+                    pOut[x] = pRow[x].a != 0 ? pRow[x] : pOut[x];
+            }
+            return;
+        }
+
+        m_vColumns.resize(size_t(nX1 - nX0));
+        for (int32_t x = nX0; x < nX1; x++)
+            m_vColumns[x - nX0] = std::min(nChunkPixels - 1, int32_t((float(x) - std::floor(vPos.x)) / fZoom));
+
+        for (int32_t y = nY0; y < nY1; y++) {
+            int32_t nRow = std::min(nChunkPixels - 1, int32_t((float(y) - std::floor(vPos.y)) / fZoom));
+            const olc::Pixel *pRow = pSource + size_t(nRow) * nChunkPixels;
+            olc::Pixel *pOut = pDest + size_t(y) * nWidth;
+            for (int32_t x = nX0; x < nX1; x++) {
+                const olc::Pixel p = pRow[m_vColumns[x - nX0]];
+                if (p.a != 0) pOut[x] = p;
+            }
+        }
+    }
+
+    std::unordered_map<uint64_t, chunk> m_mapChunks;
+    int32_t m_nTilePixels = 0;
+    uint64_t m_nChunksDrawn = 0;
+    std::vector<int32_t> m_vColumns;
+};